@@ -45,7 +45,7 @@ version(ostream &os)
 
 void help() {
   cerr << "Usage : ngt command [options] index [data]" << endl;
-  cerr << "           command : info create search remove append export import prune reconstruct-graph optimize-search-parameters optimize-#-of-edges repair" << endl;
+  cerr << "           command : info create search remove compact append export export-mapped export-sector warmup import prune reconstruct-graph optimize-search-parameters optimize-#-of-edges repair" << endl;
   cerr << "Version : " << NGT::Index::getVersion() << endl;
   if (NGT::Index::getVersion() != NGT::Version::getVersion()) {
     version(cerr);
@@ -82,8 +82,16 @@ main(int argc, char **argv)
       ngt.append(args);
     } else if (command == "remove") {
       ngt.remove(args);
+    } else if (command == "compact") {
+      ngt.compact(args);
     } else if (command == "export") {
       ngt.exportIndex(args);
+    } else if (command == "export-mapped") {
+      ngt.exportMappedIndex(args);
+    } else if (command == "export-sector") {
+      ngt.exportSectorIndex(args);
+    } else if (command == "warmup") {
+      ngt.warmup(args);
     } else if (command == "import") {
       ngt.importIndex(args);
     } else if (command == "prune") {
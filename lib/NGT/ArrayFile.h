@@ -24,6 +24,12 @@
 #include <stdexcept>
 #include <cerrno>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <streambuf>
+#include <unistd.h>
+#include <fcntl.h>
 
 namespace NGT {
   class ObjectSpace;
@@ -42,11 +48,21 @@ class ArrayFile {
     uint64_t extraData; // reserve    
   };
 
+  // MemoryBuffer lets the objects deserialize themselves from the records read with pread.
+  class MemoryBuffer : public std::streambuf {
+  public:
+    void set(char *buffer, size_t size) { setg(buffer, buffer, buffer + size); }
+  };
+
   bool _isOpen;  
   std::fstream _stream;
   FileHeadStruct _fileHead;
+  int _fd;				// read only descriptor for the thread-safe read path
+  std::atomic<bool> _unflushed;	// written records might remain in the buffer of the stream
 
   bool _readFileHead();
+  void _flush();
+  bool _read(uint64_t offset, size_t size, std::vector<char> &buffer);
   pthread_mutex_t _mutex;
   
  public:
@@ -58,6 +74,7 @@ class ArrayFile {
   size_t insert(TYPE &data, NGT::ObjectSpace *objectSpace = 0);
   void put(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace = 0);
   bool get(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace = 0);
+  bool getMultiple(const std::vector<size_t> &ids, std::vector<TYPE*> &data, NGT::ObjectSpace *objectSpace = 0);
   void remove(const size_t id);
   bool isOpen() const;
   size_t size();
@@ -68,7 +85,7 @@ class ArrayFile {
 // constructor 
 template <class TYPE>
 ArrayFile<TYPE>::ArrayFile()
-  : _isOpen(false), _mutex((pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER){
+  : _isOpen(false), _fd(-1), _unflushed(false), _mutex((pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER){
     if(pthread_mutex_init(&_mutex, NULL) < 0) throw std::runtime_error("pthread init error.");
 }
 
@@ -104,6 +121,9 @@ bool ArrayFile<TYPE>::open(const std::string &file) {
     return false;
   }
   _isOpen = true;
+  // records are read with pread through this descriptor, otherwise with the stream under the lock.
+  _fd = ::open(file.c_str(), O_RDONLY);
+  _unflushed = false;
 
   bool ret = _readFileHead();
   return ret;
@@ -112,6 +132,10 @@ bool ArrayFile<TYPE>::open(const std::string &file) {
 template <class TYPE>
 void ArrayFile<TYPE>::close(){
   _stream.close();
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
   _isOpen = false;  
 }
 
@@ -129,6 +153,7 @@ size_t ArrayFile<TYPE>::insert(TYPE &data, NGT::ObjectSpace *objectSpace) {
   if(offset_pos % (sizeof(RecordStruct) + _fileHead.recordSize) == 0){
     id -= 1;
   }
+  _unflushed = true;
   
   return id;
 }
@@ -142,10 +167,25 @@ void ArrayFile<TYPE>::put(const size_t id, TYPE &data, NGT::ObjectSpace *objectS
   for(size_t i = 0; i < _fileHead.recordSize; i++) { _stream.write("", 1); }
   _stream.seekp(offset_pos, std::ios::beg); 
   data.serialize(_stream, objectSpace);
+  _unflushed = true;
 }
 
 template <class TYPE>
 bool ArrayFile<TYPE>::get(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace) {
+  if (_fd >= 0) {
+    uint64_t offset_pos = (id * (sizeof(RecordStruct) + _fileHead.recordSize)) + sizeof(FileHeadStruct);
+    offset_pos += sizeof(RecordStruct);
+    std::vector<char> buffer;
+    if (!_read(offset_pos, _fileHead.recordSize, buffer)) {
+      return false;
+    }
+    MemoryBuffer memoryBuffer;
+    memoryBuffer.set(buffer.data(), buffer.size());
+    std::istream is(&memoryBuffer);
+    data.deserialize(is, objectSpace);
+    return true;
+  }
+
   pthread_mutex_lock(&_mutex);
 
   if( size() <= id ){
@@ -183,12 +223,64 @@ bool ArrayFile<TYPE>::get(const size_t id, TYPE &data, NGT::ObjectSpace *objectS
   return true;
 }
 
+// the records are read in the order of the IDs, and the adjacent records are read at once.
+// data[i] receives the record of ids[i]. false is returned if any of the IDs is out of range.
+template <class TYPE>
+bool ArrayFile<TYPE>::getMultiple(const std::vector<size_t> &ids, std::vector<TYPE*> &data, NGT::ObjectSpace *objectSpace) {
+  if (ids.size() != data.size()) {
+    throw std::runtime_error("ArrayFile::getMultiple: The sizes of the IDs and the data are inconsistent.");
+  }
+  if (_fd < 0) {
+    bool found = true;
+    for (size_t i = 0; i < ids.size(); i++) {
+      found = get(ids[i], *data[i], objectSpace) && found;
+    }
+    return found;
+  }
+  std::vector<size_t> order(ids.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&ids](size_t a, size_t b) { return ids[a] < ids[b]; });
+  const size_t stride = sizeof(RecordStruct) + _fileHead.recordSize;
+  bool found = true;
+  std::vector<char> buffer;
+  MemoryBuffer memoryBuffer;
+  std::istream is(&memoryBuffer);
+  for (size_t begin = 0; begin < order.size();) {
+    size_t end = begin + 1;
+    while (end < order.size() && ids[order[end]] - ids[order[end - 1]] <= 1) {
+      end++;
+    }
+    size_t firstID = ids[order[begin]];
+    size_t lastID = ids[order[end - 1]];
+    uint64_t offset_pos = firstID * stride + sizeof(FileHeadStruct);
+    if (!_read(offset_pos, (lastID - firstID + 1) * stride, buffer)) {
+      // the tail of the run is out of range, then the records are read one by one.
+      for (size_t i = begin; i < end; i++) {
+	found = get(ids[order[i]], *data[order[i]], objectSpace) && found;
+      }
+      begin = end;
+      continue;
+    }
+    for (size_t i = begin; i < end; i++) {
+      size_t idx = order[i];
+      memoryBuffer.set(buffer.data() + (ids[idx] - firstID) * stride + sizeof(RecordStruct), _fileHead.recordSize);
+      is.clear();
+      data[idx]->deserialize(is, objectSpace);
+    }
+    begin = end;
+  }
+  return found;
+}
+
 template <class TYPE>
 void ArrayFile<TYPE>::remove(const size_t id) {
   uint64_t offset_pos = (id * (sizeof(RecordStruct) + _fileHead.recordSize)) + sizeof(FileHeadStruct);  
   _stream.seekp(offset_pos, std::ios::beg);
   RecordStruct recordHead = {1, 0};
   _stream.write((char *)(&recordHead), sizeof(RecordStruct));
+  _unflushed = true;
 }
 
 template <class TYPE>
@@ -218,3 +310,37 @@ bool ArrayFile<TYPE>::_readFileHead() {
   return true;
 }
 
+template <class TYPE>
+void ArrayFile<TYPE>::_flush() {
+  if (!_unflushed) {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  if (_unflushed) {
+    _stream.flush();
+    _unflushed = false;
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+template <class TYPE>
+bool ArrayFile<TYPE>::_read(uint64_t offset, size_t size, std::vector<char> &buffer) {
+  _flush();
+  buffer.resize(size);
+  size_t pos = 0;
+  while (pos < size) {
+    ssize_t ret = pread(_fd, buffer.data() + pos, size - pos, offset + pos);
+    if (ret < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      throw std::runtime_error(std::string("ArrayFile::get: Cannot read. ") + strerror(errno));
+    }
+    if (ret == 0) {
+      // beyond the end of the file.
+      return false;
+    }
+    pos += ret;
+  }
+  return true;
+}
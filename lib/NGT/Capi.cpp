@@ -20,6 +20,7 @@
 
 #include "NGT/Index.h"
 #include "NGT/GraphOptimizer.h"
+#include "NGT/MappedIndex.h"
 #include "Capi.h"
 
 static bool operate_error_string_(const std::stringstream &ss, NGTError error){
@@ -629,6 +630,55 @@ bool ngt_remove_index(NGTIndex index, ObjectID id, NGTError error) {
   return true;
 }
 
+bool ngt_update_index_as_float(NGTIndex index, ObjectID id, float *obj, uint32_t obj_dim, NGTError error) {
+  if(index == NULL || obj == NULL || obj_dim == 0){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index << " obj = " << obj << " obj_dim = " << obj_dim;
+    operate_error_string_(ss, error);
+    return false;
+  }
+
+  try{
+    NGT::Index* pindex = static_cast<NGT::Index*>(index);
+    std::vector<float> vobj(&obj[0], &obj[obj_dim]);
+    pindex->update(id, vobj);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
+bool ngt_batch_update_index(NGTIndex index, ObjectID *ids, float *obj, uint32_t data_count, uint32_t pool_size, NGTError error) {
+  if(index == NULL || ids == NULL || obj == NULL || data_count == 0){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index << " ids = " << ids << " obj = " << obj << " data_count = " << data_count;
+    operate_error_string_(ss, error);
+    return false;
+  }
+
+  try{
+    NGT::Index* pindex = static_cast<NGT::Index*>(index);
+    int32_t dim = pindex->getObjectSpace().getDimension();
+    std::vector<NGT::ObjectID> vids(ids, ids + data_count);
+    std::vector<std::vector<float> > vobjs;
+    vobjs.reserve(data_count);
+    float *objptr = obj;
+    for (size_t idx = 0; idx < data_count; idx++, objptr += dim) {
+      vobjs.push_back(std::vector<float>(objptr, objptr + dim));
+    }
+    pindex->update(vids, vobjs, pool_size);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
 NGTObjectSpace ngt_get_object_space(NGTIndex index, NGTError error) {
   if(index == NULL){
     std::stringstream ss;
@@ -986,3 +1036,85 @@ bool ngt_optimize_number_of_edges(const char *indexPath, NGTAnngEdgeOptimization
   return true;
 
 }
+
+bool ngt_export_mapped_index(const char *indexPath, NGTError error)
+{
+  try {
+    NGT::MappedIndex::build(std::string(indexPath));
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
+NGTMappedIndex ngt_open_mapped_index(const char *indexPath, NGTError error)
+{
+  try {
+    NGT::MappedIndex *index = new NGT::MappedIndex(std::string(indexPath));
+    return static_cast<NGTMappedIndex>(index);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return NULL;
+  }
+}
+
+bool ngt_search_mapped_index_as_float(NGTMappedIndex index, float *query, int32_t query_dim, size_t size, float epsilon, float radius, int edge_size, NGTObjectDistances results, NGTError error)
+{
+  if(index == NULL || query == NULL || results == NULL || query_dim <= 0){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index << " query = " << query << " results = " << results << " query_dim = " << query_dim;
+    operate_error_string_(ss, error);
+    return false;
+  }
+
+  NGT::MappedIndex *pindex = static_cast<NGT::MappedIndex*>(index);
+  NGT::Object *ngtquery = NULL;
+
+  if(radius < 0.0){
+    radius = FLT_MAX;
+  }
+
+  try{
+    std::vector<float> vquery(&query[0], &query[query_dim]);
+    ngtquery = pindex->allocateObject(vquery);
+    NGT::SearchContainer sc(*ngtquery);
+    sc.setResults(static_cast<NGT::ObjectDistances*>(results));
+    sc.setSize(size);
+    sc.setRadius(radius);
+    sc.setEpsilon(epsilon);
+    if (edge_size != INT_MIN) {
+      sc.setEdgeSize(edge_size);
+    }
+    pindex->search(sc);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    pindex->deleteObject(ngtquery);
+    return false;
+  }
+  pindex->deleteObject(ngtquery);
+  return true;
+}
+
+bool ngt_is_mapped_index_replaced(NGTMappedIndex index, NGTError error)
+{
+  if(index == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return static_cast<NGT::MappedIndex*>(index)->isReplaced();
+}
+
+void ngt_close_mapped_index(NGTMappedIndex index)
+{
+  if(index == NULL) return;
+  delete static_cast<NGT::MappedIndex*>(index);
+}
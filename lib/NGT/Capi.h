@@ -31,6 +31,7 @@ typedef void* NGTObjectSpace;
 typedef void* NGTObjectDistances;
 typedef void* NGTError;
 typedef void* NGTOptimizer;
+typedef void* NGTMappedIndex;
 
 typedef struct {
   ObjectID id;
@@ -133,6 +134,10 @@ bool ngt_create_index(NGTIndex, uint32_t, NGTError);
 
 bool ngt_remove_index(NGTIndex, ObjectID, NGTError);
 
+bool ngt_update_index_as_float(NGTIndex, ObjectID, float*, uint32_t, NGTError);
+
+bool ngt_batch_update_index(NGTIndex, ObjectID*, float*, uint32_t, uint32_t, NGTError);
+
 NGTObjectSpace ngt_get_object_space(NGTIndex, NGTError);
 
 float* ngt_get_object_as_float(NGTObjectSpace, ObjectID, NGTError);
@@ -205,6 +210,20 @@ NGTAnngEdgeOptimizationParameter ngt_get_anng_edge_optimization_parameter();
 // The parameter should be a struct which is returned by nt_get_optimization_parameter.
 bool ngt_optimize_number_of_edges(const char *indexPath, NGTAnngEdgeOptimizationParameter parameter, NGTError error);
 
+// write the read-only image of the index that is specified with indexPath. See ngt export-mapped.
+bool ngt_export_mapped_index(const char *indexPath, NGTError error);
+
+// open the read-only image of the index. The image is mapped and shared among the processes which open it.
+NGTMappedIndex ngt_open_mapped_index(const char *indexPath, NGTError error);
+
+// edge_size: the same as the one of NGTQuery. if it is INT_MIN, default is used.
+bool ngt_search_mapped_index_as_float(NGTMappedIndex, float*, int32_t, size_t, float, float, int, NGTObjectDistances, NGTError);
+
+// return true if the image was exported again after it was opened.
+bool ngt_is_mapped_index_replaced(NGTMappedIndex, NGTError);
+
+void ngt_close_mapped_index(NGTMappedIndex);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,7 @@ using namespace std;
     try {
       objectPath = args.get("#2");
     } catch (...) {}
+    objectFormat = args.getString("F", "");
 
     property.edgeSizeForCreation = args.getl("E", 10);
     property.edgeSizeForSearch = args.getl("S", 40);
@@ -55,6 +56,16 @@ using namespace std;
 
     property.objectAlignment = args.getChar("A", 'f') == 't' ? NGT::Property::ObjectAlignmentTrue : NGT::Property::ObjectAlignmentFalse;
 
+    char searchGraphCompression = args.getChar("C", 'n');
+    switch(searchGraphCompression) {
+    case 'n': property.searchGraphCompression = NGT::Property::SearchGraphCompressionNone; break;
+    case 'v': property.searchGraphCompression = NGT::Property::SearchGraphCompressionVarint; break;
+    default:
+      std::stringstream msg;
+      msg << "Command::CreateParameter: Error: Invalid search graph compression. " << searchGraphCompression;
+      NGTThrowException(msg);
+    }
+
     char graphType = args.getChar("g", 'a');
     switch(graphType) {
     case 'a': property.graphType = NGT::Property::GraphType::GraphTypeANNG; break;
@@ -166,9 +177,59 @@ using namespace std;
 	= property.treeSharedMemorySize
 	= property.objectSharedMemorySize = 512 * ceil(maxNoOfObjects / 50000000);
     }
+    parseMemoryMapOption(args.getString("H", ""), property);
+#else
+    property.journalCompactionRate = args.getf("J", 0.0);
+    char repositoryFormat = args.getChar("R", 'l');
+    switch(repositoryFormat) {
+    case 'l': property.repositoryFormat = NGT::Property::RepositoryFormatLegacy; break;
+    case 'c': property.repositoryFormat = NGT::Property::RepositoryFormatChunked; break;
+    default:
+      std::stringstream msg;
+      msg << "Command::CreateParameter: Error: Invalid repository format. " << repositoryFormat;
+      NGTThrowException(msg);
+    }
 #endif
   }
 
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+  // The option consists of the following characters.
+  //   h : transparent huge pages, p : prefault, i : interleave across NUMA nodes,
+  //   b[node] : bind to the node or to the nodes in turn for each unit, n : none
+  void
+  NGT::Command::parseMemoryMapOption(const std::string &option, NGT::Property &prop)
+  {
+    for (size_t i = 0; i < option.size(); i++) {
+      switch (option[i]) {
+      case 'h': prop.mmapHugePage = 1; break;
+      case 'p': prop.mmapPopulate = 1; break;
+      case 'i': prop.mmapNumaPolicy = NGT::Property::NumaPolicyInterleave; break;
+      case 'b':
+	{
+	  prop.mmapNumaPolicy = NGT::Property::NumaPolicyBind;
+	  prop.mmapNumaNode = -1;
+	  size_t end = option.find_first_not_of("0123456789", i + 1);
+	  end = end == std::string::npos ? option.size() : end;
+	  if (end > i + 1) {
+	    prop.mmapNumaNode = NGT::Common::strtol(option.substr(i + 1, end - i - 1));
+	  }
+	  i = end - 1;
+	}
+	break;
+      case 'n':
+	prop.mmapHugePage = 0;
+	prop.mmapPopulate = 0;
+	prop.mmapNumaPolicy = NGT::Property::NumaPolicyNone;
+	break;
+      default:
+	std::stringstream msg;
+	msg << "Command::parseMemoryMapOption: Error: Invalid memory mapping option. " << option;
+	NGTThrowException(msg);
+      }
+    }
+  }
+#endif
+
   void 
   NGT::Command::create(Args &args)
   {
@@ -177,9 +238,11 @@ using namespace std;
       "[-t truncation-edge-limit] [-E edge-size] [-S edge-size-for-search] [-L edge-size-limit] "
       "[-e epsilon] [-o object-type(f|c)] [-D distance-function(1|2|a|A|h|j|c|C|E|p|l)] [-n #-of-inserted-objects] "  // added by Nyapicom
       "[-P path-adjustment-interval] [-B dynamic-edge-size-base] [-A object-alignment(t|f)] "
-      "[-T build-time-limit] [-O outgoing x incoming] "
+      "[-T build-time-limit] [-O outgoing x incoming] [-F data-format(t|fvecs|bvecs|ivecs|npy|f32|u8)] "
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-      "[-N maximum-#-of-inserted-objects] "
+      "[-N maximum-#-of-inserted-objects] [-H mmap-option(h|p|i|b[node]|n)] "
+#else
+      "[-J journal-compaction-rate] [-C search-graph-compression(n|v)] [-R repository-format(l|c)] "
 #endif
       "index(output) [data.tsv(input)]";
 
@@ -200,10 +263,12 @@ using namespace std;
 
       switch (createParameters.indexType) {
       case 't':
-	NGT::Index::createGraphAndTree(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects);
+	NGT::Index::createGraphAndTree(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects,
+				       false, createParameters.objectFormat);
 	break;
       case 'g':
-	NGT::Index::createGraph(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects);
+	NGT::Index::createGraph(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects,
+				false, createParameters.objectFormat);
 	break;
       }
     } catch(NGT::Exception &err) {
@@ -216,6 +281,7 @@ using namespace std;
   NGT::Command::append(Args &args)
   {
     const string usage = "Usage: ngt append [-p #-of-thread] [-d dimension] [-n data-size] "
+      "[-F data-format(t|fvecs|bvecs|ivecs|npy|f32|u8)] "
       "index(output) [data.tsv(input)]";
     string database;
     try {
@@ -235,6 +301,7 @@ using namespace std;
     int threadSize = args.getl("p", 50);
     size_t dimension = args.getl("d", 0);
     size_t dataSize = args.getl("n", 0);
+    string dataFormat = args.getString("F", "");
 
     if (debugLevel >= 1) {
       cerr << "thread size=" << threadSize << endl;
@@ -243,7 +310,7 @@ using namespace std;
 
 
     try {
-      NGT::Index::append(database, data, threadSize, dataSize);	
+      NGT::Index::append(database, data, threadSize, dataSize, dataFormat);
     } catch (NGT::Exception &err) {
       cerr << "ngt: Error " << err.what() << endl;
       cerr << usage << endl;
@@ -410,10 +477,117 @@ using namespace std;
   }
 
 
+  // search the images such as the mapped index and the sector index.
+  template <class INDEX> static void
+  searchImage(INDEX &index, NGT::Command::SearchParameters &searchParameters, istream &is, ostream &stream)
+  {
+    if (searchParameters.indexType == 's') {
+      NGTThrowException("ngt: Error: Linear search is not available for the mapped index and the sector index.");
+    }
+    if (searchParameters.outputMode[0] == 'e') { 
+      stream << "# Beginning of Evaluation" << endl; 
+    }
+
+    string line;
+    double totalTime	= 0;
+    size_t queryCount	= 0;
+    while(getline(is, line)) {
+      if (searchParameters.querySize > 0 && queryCount >= searchParameters.querySize) {
+	break;
+      }
+      NGT::Object *object = index.allocateObject(line, " \t");
+      queryCount++;
+      size_t step = searchParameters.step == 0 ? UINT_MAX : searchParameters.step;
+      for (size_t n = 0; n <= step; n++) {
+	NGT::SearchContainer sc(*object);
+	double epsilon;
+	if (searchParameters.step != 0) {
+	  epsilon = searchParameters.beginOfEpsilon + (searchParameters.endOfEpsilon - searchParameters.beginOfEpsilon) * n / step; 
+	} else {
+	  epsilon = searchParameters.beginOfEpsilon + searchParameters.stepOfEpsilon * n;
+	  if (epsilon > searchParameters.endOfEpsilon) {
+	    break;
+	  }
+	}
+	NGT::ObjectDistances objects;
+	sc.setResults(&objects);
+	sc.setSize(searchParameters.size);
+	sc.setRadius(searchParameters.radius);
+	sc.setEpsilon(epsilon);
+ 	sc.setEdgeSize(searchParameters.edgeSize);
+	NGT::Timer timer;
+	size_t trial = searchParameters.outputMode[0] == 'e' && searchParameters.trial > 1 ? searchParameters.trial : 1;
+	double minTime = DBL_MAX;
+	for (size_t t = 0; t < trial; t++) {
+	  switch (searchParameters.indexType) {
+	  case 't': timer.start(); index.search(sc); timer.stop(); break;
+	  case 'g': timer.start(); index.searchUsingOnlyGraph(sc); timer.stop(); break;
+	  }
+	  minTime = minTime > timer.time ? timer.time : minTime;
+	}
+	timer.time = minTime;
+	totalTime += timer.time;
+	if (searchParameters.outputMode[0] == 'e') {
+	  stream << "# Query No.=" << queryCount << endl;
+	  stream << "# Query=" << line.substr(0, 20) + " ..." << endl;
+	  stream << "# Index Type=" << searchParameters.indexType << endl;
+	  stream << "# Size=" << searchParameters.size << endl;
+	  stream << "# Radius=" << searchParameters.radius << endl;
+	  stream << "# Epsilon=" << epsilon << endl;
+	  stream << "# Query Time (msec)=" << timer.time * 1000.0 << endl;
+	  stream << "# Distance Computation=" << sc.distanceComputationCount << endl;
+	  stream << "# Visit Count=" << sc.visitCount << endl;
+	} else {
+	  stream << "Query No." << queryCount << endl;
+	  stream << "Rank\tID\tDistance" << endl;
+	}
+	for (size_t i = 0; i < objects.size(); i++) {
+	  stream << i + 1 << "\t" << objects[i].id << "\t";
+	  stream << objects[i].distance << endl;
+	}
+	if (searchParameters.outputMode[0] == 'e') {
+	  stream << "# End of Search" << endl;
+	} else {
+	  stream << "Query Time= " << timer.time << " (sec), " << timer.time * 1000.0 << " (msec)" << endl;
+	}
+      } // for
+      index.deleteObject(object);
+      if (searchParameters.outputMode[0] == 'e') {
+	stream << "# End of Query" << endl;
+      }
+    } // while
+    if (searchParameters.outputMode[0] == 'e') {
+      stream << "# Average Query Time (msec)=" << totalTime * 1000.0 / (double)queryCount << endl;
+      stream << "# Number of queries=" << queryCount << endl;
+      stream << "# End of Evaluation" << endl;
+    } else {
+      stream << "Average Query Time= " << totalTime / (double)queryCount  << " (sec), " 
+	   << totalTime * 1000.0 / (double)queryCount << " (msec), (" 
+	   << totalTime << "/" << queryCount << ")" << endl;
+    }
+  }
+
+  void
+  NGT::Command::search(NGT::MappedIndex &index, NGT::Command::SearchParameters &searchParameters, istream &is, ostream &stream)
+  {
+    searchImage(index, searchParameters, is, stream);
+  }
+
+  void
+  NGT::Command::search(NGT::SectorIndex &index, NGT::Command::SearchParameters &searchParameters, istream &is, ostream &stream)
+  {
+    index.setBeamWidth(searchParameters.beamWidth);
+    searchImage(index, searchParameters, is, stream);
+  }
+
   void
   NGT::Command::search(Args &args) {
     const string usage = "Usage: ngt search [-i index-type(g|t|s)] [-n result-size] [-e epsilon] [-E edge-size] "
-      "[-m open-mode(r|w)] [-o output-mode] index(input) query.tsv(input)";
+      "[-m open-mode(r|w|m|d)] [-w beam-width] [-o output-mode] "
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      "[-H mmap-option(h|p|i|b[node]|n)] "
+#endif
+      "index(input) query.tsv(input)";
 
     string database;
     try {
@@ -435,8 +609,37 @@ using namespace std;
     }
 
     try {
-      NGT::Index	index(database, searchParameters.openMode == 'r');
-      search(index, searchParameters, cout);
+      if (searchParameters.openMode == 'm') {
+	NGT::MappedIndex	index(database);
+	ifstream		is(searchParameters.query);
+	if (!is) {
+	  cerr << "Cannot open the specified file. " << searchParameters.query << endl;
+	  return;
+	}
+	search(index, searchParameters, is, cout);
+      } else if (searchParameters.openMode == 'd') {
+	NGT::SectorIndex	index(database);
+	ifstream		is(searchParameters.query);
+	if (!is) {
+	  cerr << "Cannot open the specified file. " << searchParameters.query << endl;
+	  return;
+	}
+	if (debugLevel >= 1) {
+	  cerr << "asynchronousRead=" << index.isAsynchronous() << endl;
+	}
+	search(index, searchParameters, is, cout);
+      } else {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	NGT::Property	mmapProperty;
+	mmapProperty.clear();
+	parseMemoryMapOption(searchParameters.mmapOption, mmapProperty);
+	NGT::Index	index;
+	index.open(database, searchParameters.openMode == 'r', mmapProperty);
+#else
+	NGT::Index	index(database, searchParameters.openMode == 'r');
+#endif
+	search(index, searchParameters, cout);
+      }
     } catch (NGT::Exception &err) {
       cerr << "ngt: Error " << err.what() << endl;
       cerr << usage << endl;
@@ -531,6 +734,47 @@ using namespace std;
     }
   }
 
+  void
+  NGT::Command::compact(Args &args)
+  {
+    const string usage = "Usage: ngt compact index(input) [id-map(output)]";
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string mapFile;
+    try {
+      mapFile = args.get("#2");
+    } catch (...) {}
+
+    try {
+      vector<NGT::ObjectID> newIDs;
+      NGT::Index::compact(database, newIDs);
+      if (!mapFile.empty()) {
+	ofstream os(mapFile);
+	if (!os) {
+	  cerr << "ngt: Error: Cannot open the specified file. " << mapFile << endl;
+	  return;
+	}
+	for (size_t id = 1; id < newIDs.size(); id++) {
+	  if (newIDs[id] != 0) {
+	    os << id << "\t" << newIDs[id] << endl;
+	  }
+	}
+      }
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    } catch (...) {
+      cerr << "ngt: Error" << endl;
+      cerr << usage << endl;
+    }
+  }
+
   void
   NGT::Command::exportIndex(Args &args)
   {
@@ -562,6 +806,114 @@ using namespace std;
     }
   }
 
+  void
+  NGT::Command::exportMappedIndex(Args &args)
+  {
+    const string usage = "Usage: ngt export-mapped index(input)";
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    try {
+      NGT::Timer timer;
+      timer.start();
+      NGT::MappedIndex::build(database);
+      timer.stop();
+      cerr << "ngt: the mapped index was written to " << NGT::MappedIndex::getFileName(database) << ". time=" << timer << endl;
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::exportSectorIndex(Args &args)
+  {
+    const string usage = "Usage: ngt export-sector [-E max-edge-size] index(input)";
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t maxEdgeSize = args.getl("E", 0);
+    try {
+      NGT::Timer timer;
+      timer.start();
+      NGT::SectorIndex::build(database, maxEdgeSize);
+      timer.stop();
+      cerr << "ngt: the sector index was written to " << NGT::SectorIndex::getFileName(database) << ". time=" << timer << endl;
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::warmup(Args &args)
+  {
+    const string usage = "Usage: ngt warmup [-m open-mode(r|m)] [-Q query-size] [-e epsilon] [-n result-size] "
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      "[-H mmap-option(h|p|i|b[node]|n)] "
+#endif
+      "index(input) [query.tsv(input)]";
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string query;
+    try {
+      query = args.get("#2");
+    } catch (...) {}
+    NGT::Index::WarmupMode mode = query.empty() ? NGT::Index::WarmupModeSweep : NGT::Index::WarmupModeQuery;
+    char openMode	= args.getChar("m", 'r');
+    size_t querySize	= args.getl("Q", 0);
+    float epsilon	= args.getf("e", 0.1);
+    size_t resultSize	= args.getl("n", 20);
+
+    try {
+      NGT::Timer timer;
+      size_t loadedSize;
+      int residentSize;
+      if (openMode == 'm') {
+	NGT::MappedIndex index(database);
+	timer.start();
+	loadedSize = index.warmup(mode, query, querySize, epsilon, resultSize);
+	timer.stop();
+	residentSize = NGT::Common::getProcessVmRSS();
+      } else {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	NGT::Property	mmapProperty;
+	mmapProperty.clear();
+	parseMemoryMapOption(args.getString("H", ""), mmapProperty);
+	NGT::Index	index;
+	index.open(database, true, mmapProperty);
+#else
+	NGT::Index	index(database, true);
+#endif
+	timer.start();
+	loadedSize = index.warmup(mode, query, querySize, epsilon, resultSize);
+	timer.stop();
+	residentSize = NGT::Common::getProcessVmRSS();
+      }
+      cerr << "ngt: warmup (" << (mode == NGT::Index::WarmupModeSweep ? "sweep" : "query") << ") loaded="
+	   << loadedSize / 1024.0 / 1024.0 << "MB resident=" << residentSize / 1024.0 << "MB time=" << timer << endl;
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
   void
   NGT::Command::importIndex(Args &args)
   {
@@ -16,6 +16,8 @@
 #pragma once
 
 #include	"NGT/Index.h"
+#include	"NGT/MappedIndex.h"
+#include	"NGT/SectorIndex.h"
 
 namespace NGT {
 
@@ -29,6 +31,7 @@ public:
 
     std::string index;
     std::string objectPath;
+    std::string objectFormat;
     size_t numOfObjects;
     NGT::Property property;
     char indexType;
@@ -85,6 +88,8 @@ public:
 	if (tokens.size() >= 4) { step = NGT::Common::strtol(tokens[3]); }
       }
       accuracy		= args.getf("a", 0.0);
+      mmapOption	= args.getString("H", "");
+      beamWidth		= args.getl("w", NGT::SectorIndex::defaultBeamWidth);
     }
     char	openMode;
     std::string	query;
@@ -100,10 +105,15 @@ public:
     float	accuracy;
     size_t	step;
     size_t	trial;
+    std::string	mmapOption;
+    size_t	beamWidth;
   };
 
   Command():debugLevel(0) {}
 
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+  static void parseMemoryMapOption(const std::string &option, NGT::Property &prop);
+#endif
   void create(Args &args);
   void append(Args &args);
   static void search(NGT::Index &index, SearchParameters &searchParameters, std::ostream &stream)
@@ -116,9 +126,15 @@ public:
     search(index, searchParameters, is, stream);
   }
   static void search(NGT::Index &index, SearchParameters &searchParameters, std::istream &is, std::ostream &stream);
+  static void search(NGT::MappedIndex &index, SearchParameters &searchParameters, std::istream &is, std::ostream &stream);
+  static void search(NGT::SectorIndex &index, SearchParameters &searchParameters, std::istream &is, std::ostream &stream);
   void search(Args &args);
   void remove(Args &args);
+  void compact(Args &args);
   void exportIndex(Args &args);
+  void exportMappedIndex(Args &args);
+  void exportSectorIndex(Args &args);
+  void warmup(Args &args);
   void importIndex(Args &args);
   void prune(Args &args);
   void reconstructGraph(Args &args);
@@ -32,9 +32,14 @@
 #include	<iomanip>
 #include	<algorithm>
 #include	<typeinfo>
+#include	<mutex>
+#include	<unordered_set>
 
 #include	<sys/time.h>
 #include	<fcntl.h>
+#ifdef _OPENMP
+#include	<omp.h>
+#endif
 
 #include	"NGT/defines.h"
 #include	"NGT/SharedMemoryAllocator.h"
@@ -808,6 +813,178 @@ namespace NGT {
 
   } // namespace Serialize
 
+  // Binary repositories are encoded and decoded by multiple threads as independently decodable chunks of entries.
+  class ChunkedSerializer {
+  public:
+    static const uint64_t	magic = 0x314b4e484354474eULL;	// "NGTCHNK1"
+    static const size_t		defaultChunkSize = 16384;
+
+    class Chunk {
+    public:
+      uint64_t	begin;
+      uint64_t	end;
+      uint64_t	offset;
+      uint64_t	size;
+    };
+
+    class MemoryBuffer : public std::streambuf {
+    public:
+      MemoryBuffer(char *data, size_t size) { setg(data, data, data + size); }
+    };
+
+    static size_t getNumberOfThreads() {
+#ifdef _OPENMP
+      return omp_get_max_threads();
+#else
+      return 1;
+#endif
+    }
+
+    // encode(os, idx) writes the idx-th entry to os.
+    template <typename ENCODER>
+      static void write(std::ostream &os, size_t size, ENCODER encode, bool chunked = false, size_t chunkSize = defaultChunkSize) {
+      std::vector<Chunk> chunks((size + chunkSize - 1) / chunkSize);
+      std::streampos top = os.tellp();
+      std::streampos table = top;
+      for (size_t ci = 0; ci < chunks.size(); ci++) {
+	chunks[ci].begin = ci * chunkSize;
+	chunks[ci].end = std::min(chunks[ci].begin + chunkSize, static_cast<uint64_t>(size));
+      }
+      if (chunked) {
+	Serializer::write(os, magic);
+	Serializer::write(os, static_cast<uint64_t>(size));
+	Serializer::write(os, static_cast<uint64_t>(chunks.size()));
+	table = os.tellp();
+	for (size_t ci = 0; ci < chunks.size(); ci++) {
+	  writeChunk(os, chunks[ci]);
+	}
+      } else {
+	Serializer::write(os, static_cast<uint64_t>(size));
+      }
+      uint64_t offset = os.tellp() - top;
+      const size_t wave = getNumberOfThreads();
+      std::vector<std::string> buffers(wave);
+      for (size_t first = 0; first < chunks.size(); first += wave) {
+	size_t last = std::min(first + wave, chunks.size());
+	bool error = false;
+	std::string message;
+#pragma omp parallel for
+	for (size_t ci = first; ci < last; ci++) {
+	  try {
+	    std::ostringstream oss;
+	    for (size_t idx = chunks[ci].begin; idx < chunks[ci].end; idx++) {
+	      encode(oss, idx);
+	    }
+	    buffers[ci - first] = oss.str();
+	  } catch (Exception &err) {
+#pragma omp critical
+	    {
+	      error = true;
+	      message = err.what();
+	    }
+	  }
+	}
+	if (error) {
+	  NGTThrowException("NGT::ChunkedSerializer::write: " + message);
+	}
+	for (size_t ci = first; ci < last; ci++) {
+	  std::string &buffer = buffers[ci - first];
+	  chunks[ci].offset = offset;
+	  chunks[ci].size = buffer.size();
+	  os.write(buffer.data(), buffer.size());
+	  offset += buffer.size();
+	  std::string().swap(buffer);
+	}
+      }
+      if (!chunked) {
+	return;
+      }
+      std::streampos end = os.tellp();
+      os.seekp(table);
+      for (size_t ci = 0; ci < chunks.size(); ci++) {
+	writeChunk(os, chunks[ci]);
+      }
+      os.seekp(end);
+    }
+
+    // return false with # of entries if the stream is the legacy format.
+    static bool readHeader(std::istream &is, size_t &size, std::vector<Chunk> &chunks, std::streampos &top) {
+      top = is.tellg();
+      uint64_t head;
+      Serializer::read(is, head);
+      if (head != magic) {
+	size = head;
+	return false;
+      }
+      uint64_t s, n;
+      Serializer::read(is, s);
+      Serializer::read(is, n);
+      size = s;
+      chunks.resize(n);
+      for (size_t ci = 0; ci < n; ci++) {
+	Serializer::read(is, chunks[ci].begin);
+	Serializer::read(is, chunks[ci].end);
+	Serializer::read(is, chunks[ci].offset);
+	Serializer::read(is, chunks[ci].size);
+      }
+      if (!is) {
+	NGTThrowException("NGT::ChunkedSerializer::readHeader: The chunk table is broken.");
+      }
+      return true;
+    }
+
+    // decode(is, idx) reads the idx-th entry from is. The stream is left at the end of the chunks.
+    template <typename DECODER>
+      static void read(std::istream &is, std::streampos top, std::vector<Chunk> &chunks, DECODER decode) {
+      const size_t wave = getNumberOfThreads();
+      std::vector<std::vector<char>> buffers(wave);
+      std::streampos end = is.tellg();
+      for (size_t first = 0; first < chunks.size(); first += wave) {
+	size_t last = std::min(first + wave, chunks.size());
+	for (size_t ci = first; ci < last; ci++) {
+	  std::vector<char> &buffer = buffers[ci - first];
+	  buffer.resize(chunks[ci].size);
+	  is.seekg(top + static_cast<std::streamoff>(chunks[ci].offset));
+	  is.read(buffer.data(), buffer.size());
+	  if (!is) {
+	    NGTThrowException("NGT::ChunkedSerializer::read: Read beyond the end of the file. The file is corrupted?");
+	  }
+	}
+	end = is.tellg();
+	bool error = false;
+	std::string message;
+#pragma omp parallel for
+	for (size_t ci = first; ci < last; ci++) {
+	  try {
+	    MemoryBuffer mb(buffers[ci - first].data(), buffers[ci - first].size());
+	    std::istream cis(&mb);
+	    for (size_t idx = chunks[ci].begin; idx < chunks[ci].end; idx++) {
+	      decode(cis, idx);
+	    }
+	  } catch (Exception &err) {
+#pragma omp critical
+	    {
+	      error = true;
+	      message = err.what();
+	    }
+	  }
+	}
+	if (error) {
+	  NGTThrowException("NGT::ChunkedSerializer::read: " + message);
+	}
+      }
+      is.seekg(end);
+    }
+
+  protected:
+    static void writeChunk(std::ostream &os, Chunk &chunk) {
+      Serializer::write(os, chunk.begin);
+      Serializer::write(os, chunk.end);
+      Serializer::write(os, chunk.offset);
+      Serializer::write(os, chunk.size);
+    }
+  };
+
 
   class ObjectSpace;
 
@@ -1320,13 +1497,13 @@ namespace NGT {
     }
 
 
-    void serialize(std::ofstream &os, NGT::ObjectSpace *objspace = 0) {
+    void serialize(std::ostream &os, NGT::ObjectSpace *objspace = 0) {
       uint32_t sz = size();
       NGT::Serializer::write(os, sz);    
       os.write(reinterpret_cast<char*>(vector), size() * elementSize);
     }
 
-    void deserialize(std::ifstream &is, NGT::ObjectSpace *objectspace = 0) {
+    void deserialize(std::istream &is, NGT::ObjectSpace *objectspace = 0) {
       uint32_t sz;
       try {
 	NGT::Serializer::read(is, sz);
@@ -1380,11 +1557,11 @@ namespace NGT {
     PersistentRepository():array(0) {}
     ~PersistentRepository() { close(); }
 
-    void open(const std::string &mapfile, size_t sharedMemorySize) {
+    void open(const std::string &mapfile, size_t sharedMemorySize, const MemoryManager::open_option_st *openOption = 0) {
       assert(array == 0);
       SharedMemoryAllocator &allocator = getAllocator();
 #ifdef ADVANCED_USE_REMOVED_LIST
-      off_t *entryTable = (off_t*)allocator.construct(mapfile, sharedMemorySize);
+      off_t *entryTable = (off_t*)allocator.construct(mapfile, sharedMemorySize, openOption);
       if (entryTable == 0) {
 	entryTable = (off_t*)construct();
 	allocator.setEntry(entryTable);
@@ -1392,7 +1569,7 @@ namespace NGT {
       assert(entryTable != 0);
       initialize(entryTable);
 #else
-      void *entry = allocator.construct(mapfile, sharedMemorySize);
+      void *entry = allocator.construct(mapfile, sharedMemorySize, openOption);
       if (entry == 0) {
 	array = (ARRAY*)construct();
 	allocator.setEntry(array);
@@ -1507,6 +1684,29 @@ namespace NGT {
 #endif
     }
 
+    // move the entries to the new IDs in newIDs, which must not be greater than the old ones.
+    // the entries whose new IDs are zero are deleted.
+    void compact(const std::vector<ObjectID> &newIDs, size_t newSize) {
+      for (size_t idx = 1; idx < size(); idx++) {
+	if (isEmpty(idx)) {
+	  continue;
+	}
+	if (idx >= newIDs.size() || newIDs[idx] == 0) {
+	  erase(idx);
+	  continue;
+	}
+	assert(newIDs[idx] <= idx);
+	if (newIDs[idx] != idx) {
+	  set(newIDs[idx], (*this)[idx]);
+	  set(idx, (TYPE*)0);
+	}
+      }
+      resize(newSize);
+#ifdef ADVANCED_USE_REMOVED_LIST
+      removedList->clear(allocator);
+#endif
+    }
+
     inline TYPE *get(size_t idx) {
       if (isEmpty(idx)) {
 	std::stringstream msg;
@@ -1516,7 +1716,7 @@ namespace NGT {
       return (*this)[idx];
     }
 
-    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0) {
+    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0, bool chunked = false) {
       NGT::Serializer::write(os, array->size());    
       for (size_t idx = 0; idx < array->size(); idx++) {
 	if ((*this)[idx] == 0) {
@@ -1700,6 +1900,40 @@ namespace NGT {
 
   class ObjectSpace;
 
+  // The IDs of the entries of a repository modified since the last save, which are recorded only while enabled.
+  class ModifiedEntries {
+  public:
+    ModifiedEntries():enabled(false), all(false) {}
+    ModifiedEntries(const ModifiedEntries &m):enabled(false), all(false) {}
+    ModifiedEntries &operator=(const ModifiedEntries &m) { return *this; }
+
+    void add(size_t id) {
+      if (!enabled) {
+	return;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      ids.insert(id);
+    }
+    // all of the entries are regarded as modified.
+    void addAll() { all = enabled; }
+    void enable(bool e) {
+      enabled = e;
+      all = false;
+      std::unordered_set<size_t>().swap(ids);
+    }
+    bool isEnabled() { return enabled; }
+    bool isAll() { return all; }
+    void get(std::vector<size_t> &modified) {
+      modified.assign(ids.begin(), ids.end());
+      std::sort(modified.begin(), modified.end());
+    }
+
+  protected:
+    bool			enabled;
+    bool			all;
+    std::mutex			mutex;
+    std::unordered_set<size_t>	ids;
+  };
 
   template <class TYPE>
     class Repository : public std::vector<TYPE*> {
@@ -1743,6 +1977,7 @@ namespace NGT {
 	NGTThrowException("put: Not empty");  
       }
       (*this)[idx] = n;
+      modifiedEntries.add(idx);
     }
 
     void erase(size_t idx) {
@@ -1751,6 +1986,7 @@ namespace NGT {
       }
       delete (*this)[idx];
       (*this)[idx] = 0;
+      modifiedEntries.add(idx);
     }
 
     void remove(size_t idx) {
@@ -1760,6 +1996,33 @@ namespace NGT {
 #endif
     }
 
+    // move the entries to the new IDs in newIDs, which must not be greater than the old ones.
+    // the entries whose new IDs are zero are deleted.
+    void compact(const std::vector<ObjectID> &newIDs, size_t newSize) {
+      for (size_t idx = 1; idx < std::vector<TYPE*>::size(); idx++) {
+	if ((*this)[idx] == 0) {
+	  continue;
+	}
+	if (idx >= newIDs.size() || newIDs[idx] == 0) {
+	  erase(idx);
+	  continue;
+	}
+	assert(newIDs[idx] <= idx);
+	if (newIDs[idx] != idx) {
+	  (*this)[newIDs[idx]] = (*this)[idx];
+	  (*this)[idx] = 0;
+	}
+      }
+      std::vector<TYPE*>::resize(newSize, 0);
+      std::vector<TYPE*>(*this).swap(*this);
+      modifiedEntries.addAll();
+#ifdef ADVANCED_USE_REMOVED_LIST
+      while (!removedList.empty()) {
+	removedList.pop();
+      }
+#endif
+    }
+
     TYPE **getPtr() { return &(*this)[0]; }
 
     inline TYPE *get(size_t idx) {
@@ -1773,21 +2036,24 @@ namespace NGT {
 
     inline TYPE *getWithoutCheck(size_t idx) { return (*this)[idx]; }
 
-    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0) {
+    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0, bool chunked = false) {
       if (!os.is_open()) {
 	NGTThrowException("NGT::Common: Not open the specified stream yet.");
       }
-      NGT::Serializer::write(os, std::vector<TYPE*>::size());    
-      for (size_t idx = 0; idx < std::vector<TYPE*>::size(); idx++) {
-	if ((*this)[idx] == 0) {
-	  NGT::Serializer::write(os, '-');
+      ChunkedSerializer::write(os, std::vector<TYPE*>::size(), [this, objectspace](std::ostream &cos, size_t idx) {
+	  serialize(cos, idx, objectspace);
+	}, chunked);
+    }
+
+    void serialize(std::ostream &os, size_t idx, ObjectSpace *objectspace) {
+      if ((*this)[idx] == 0) {
+	NGT::Serializer::write(os, '-');
+      } else {
+	NGT::Serializer::write(os, '+');
+	if (objectspace == 0) {
+	  (*this)[idx]->serialize(os);
 	} else {
-	  NGT::Serializer::write(os, '+');
-	  if (objectspace == 0) {
-	    (*this)[idx]->serialize(os);
-	  } else {
-	    (*this)[idx]->serialize(os, objectspace);
-	  }
+	  (*this)[idx]->serialize(os, objectspace);
 	}
       }
     }
@@ -1798,44 +2064,87 @@ namespace NGT {
       }
       deleteAll();
       size_t s;
-      NGT::Serializer::read(is, s);
-      std::vector<TYPE*>::reserve(s);
-      for (size_t i = 0; i < s; i++) {
-	char type;
-	NGT::Serializer::read(is, type);
-	switch(type) {
-	case '-':
-	  {
-	    std::vector<TYPE*>::push_back(0);
+      std::vector<ChunkedSerializer::Chunk> chunks;
+      std::streampos top;
+      bool chunked = ChunkedSerializer::readHeader(is, s, chunks, top);
+      std::vector<TYPE*>::resize(s, 0);
+      if (chunked) {
+	ChunkedSerializer::read(is, top, chunks, [this, objectspace](std::istream &cis, size_t idx) {
+	    deserialize(cis, idx, objectspace);
+	  });
+      } else {
+	for (size_t i = 0; i < s; i++) {
+	  deserialize(is, i, objectspace);
+	}
+      }
 #ifdef ADVANCED_USE_REMOVED_LIST
-	    if (i != 0) {
-	      removedList.push(i);
-	    }
+      for (size_t i = 1; i < s; i++) {
+	if ((*this)[i] == 0) {
+	  removedList.push(i);
+	}
+      }
 #endif
+    }
+
+    void deserialize(std::istream &is, size_t idx, ObjectSpace *objectspace) {
+      char type;
+      NGT::Serializer::read(is, type);
+      switch(type) {
+      case '-':
+	break;
+      case '+':
+	{
+	  if (objectspace == 0) {
+	    TYPE *v = new TYPE;
+	    v->deserialize(is);
+	    (*this)[idx] = v;
+	  } else {
+	    TYPE *v = new TYPE(objectspace);
+	    v->deserialize(is, objectspace);
+	    (*this)[idx] = v;
 	  }
+	}
+	break;
+      default:
+	{
+	  assert(type == '-' || type == '+');
 	  break;
-	case '+':
-	  {
-	    if (objectspace == 0) {
-	      TYPE *v = new TYPE;
-	      v->deserialize(is);
-	      std::vector<TYPE*>::push_back(v);
-	    } else {
-	      TYPE *v = new TYPE(objectspace);
-	      v->deserialize(is, objectspace);
-	      std::vector<TYPE*>::push_back(v);
-	    }
-	  }
-	  break;
-	default:
-	  {
-	    assert(type == '-' || type == '+');
-	    break;
-	  }
 	}
       }
     }
 
+    // replace the idx-th entry with the one in the stream.
+    void replace(std::istream &is, size_t idx, ObjectSpace *objectspace = 0) {
+      if ((*this)[idx] != 0) {
+	delete (*this)[idx];
+	(*this)[idx] = 0;
+      }
+      deserialize(is, idx, objectspace);
+    }
+
+    // change the number of the entries. the entries beyond the specified size are deleted.
+    void setSize(size_t s) {
+      for (size_t i = s; i < std::vector<TYPE*>::size(); i++) {
+	if ((*this)[i] != 0) {
+	  delete (*this)[i];
+	}
+      }
+      std::vector<TYPE*>::resize(s, 0);
+    }
+
+    void resetRemovedList() {
+#ifdef ADVANCED_USE_REMOVED_LIST
+      while (!removedList.empty()) {
+	removedList.pop();
+      }
+      for (size_t i = 1; i < std::vector<TYPE*>::size(); i++) {
+	if ((*this)[i] == 0) {
+	  removedList.push(i);
+	}
+      }
+#endif
+    }
+
     void serializeAsText(std::ofstream &os, ObjectSpace *objectspace = 0) {
       if (!os.is_open()) {
 	NGTThrowException("NGT::Common: Not open the specified stream yet.");
@@ -1918,6 +2227,7 @@ namespace NGT {
 	}
       }
       this->clear();
+      modifiedEntries.addAll();
 #ifdef ADVANCED_USE_REMOVED_LIST
       while(!removedList.empty()){ removedList.pop(); }
 #endif
@@ -1925,8 +2235,11 @@ namespace NGT {
 
     void set(size_t idx, TYPE *n) {
       (*this)[idx] = n;
+      modifiedEntries.add(idx);
     }
 
+    ModifiedEntries	modifiedEntries;
+
 #ifdef ADVANCED_USE_REMOVED_LIST
     size_t count() { return std::vector<TYPE*>::size() == 0 ? 0 : std::vector<TYPE*>::size() - removedList.size() - 1; }
   protected:
@@ -1957,11 +2270,11 @@ namespace NGT {
         return distance > o.distance;
       }
     }
-    void serialize(std::ofstream &os) {
+    void serialize(std::ostream &os) {
       NGT::Serializer::write(os, id);
       NGT::Serializer::write(os, distance);
     }
-    void deserialize(std::ifstream &is) {
+    void deserialize(std::istream &is) {
       NGT::Serializer::read(is, id);
       NGT::Serializer::read(is, distance);
     }
@@ -326,7 +326,8 @@ NeighborhoodGraph::setupDistances(NGT::SearchContainer &sc, ObjectDistances &see
       continue;
     }
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)    
-    seeds[i].distance = comparator(static_cast<void*>(&sc.object[0]), static_cast<void*>(objectRepository.get(seeds[i].id)), dimension);
+    seeds[i].distance = comparator(static_cast<void*>(&sc.object[0]),
+				   objectRepository.get(seeds[i].id)->getPointer(0, objectRepository.getAllocator()), dimension);
 #else
     seeds[i].distance = comparator(&sc.object[0], &(*objects[seeds[i].id])[0], dimension);
 #endif
@@ -400,6 +401,20 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
     NeighborhoodGraph::searchReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds)
   {
 
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    if (!mappedSearchRepository.empty()) {
+      searchReadOnlyGraphOfIDs<COMPARATOR, CHECK_LIST>(sc, seeds, mappedSearchRepository,
+						       mappedSearchRepository.getObjects(), getEdgeSize(sc));
+      return;
+    }
+#else
+    if (!compressedSearchRepository.empty()) {
+      searchReadOnlyGraphOfIDs<COMPARATOR, CHECK_LIST>(sc, seeds, compressedSearchRepository,
+						       getObjectRepository().getPtr(), getEdgeSize(sc));
+      return;
+    }
+#endif
+
     if (sc.explorationCoefficient == 0.0) {
       sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
     }
@@ -494,6 +509,96 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
 
   }
 
+  // Search the graph which holds only the IDs of the edges, such as the compressed graph and the mapped graph.
+  // GRAPH::getNode returns a cursor to get the IDs of the edges in order, and the objects are
+  // resolved with the table of the addresses of the objects or the vectors.
+  template <typename COMPARATOR, typename CHECK_LIST, typename GRAPH, typename OBJECT>
+  void
+    NeighborhoodGraph::searchReadOnlyGraphOfIDs(NGT::SearchContainer &sc, ObjectDistances &seeds, GRAPH &graph,
+						OBJECT **objects, size_t edgeSize)
+  {
+
+    if (sc.explorationCoefficient == 0.0) {
+      sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
+    }
+
+    UncheckedSet unchecked;
+
+    CHECK_LIST distanceChecked(graph.size());
+
+    ResultSet results;
+
+    setupDistances(sc, seeds, COMPARATOR::compare);
+    setupSeeds(sc, seeds, results, unchecked, distanceChecked);
+
+    Distance explorationRadius = sc.explorationCoefficient * sc.radius;
+    const size_t dimension = objectSpace->getPaddedDimension();
+    ObjectDistance result;
+    ObjectDistance target;
+    const size_t prefetchSize = objectSpace->getPrefetchSize();
+    const size_t prefetchOffset = objectSpace->getPrefetchOffset();
+    while (!unchecked.empty()) {
+      target = unchecked.top();
+      unchecked.pop();
+      if (target.distance > explorationRadius) {
+	break;
+      }
+      typename GRAPH::Cursor neighbors = graph.getNode(target.id);
+      size_t neighborSize = neighbors.size < edgeSize ? neighbors.size : edgeSize;
+
+      OBJECT *nsObjects[neighborSize];
+      uint32_t nsIDs[neighborSize];
+      size_t nsSize = 0;
+      for (size_t i = 0; i < neighborSize; i++) {
+	uint32_t id = neighbors.next();
+	if (!distanceChecked[id]) {
+	  nsIDs[nsSize] = id;
+	  nsObjects[nsSize] = objects[id];
+	  if (nsSize < prefetchOffset) {
+	    MemoryCache::prefetch(reinterpret_cast<unsigned char*>(nsObjects[nsSize]), prefetchSize);
+	  }
+	  nsSize++;
+	}
+      }
+      for (size_t idx = 0; idx < nsSize; idx++) {
+	if (idx + prefetchOffset < nsSize) {
+	  MemoryCache::prefetch(reinterpret_cast<unsigned char*>(nsObjects[idx + prefetchOffset]), prefetchSize);
+	}
+#ifdef NGT_VISIT_COUNT
+	sc.visitCount++;
+#endif
+	distanceChecked.insert(nsIDs[idx]);
+
+#ifdef NGT_DISTANCE_COMPUTATION_COUNT
+	sc.distanceComputationCount++;
+#endif
+	Distance distance = COMPARATOR::compare((void*)&sc.object[0], getVector(nsObjects[idx]), dimension);
+	if (distance <= explorationRadius) {
+	  result.set(nsIDs[idx], distance);
+	  unchecked.push(result);
+	  if (distance <= sc.radius) {
+	    results.push(result);
+	    if (results.size() >= sc.size) {
+	      if (results.size() > sc.size) {
+	        results.pop();
+	      }
+	      sc.radius = results.top().distance;
+	      explorationRadius = sc.explorationCoefficient * sc.radius;
+	    }
+	  }
+	}
+      }
+    }
+
+    if (sc.resultIsAvailable()) {
+      ObjectDistances &qresults = sc.getResult();
+      qresults.moveFrom(results);
+    } else {
+      sc.workingResult = std::move(results);
+    }
+
+  }
+
 #endif
 
   void
@@ -701,6 +806,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
 	  continue;
 	}
 	nodetbl.push_back(n);
+	setModified((*i).id);
 
 	ObjectDistance edge;
 	edge.id = id;
@@ -863,6 +969,168 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
     }
   }
 
+  // Remove the nodes of the specified IDs at once. The surviving neighbors of every removed node are
+  // relinked in the same way as removeEdgesReliably(ObjectID), but the relinking edges are computed
+  // in parallel for all of the removed nodes first and then each affected node is updated only once.
+  void
+  NeighborhoodGraph::removeEdgesReliably(vector<ObjectID> &ids) {
+    vector<bool> removed(repository.size(), false);
+    vector<ObjectID> targets;
+    targets.reserve(ids.size());
+    for (vector<ObjectID>::iterator i = ids.begin(); i != ids.end(); i++) {
+      if (repository.isEmpty(*i) || removed[*i]) {
+	continue;
+      }
+      removed[*i] = true;
+      targets.push_back(*i);
+    }
+
+    // compute the edges to relink the surviving neighbors of each removed node.
+    vector<vector<ObjectID> > neighbors(targets.size());
+    vector<vector<pair<ObjectID, ObjectDistance> > > links(targets.size());
+    bool error = false;
+    string errorMessage;
+#pragma omp parallel for
+    for (size_t idx = 0; idx < targets.size(); idx++) {
+      if (error) {
+	continue;
+      }
+      ObjectID id = targets[idx];
+      vector<ObjectID> &survivors = neighbors[idx];
+      try {
+	GraphNode &node = *getNode(id);
+	for (size_t i = 0; i < node.size(); i++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  ObjectID nid = node.at(i, repository.allocator).id;
+#else
+	  ObjectID nid = node[i].id;
+#endif
+	  if (nid == id || nid >= removed.size()) {
+	    continue;
+	  }
+	  if (!removed[nid]) {
+	    survivors.push_back(nid);
+	    continue;
+	  }
+	  // the neighbor is also removed. bridge to its nearest survivor to keep connectivity.
+	  GraphNode &rnode = *getNode(nid);
+	  for (size_t j = 0; j < rnode.size(); j++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	    ObjectID rid = rnode.at(j, repository.allocator).id;
+#else
+	    ObjectID rid = rnode[j].id;
+#endif
+	    if (rid < removed.size() && !removed[rid]) {
+	      survivors.push_back(rid);
+	      break;
+	    }
+	  }
+	}
+	std::sort(survivors.begin(), survivors.end());
+	survivors.erase(std::unique(survivors.begin(), survivors.end()), survivors.end());
+	vector<PersistentObject*> objtbl;
+	objtbl.reserve(survivors.size());
+	for (size_t i = 0; i < survivors.size(); i++) {
+	  objtbl.push_back(getObjectRepository().get(survivors[i]));
+	}
+	vector<ObjectID> path(survivors);
+	for (size_t i = 0; i + 1 < path.size(); i++) {
+	  size_t minj = i + 1;
+	  Distance mind = FLT_MAX;
+	  for (size_t j = i + 1; j < path.size(); j++) {
+	    Distance d = objectSpace->getComparator()(*objtbl[i], *objtbl[j]);
+	    if (d < mind) {
+	      minj = j;
+	      mind = d;
+	    }
+	  }
+	  links[idx].push_back(make_pair(path[i], ObjectDistance(path[minj], mind)));
+	  links[idx].push_back(make_pair(path[minj], ObjectDistance(path[i], mind)));
+	  std::swap(path[i + 1], path[minj]);
+	  std::swap(objtbl[i + 1], objtbl[minj]);
+	}
+      } catch (Exception &err) {
+#pragma omp critical
+	{
+	  error = true;
+	  stringstream msg;
+	  msg << "removeEdgesReliably : Relink error ID=" << id << ":" << err.what();
+	  errorMessage = msg.str();
+	}
+      }
+    }
+    if (error) {
+#ifdef NGT_FORCED_REMOVE
+      cerr << errorMessage << " continue..." << endl;
+#else
+      NGTThrowException(errorMessage);
+#endif
+    }
+
+    vector<ObjectID> affected;
+    vector<pair<ObjectID, ObjectDistance> > edges;
+    for (size_t idx = 0; idx < targets.size(); idx++) {
+      affected.insert(affected.end(), neighbors[idx].begin(), neighbors[idx].end());
+      edges.insert(edges.end(), links[idx].begin(), links[idx].end());
+      vector<ObjectID>().swap(neighbors[idx]);
+      vector<pair<ObjectID, ObjectDistance> >().swap(links[idx]);
+    }
+    std::sort(affected.begin(), affected.end());
+    affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+    std::sort(edges.begin(), edges.end());
+
+    // update each affected node once. the node repository is not thread-safe in the shared memory.
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR)
+#pragma omp parallel for
+#endif
+    for (size_t idx = 0; idx < affected.size(); idx++) {
+      GraphNode &node = *getNode(affected[idx]);
+      setModified(affected[idx]);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      for (GraphNode::iterator i = node.begin(repository.allocator); i != node.end(repository.allocator);) {
+	if ((*i).id < removed.size() && removed[(*i).id]) {
+	  i = node.erase(i, repository.allocator);
+	} else {
+	  i++;
+	}
+      }
+#else
+      for (GraphNode::iterator i = node.begin(); i != node.end();) {
+	if ((*i).id < removed.size() && removed[(*i).id]) {
+	  i = node.erase(i);
+	} else {
+	  i++;
+	}
+      }
+#endif
+      pair<ObjectID, ObjectDistance> key(affected[idx], ObjectDistance(0, -FLT_MAX));
+      for (vector<pair<ObjectID, ObjectDistance> >::iterator e = std::lower_bound(edges.begin(), edges.end(), key);
+	   e != edges.end() && (*e).first == affected[idx]; e++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	GraphNode::iterator ei = std::lower_bound(node.begin(repository.allocator), node.end(repository.allocator), (*e).second);
+	if ((ei == node.end(repository.allocator)) || ((*ei).id != (*e).second.id)) {
+	  node.insert(ei, (*e).second, repository.allocator);
+	}
+#else
+	GraphNode::iterator ei = std::lower_bound(node.begin(), node.end(), (*e).second);
+	if ((ei == node.end()) || ((*ei).id != (*e).second.id)) {
+	  node.insert(ei, (*e).second);
+	}
+#endif
+      }
+    }
+
+    for (vector<ObjectID>::iterator i = targets.begin(); i != targets.end(); i++) {
+      try {
+	removeNode(*i);
+      } catch (Exception &err) {
+	stringstream msg;
+	msg << "removeEdgesReliably : removeEdges error. ID=" << *i << ":" << err.what();
+	NGTThrowException(msg.str());
+      }
+    }
+  }
+
 class TruncationSearchJob {
 public:
   TruncationSearchJob() {}
@@ -955,6 +1223,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
   ObjectDistances delNodes;
 
   size_t osize = results.size();
+  setModified(id);
 
   size_t resSize = 2;
   TruncationSearchThreadPool threads(property.truncationThreadPoolSize);
@@ -976,6 +1245,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
 #else
       delNodes.push_back(results[i]);
 #endif
+      setModified(delNodes.back().id);
     }
 
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
@@ -1084,6 +1354,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
 	  r.id = tid;
 	  if (nearestID != id) {
 	    GraphNode &rs = *getNode(nearestID);
+	    setModified(nearestID);
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	    rs.push_back(r, repository.allocator);
 	    std::sort(rs.begin(repository.allocator), rs.end(repository.allocator));
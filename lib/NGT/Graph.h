@@ -26,6 +26,13 @@
 
 #include	"NGT/HashBasedBooleanSet.h"
 
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR) && defined(NGT_GRAPH_READ_ONLY_GRAPH)
+#include	<unistd.h>
+#include	<sys/mman.h>
+#include	<fcntl.h>
+#include	<sys/stat.h>
+#endif
+
 #ifndef NGT_GRAPH_CHECK_VECTOR
 #include	<unordered_set>
 #endif
@@ -82,9 +89,9 @@ namespace NGT {
 #endif
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    void open(const std::string &file, size_t sharedMemorySize) {
+    void open(const std::string &file, size_t sharedMemorySize, const MemoryManager::open_option_st *openOption = 0) {
       SharedMemoryAllocator &allocator = VECTOR::getAllocator();
-      off_t *entryTable = (off_t*)allocator.construct(file, sharedMemorySize);
+      off_t *entryTable = (off_t*)allocator.construct(file, sharedMemorySize, openOption);
       if (entryTable == 0) {
 	entryTable = (off_t*)construct();
 	allocator.setEntry(entryTable);
@@ -148,14 +155,49 @@ namespace NGT {
 #endif
       return rs;
     }
-    void serialize(std::ofstream &os) {
-      VECTOR::serialize(os);
+    void compact(const std::vector<ObjectID> &newIDs, size_t newSize) {
+      for (size_t id = 1; id < prevsize->size() && id < newIDs.size(); id++) {
+	if (newIDs[id] != 0) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  (*prevsize).at(newIDs[id], VECTOR::getAllocator()) = (*prevsize).at(id, VECTOR::getAllocator());
+#else
+	  (*prevsize)[newIDs[id]] = (*prevsize)[id];
+#endif
+	}
+      }
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      prevsize->resize(newSize, VECTOR::getAllocator(), 0);
+#else
+      prevsize->resize(newSize, 0);
+#endif
+      VECTOR::compact(newIDs, newSize);
+    }
+
+    void serialize(std::ofstream &os, bool chunked = false) {
+      VECTOR::serialize(os, 0, chunked);
       Serializer::write(os, *prevsize);
     }
     void deserialize(std::ifstream &is) {
       VECTOR::deserialize(is);      
       Serializer::read(is, *prevsize);
     }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    // serialize the idx-th node with its previous size for the journal.
+    void serializeEntry(std::ostream &os, size_t idx) {
+      VECTOR::serialize(os, idx, 0);
+      unsigned short size = idx < prevsize->size() ? (*prevsize)[idx] : 0;
+      Serializer::write(os, size);
+    }
+    void replaceEntry(std::istream &is, size_t idx) {
+      VECTOR::replace(is, idx, 0);
+      unsigned short size = 0;
+      Serializer::read(is, size);
+      if (idx >= prevsize->size()) {
+	prevsize->resize(idx + 1, 0);
+      }
+      (*prevsize)[idx] = size;
+    }
+#endif
     void show() {
       for (size_t i = 0; i < this->size(); i++) {
 	std::cout << "Show graph " << i << " ";
@@ -225,43 +267,409 @@ namespace NGT {
 	}
 	clear();
 	size_t s;
-	NGT::Serializer::read(is, s);
+	std::vector<ChunkedSerializer::Chunk> chunks;
+	std::streampos top;
+	bool chunked = ChunkedSerializer::readHeader(is, s, chunks, top);
 	resize(s);
-	for (size_t id = 0; id < s; id++) {
-	  char type;
-	  NGT::Serializer::read(is, type);
-	  switch(type) {
-	  case '-':
-	    break;
-	  case '+':
-	    {
-	      ObjectDistances node;
-	      node.deserialize(is);
-	      ReadOnlyGraphNode &searchNode = at(id);
-	      searchNode.reserve(node.size());
+	if (chunked) {
+	  ChunkedSerializer::read(is, top, chunks, [this, &objectRepository](std::istream &cis, size_t id) {
+	      deserialize(cis, id, objectRepository);
+	    });
+	} else {
+	  for (size_t id = 0; id < s; id++) {
+	    deserialize(is, id, objectRepository);
+	  }
+	}
+      }
+
+      // replace the id-th node with the one of the graph repository entry in the stream.
+      void replaceEntry(std::istream &is, size_t id, ObjectRepository &objectRepository) {
+	at(id) = ReadOnlyGraphNode();
+	deserialize(is, id, objectRepository);
+	unsigned short size = 0;
+	NGT::Serializer::read(is, size);
+      }
+
+      void deserialize(std::istream &is, size_t id, ObjectRepository &objectRepository) {
+	char type;
+	NGT::Serializer::read(is, type);
+	switch(type) {
+	case '-':
+	  break;
+	case '+':
+	  {
+	    ObjectDistances node;
+	    node.deserialize(is);
+	    ReadOnlyGraphNode &searchNode = at(id);
+	    searchNode.reserve(node.size());
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-	      for (auto ni = node.begin(); ni != node.end(); ni++) {
-		std::cerr << "not implement" << std::endl;
-		abort();
-	      }
+	    for (auto ni = node.begin(); ni != node.end(); ni++) {
+	      std::cerr << "not implement" << std::endl;
+	      abort();
+	    }
 #else
-	      for (auto ni = node.begin(); ni != node.end(); ni++) {
-		searchNode.push_back(std::pair<uint32_t, Object*>((*ni).id, objectRepository.get((*ni).id)));
-	      }
-#endif
+	    // the objects removed by the journal are left unresolved, since the journal replaces the nodes as well.
+	    for (auto ni = node.begin(); ni != node.end(); ni++) {
+	      searchNode.push_back(std::pair<uint32_t, Object*>((*ni).id,
+								     objectRepository.isEmpty((*ni).id) ? 0 : objectRepository.get((*ni).id)));
 	    }
+#endif
+	  }
+	  break;
+	default:
+	  {
+	    assert(type == '-' || type == '+');
 	    break;
-	  default:
-	    {
-	      assert(type == '-' || type == '+');
-	      break;
+	  }
+	}
+      }
+
+    };
+
+    // A read-only search graph which holds only the IDs of the neighbors without the distances.
+    // The IDs of each node are kept in the order of the distances, so that the edge size for the search picks the
+    // nearest ones, and stored as the zigzag encoded differences from the previous ones in variable length
+    // bytes (varint, 7 bits per byte) preceded by the number of the IDs. All of the nodes are in one arena,
+    // and the nodes without edges refer to the empty node at the head of the arena.
+    class CompressedSearchGraphRepository {
+    public:
+      CompressedSearchGraphRepository():garbageSize(0) {}
+
+      void clear() {
+	std::vector<uint8_t>().swap(arena);
+	std::vector<uint64_t>().swap(offsets);
+	garbageSize = 0;
+      }
+      size_t size() { return offsets.size(); }
+      bool empty() { return offsets.empty(); }
+      bool isEmpty(size_t id) { return arena[offsets[id]] == 0; }
+      void resize(size_t s) {
+	initialize();
+	offsets.resize(s, 0);
+      }
+      size_t getArenaSize() { return arena.size(); }
+      uint8_t *getArena() { return arena.data(); }
+      size_t getMemorySize() { return arena.capacity() + offsets.capacity() * sizeof(uint64_t); }
+
+      // A cursor to decode the IDs of a node in order.
+      class Cursor {
+      public:
+	Cursor(const uint8_t *p):ptr(p), id(0) { size = decode(ptr); }
+	inline uint32_t next() {
+	  uint32_t v = decode(ptr);
+	  return id += (v >> 1) ^ (0 - (v & 1));
+	}
+	size_t		size;
+	const uint8_t	*ptr;
+	uint32_t	id;
+      };
+
+      inline Cursor getNode(size_t id) { return Cursor(&arena[offsets[id]]); }
+
+      static inline uint32_t decode(const uint8_t *&ptr) {
+	uint32_t v = *ptr & 0x7f;
+	for (size_t shift = 7; (*ptr++ & 0x80) != 0; shift += 7) {
+	  v |= static_cast<uint32_t>(*ptr & 0x7f) << shift;
+	}
+	return v;
+      }
+
+      void deserialize(std::ifstream &is) {
+	if (!is.is_open()) {
+	  NGTThrowException("NGT::CompressedSearchGraph: Not open the specified stream yet.");
+	}
+	clear();
+	size_t s;
+	std::vector<ChunkedSerializer::Chunk> chunks;
+	std::streampos top;
+	bool chunked = ChunkedSerializer::readHeader(is, s, chunks, top);
+	resize(s);
+	if (!chunked) {
+	  std::string buffer;
+	  for (size_t id = 0; id < s; id++) {
+	    offsets[id] = append(is, buffer) ? arena.size() : 0;
+	    arena.insert(arena.end(), buffer.begin(), buffer.end());
+	    buffer.clear();
+	  }
+	  arena.shrink_to_fit();
+	  return;
+	}
+	// each chunk is encoded into its own buffer by one of the threads, and they are concatenated afterward.
+	std::vector<std::string> buffers(chunks.size());
+	ChunkedSerializer::read(is, top, chunks, [this, &chunks, &buffers](std::istream &cis, size_t id) {
+	    size_t ci = std::upper_bound(chunks.begin(), chunks.end(), id,
+					 [](size_t v, const ChunkedSerializer::Chunk &c) { return v < c.begin; }) - chunks.begin() - 1;
+	    size_t offset = buffers[ci].size();
+	    offsets[id] = append(cis, buffers[ci]) ? offset + 1 : 0;
+	  });
+	size_t arenaSize = arena.size();
+	for (auto i = buffers.begin(); i != buffers.end(); ++i) {
+	  arenaSize += (*i).size();
+	}
+	arena.reserve(arenaSize);
+	for (size_t ci = 0; ci < chunks.size(); ci++) {
+	  size_t base = arena.size();
+	  arena.insert(arena.end(), buffers[ci].begin(), buffers[ci].end());
+	  std::string().swap(buffers[ci]);
+	  for (size_t id = chunks[ci].begin; id < chunks[ci].end; id++) {
+	    if (offsets[id] != 0) {
+	      offsets[id] += base - 1;
 	    }
 	  }
 	}
       }
 
+      // replace the id-th node with the one of the graph repository entry in the stream. the bytes of the old node
+      // are reused if the new one fits in them, and the arena is compacted when the unused bytes exceed the half.
+      void replaceEntry(std::istream &is, size_t id) {
+	std::string buffer;
+	bool notEmpty = append(is, buffer);
+	unsigned short size = 0;
+	NGT::Serializer::read(is, size);
+	size_t oldSize = getEncodedSize(id);
+	if (notEmpty && buffer.size() <= oldSize) {
+	  std::copy(buffer.begin(), buffer.end(), arena.begin() + offsets[id]);
+	  garbageSize += oldSize - buffer.size();
+	} else {
+	  garbageSize += oldSize;
+	  offsets[id] = notEmpty ? arena.size() : 0;
+	  arena.insert(arena.end(), buffer.begin(), buffer.end());
+	}
+	if (garbageSize > arena.size() / 2) {
+	  compact();
+	}
+      }
+
+      void compact() {
+	std::vector<uint8_t> compacted;
+	compacted.reserve(arena.size() - garbageSize);
+	compacted.push_back(0);
+	for (size_t id = 0; id < offsets.size(); id++) {
+	  if (offsets[id] == 0) {
+	    continue;
+	  }
+	  size_t size = getEncodedSize(id);
+	  size_t offset = compacted.size();
+	  compacted.insert(compacted.end(), arena.begin() + offsets[id], arena.begin() + offsets[id] + size);
+	  offsets[id] = offset;
+	}
+	arena.swap(compacted);
+	garbageSize = 0;
+      }
+
+    protected:
+      void initialize() {
+	if (arena.empty()) {
+	  arena.push_back(0);
+	}
+      }
+
+      // the number of the bytes of the id-th node in the arena. the empty node at the head is shared.
+      size_t getEncodedSize(size_t id) {
+	if (offsets[id] == 0) {
+	  return 0;
+	}
+	Cursor cursor = getNode(id);
+	for (size_t i = 0; i < cursor.size; i++) {
+	  decode(cursor.ptr);
+	}
+	return cursor.ptr - &arena[offsets[id]];
+      }
+
+      static void encode(std::string &buffer, uint32_t v) {
+	while (v >= 0x80) {
+	  buffer.push_back(static_cast<char>((v & 0x7f) | 0x80));
+	  v >>= 7;
+	}
+	buffer.push_back(static_cast<char>(v));
+      }
+
+      // encode the node of the graph repository entry in the stream. returns false if the node has no edges.
+      bool append(std::istream &is, std::string &buffer) {
+	char type;
+	NGT::Serializer::read(is, type);
+	if (type != '+') {
+	  assert(type == '-');
+	  return false;
+	}
+	ObjectDistances node;
+	node.deserialize(is);
+	if (node.empty()) {
+	  return false;
+	}
+	encode(buffer, node.size());
+	uint32_t prev = 0;
+	for (auto i = node.begin(); i != node.end(); ++i) {
+	  int32_t delta = static_cast<int32_t>((*i).id - prev);
+	  encode(buffer, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+	  prev = (*i).id;
+	}
+	return true;
+      }
+
+      std::vector<uint8_t>	arena;
+      std::vector<uint64_t>	offsets;
+      size_t			garbageSize;
     };
 
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    // A read-only search graph for the shared memory index, which is a CSR (compressed sparse row) file mapped
+    // with PROT_READ and MAP_SHARED so that all of the processes opening the index share the same pages.
+    // Since the addresses of the objects differ among the processes, the addresses of the vectors of the objects
+    // are resolved into a table of each process.
+    // Layout : magic, # of nodes, # of edges, stamp of the graph (uint64 x 4),
+    //          offsets of the edges of the nodes (uint64 x (# of nodes + 1)), IDs of the edges (uint32 x # of edges).
+    // The stamp is the modification time of the graph file when the file is built. Since the processes opening
+    // the index as writable update the time when they close it, the stale file is detected even if the edges are
+    // modified without changing the number of the nodes.
+    class MappedSearchGraphRepository {
+    public:
+      static const uint64_t magic = 0x3252534354474e4eULL;	// "NNGTCSR2"
+      static const size_t headerSize = 4;
+
+      class Cursor {
+      public:
+	Cursor(const uint32_t *p, size_t s):size(s), ptr(p) {}
+	inline uint32_t next() { return *ptr++; }
+	size_t		size;
+	const uint32_t	*ptr;
+      };
+
+      MappedSearchGraphRepository():mappedAddress(0), mappedSize(0), numberOfNodes(0), offsets(0), ids(0) {}
+      ~MappedSearchGraphRepository() { close(); }
+
+      static std::string getFileName(const std::string &database) { return database + "/grpcsr"; }
+
+      // remove the file, which is inconsistent with the graph once the index is updated.
+      static void remove(const std::string &database) { unlink(getFileName(database).c_str()); }
+
+      // the modification time of the graph file in nanoseconds.
+      static uint64_t getStamp(const std::string &database) {
+	struct stat st;
+	if (stat((database + "/grp").c_str(), &st) != 0) {
+	  return 0;
+	}
+	return static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+      }
+
+      // update the modification time of the specified graph file to invalidate the file built from it.
+      static void touch(const std::string &graphFile) { utimensat(AT_FDCWD, graphFile.c_str(), 0, 0); }
+
+      // write the graph into a temporary file and rename it so that the other processes never see a partial file.
+      static void build(const std::string &database, GraphRepository &repository) {
+	std::string file = getFileName(database);
+	std::stringstream tmp;
+	tmp << file << "." << getpid();
+	std::ofstream os(tmp.str(), std::ios::binary);
+	if (!os.is_open()) {
+	  std::stringstream msg;
+	  msg << "NGT::MappedSearchGraphRepository::build: Cannot open. " << tmp.str();
+	  NGTThrowException(msg);
+	}
+	// the stamp is taken before the graph is read, so that any modification during the build invalidates the file.
+	uint64_t stamp = getStamp(database);
+	size_t size = repository.size();
+	std::vector<uint64_t> offs(size + 1, 0);
+	for (size_t id = 0; id < size; id++) {
+	  offs[id + 1] = offs[id] + (repository.isEmpty(id) ? 0 : repository.VECTOR::get(id)->size());
+	}
+	Serializer::write(os, magic);
+	Serializer::write(os, static_cast<uint64_t>(size));
+	Serializer::write(os, offs.back());
+	Serializer::write(os, stamp);
+	os.write(reinterpret_cast<const char*>(offs.data()), offs.size() * sizeof(uint64_t));
+	std::vector<uint32_t> node;
+	for (size_t id = 0; id < size; id++) {
+	  if (offs[id] == offs[id + 1]) {
+	    continue;
+	  }
+	  GraphNode &n = *repository.VECTOR::get(id);
+	  node.resize(offs[id + 1] - offs[id]);
+	  for (size_t i = 0; i < node.size(); i++) {
+	    node[i] = n.at(i, repository.getAllocator()).id;
+	  }
+	  os.write(reinterpret_cast<const char*>(node.data()), node.size() * sizeof(uint32_t));
+	}
+	os.close();
+	if (!os || rename(tmp.str().c_str(), file.c_str()) != 0) {
+	  unlink(tmp.str().c_str());
+	  std::stringstream msg;
+	  msg << "NGT::MappedSearchGraphRepository::build: Cannot write. " << file;
+	  NGTThrowException(msg);
+	}
+      }
+
+      // map the file. returns false if the file does not exist or is inconsistent with the graph.
+      bool open(const std::string &database, size_t size) {
+	close();
+	int fd = ::open(getFileName(database).c_str(), O_RDONLY);
+	if (fd == -1) {
+	  return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(uint64_t) * headerSize) {
+	  ::close(fd);
+	  return false;
+	}
+	void *addr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) {
+	  return false;
+	}
+	mappedAddress = addr;
+	mappedSize = st.st_size;
+	uint64_t *header = static_cast<uint64_t*>(addr);
+	numberOfNodes = header[1];
+	size_t expectedSize = sizeof(uint64_t) * (headerSize + numberOfNodes + 1) + sizeof(uint32_t) * header[2];
+	if (header[0] != magic || numberOfNodes != size || mappedSize != expectedSize || header[3] != getStamp(database)) {
+	  close();
+	  return false;
+	}
+	offsets = header + headerSize;
+	ids = reinterpret_cast<uint32_t*>(offsets + numberOfNodes + 1);
+	return true;
+      }
+
+      void close() {
+	if (mappedAddress != 0) {
+	  munmap(mappedAddress, mappedSize);
+	}
+	mappedAddress = 0;
+	mappedSize = 0;
+	numberOfNodes = 0;
+	offsets = 0;
+	ids = 0;
+	std::vector<uint8_t*>().swap(objects);
+      }
+
+      // resolve the addresses of the vectors of the objects in this process.
+      void setObjects(ObjectRepository &objectRepository, SharedMemoryAllocator &allocator) {
+	objects.resize(objectRepository.size(), 0);
+	for (size_t id = 1; id < objects.size(); id++) {
+	  if (!objectRepository.isEmpty(id)) {
+	    objects[id] = static_cast<uint8_t*>(objectRepository.get(id)->getPointer(0, allocator));
+	  }
+	}
+      }
+
+      size_t size() { return numberOfNodes; }
+      bool empty() { return mappedAddress == 0; }
+      bool isEmpty(size_t id) { return offsets[id] == offsets[id + 1]; }
+      inline Cursor getNode(size_t id) { return Cursor(ids + offsets[id], offsets[id + 1] - offsets[id]); }
+      uint8_t **getObjects() { return objects.data(); }
+      void *getAddress() { return mappedAddress; }
+      size_t getMappedSize() { return mappedSize; }
+
+    protected:
+      void				*mappedAddress;
+      size_t				mappedSize;
+      size_t				numberOfNodes;
+      uint64_t				*offsets;
+      uint32_t				*ids;
+      std::vector<uint8_t*>		objects;
+    };
+#endif
+
 #endif // NGT_GRAPH_READ_ONLY_GRAPH
 
     class NeighborhoodGraph {
@@ -566,6 +974,7 @@ namespace NGT {
 	  repository.insert(id, results);
 	} else {
 	  GraphNode &rs = *getNode(id);
+	  setModified(id);
 	  for (ObjectDistances::iterator ri = results.begin(); ri != results.end(); ri++) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	    rs.push_back((*ri), repository.allocator);
@@ -655,6 +1064,7 @@ namespace NGT {
       }
 
       void removeEdgesReliably(ObjectID id);
+      void removeEdgesReliably(std::vector<ObjectID> &ids);
 
       int truncateEdgesOptimally(ObjectID id, GraphNode &results, size_t truncationSize);
 
@@ -695,10 +1105,15 @@ namespace NGT {
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       template <typename COMPARATOR, typename CHECK_LIST> void searchReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds);
+      template <typename COMPARATOR, typename CHECK_LIST, typename GRAPH, typename OBJECT>
+	void searchReadOnlyGraphOfIDs(NGT::SearchContainer &sc, ObjectDistances &seeds, GRAPH &graph, OBJECT **objects, size_t edgeSize);
+      static inline void *getVector(Object *object) { return &(*object)[0]; }
+      static inline void *getVector(uint8_t *vector) { return vector; }
 #endif
 
       void removeEdge(ObjectID fid, ObjectID rmid) {
 	GraphNode &rs = *getNode(fid);
+	setModified(fid);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	for (GraphNode::iterator ri = rs.begin(repository.allocator); ri != rs.end(repository.allocator); ri++) {
 	  if ((*ri).id == rmid) {
@@ -748,6 +1163,19 @@ namespace NGT {
 	repository.erase(id);
       }
 
+      // record the node whose edges are modified in place, so that the node is appended to the journal.
+      void setModified(ObjectID id) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	repository.modifiedEntries.add(id);
+#endif
+      }
+
+      void setAllModified() {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	repository.modifiedEntries.addAll();
+#endif
+      }
+
       class BooleanVector : public std::vector<bool> {
       public:
         inline BooleanVector(size_t s):std::vector<bool>(s, false) {}
@@ -877,6 +1305,7 @@ namespace NGT {
       bool addEdge(ObjectID target, ObjectID addID, Distance addDistance, bool identityCheck = true) {
 	size_t minsize = 0;
 	GraphNode &node = property.truncationThreshold == 0 ? *getNode(target) : *getNode(target, minsize);
+	setModified(target);
 	addEdge(node, addID, addDistance, identityCheck);
 	if ((size_t)property.truncationThreshold != 0 && node.size() - minsize > 
 	    (size_t)property.truncationThreshold) {
@@ -887,16 +1316,19 @@ namespace NGT {
 
       void addEdgeDeletingExcessEdges(ObjectID target, ObjectID addID, Distance addDistance, bool identityCheck = true) {
 	GraphNode &node = *getNode(target);
+	setModified(target);
 	size_t kEdge = property.edgeSizeForCreation - 1;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	if (node.size() > kEdge && node.at(kEdge, repository.allocator).distance >= addDistance) {
 	  GraphNode &linkedNode = *getNode(node.at(kEdge, repository.allocator).id);
+	  setModified(node.at(kEdge, repository.allocator).id);
 	  ObjectDistance linkedNodeEdge(target, node.at(kEdge, repository.allocator).distance);
 	  if ((linkedNode.size() > kEdge) && node.at(kEdge, repository.allocator).distance >= 
 	    linkedNode.at(kEdge, repository.allocator).distance) {
 #else
 	if (node.size() > kEdge && node[kEdge].distance >= addDistance) {
 	  GraphNode &linkedNode = *getNode(node[kEdge].id);
+	  setModified(node[kEdge].id);
 	  ObjectDistance linkedNodeEdge(target, node[kEdge].distance);
 	  if ((linkedNode.size() > kEdge) && node[kEdge].distance >= linkedNode[kEdge].distance) {
 #endif
@@ -935,8 +1367,32 @@ namespace NGT {
 
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
-      void loadSearchGraph(const std::string &database) {
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      // map the search graph file, which is built from the graph when it is missing or stale.
+      // returns false if the search graph is unavailable.
+      bool openSearchGraph(const std::string &database) {
+	if (!mappedSearchRepository.open(database, repository.size())) {
+	  try {
+	    MappedSearchGraphRepository::build(database, repository);
+	  } catch (Exception &err) {
+	    std::cerr << "NGT::NeighborhoodGraph::openSearchGraph: Warning! The search graph is unavailable. " << err.what() << std::endl;
+	    return false;
+	  }
+	  if (!mappedSearchRepository.open(database, repository.size())) {
+	    return false;
+	  }
+	}
+	mappedSearchRepository.setObjects(getObjectRepository(), getObjectRepository().getAllocator());
+	return true;
+      }
+#endif
+
+      void loadSearchGraph(const std::string &database, bool compressed = false) {
 	std::ifstream isg(database + "/grp");
+	if (compressed) {
+	  compressedSearchRepository.deserialize(isg);
+	  return;
+	}
 	NeighborhoodGraph::searchRepository.deserialize(isg, NeighborhoodGraph::getObjectRepository());
       }
 #endif
@@ -948,6 +1404,10 @@ namespace NGT {
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       SearchGraphRepository searchRepository;
+      CompressedSearchGraphRepository compressedSearchRepository;
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      MappedSearchGraphRepository mappedSearchRepository;
+#endif
 #endif      
 
       NeighborhoodGraph::Property		property;
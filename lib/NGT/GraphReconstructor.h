@@ -70,6 +70,7 @@ class GraphReconstructor {
     exit(1);
 #else
     NGT::GraphIndex	&outGraph = dynamic_cast<NGT::GraphIndex&>(outIndex.getIndex());
+    outGraph.setAllModified();
     size_t rStartRank = 0; 
     std::list<std::pair<size_t, NGT::GraphNode> > tmpGraph;
     for (size_t id = 1; id < outGraph.repository.size(); id++) {
@@ -198,6 +199,7 @@ class GraphReconstructor {
     adjustPathsEffectively(NGT::GraphIndex &outGraph,
 			   size_t minNoOfEdges) 
   {
+    outGraph.setAllModified();
     Timer timer;
     timer.start();
     std::vector<NGT::GraphNode> tmpGraph;
@@ -429,6 +431,7 @@ class GraphReconstructor {
       std::cerr << "something wrong. Edge size=" << reverseEdgeSize << std::endl;
       exit(1);
     }
+    outGraph.setAllModified();
 
     NGT::Timer	originalEdgeTimer, reverseEdgeTimer, normalizeEdgeTimer;
     originalEdgeTimer.start();
@@ -571,6 +574,7 @@ class GraphReconstructor {
     std::cerr << "reconstructGraphWithConstraint is not implemented." << std::endl;
     abort();
 #else 
+    outGraph.setAllModified();
 
     NGT::Timer	originalEdgeTimer, reverseEdgeTimer, normalizeEdgeTimer;
 
@@ -726,6 +730,7 @@ class GraphReconstructor {
 #else 
 
     NGT::GraphIndex	&outGraph = dynamic_cast<NGT::GraphIndex&>(index.getIndex());
+    outGraph.setAllModified();
 
     // remove all edges in the index.
     for (size_t id = 1; id < outGraph.repository.size(); id++) {
@@ -818,6 +823,7 @@ class GraphReconstructor {
     auto prop = static_cast<GraphIndex&>(index.getIndex()).getGraphProperty();
     NGT::ObjectRepository &objectRepository = index.getObjectSpace().getRepository();
     NGT::GraphIndex &graphIndex = static_cast<GraphIndex&>(index.getIndex());
+    graphIndex.setAllModified();
     size_t nOfObjects = objectRepository.size();
     bool error = false;
     std::string errorMessage;
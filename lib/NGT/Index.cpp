@@ -91,13 +91,36 @@ NGT::Index::getEpsilonFromExpectedAccuracy(double accuracy) {
 
 void 
 NGT::Index::open(const string &database, bool rdOnly) {
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+  NGT::Property mmapProperty;
+  mmapProperty.clear();
+  open(database, rdOnly, mmapProperty);
+}
+
+void 
+NGT::Index::open(const string &database, bool rdOnly, Index::Property &mmapProperty) {
+#else
+  open(database, rdOnly, OpenTypeNone);
+}
+
+void 
+NGT::Index::open(const string &database, bool rdOnly, OpenType openType) {
+#endif
   NGT::Property prop;
   prop.load(database);
   Index* idx = 0;
   if (prop.indexType == NGT::Index::Property::GraphAndTree) {
-    idx = new NGT::GraphAndTreeIndex(database, rdOnly);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    idx = new NGT::GraphAndTreeIndex(database, rdOnly, &mmapProperty);
+#else
+    idx = new NGT::GraphAndTreeIndex(database, rdOnly, openType);
+#endif
   } else if (prop.indexType == NGT::Index::Property::Graph) {
-    idx = new NGT::GraphIndex(database, rdOnly);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    idx = new NGT::GraphIndex(database, rdOnly, &mmapProperty);
+#else
+    idx = new NGT::GraphIndex(database, rdOnly, openType);
+#endif
   } else {
     NGTThrowException("Index::Open: Not found IndexType in property file.");
   }
@@ -112,7 +135,7 @@ NGT::Index::open(const string &database, bool rdOnly) {
 
 void 
 NGT::Index::createGraphAndTree(const string &database, NGT::Property &prop, const string &dataFile,
-			       size_t dataSize, bool redirect) {
+			       size_t dataSize, bool redirect, const string &dataFormat) {
   if (prop.dimension == 0) {
     NGTThrowException("Index::createGraphAndTree. Dimension is not specified.");
   }
@@ -128,7 +151,7 @@ NGT::Index::createGraphAndTree(const string &database, NGT::Property &prop, cons
   StdOstreamRedirector redirector(redirect);
   redirector.begin();
   try {
-    loadAndCreateIndex(*idx, database, dataFile, prop.threadPoolSize, dataSize);
+    loadAndCreateIndex(*idx, database, dataFile, prop.threadPoolSize, dataSize, dataFormat);
   } catch(Exception &err) {
     delete idx;
     redirector.end();
@@ -139,7 +162,8 @@ NGT::Index::createGraphAndTree(const string &database, NGT::Property &prop, cons
 }
 
 void 
-NGT::Index::createGraph(const string &database, NGT::Property &prop, const string &dataFile, size_t dataSize, bool redirect) {
+NGT::Index::createGraph(const string &database, NGT::Property &prop, const string &dataFile, size_t dataSize, bool redirect,
+			const string &dataFormat) {
   if (prop.dimension == 0) {
     NGTThrowException("Index::createGraphAndTree. Dimension is not specified.");
   }
@@ -155,7 +179,7 @@ NGT::Index::createGraph(const string &database, NGT::Property &prop, const strin
   StdOstreamRedirector redirector(redirect);
   redirector.begin();
   try {
-    loadAndCreateIndex(*idx, database, dataFile, prop.threadPoolSize, dataSize);
+    loadAndCreateIndex(*idx, database, dataFile, prop.threadPoolSize, dataSize, dataFormat);
   } catch(Exception &err) {
     delete idx;
     redirector.end();
@@ -166,11 +190,12 @@ NGT::Index::createGraph(const string &database, NGT::Property &prop, const strin
 }
 
 void 
-NGT::Index::loadAndCreateIndex(Index &index, const string &database, const string &dataFile, size_t threadSize, size_t dataSize) {
+NGT::Index::loadAndCreateIndex(Index &index, const string &database, const string &dataFile, size_t threadSize, size_t dataSize,
+				const string &dataFormat) {
   NGT::Timer timer;
   timer.start();
   if (dataFile.size() != 0) {
-    index.load(dataFile, dataSize);
+    index.load(dataFile, dataSize, dataFormat);
   } else {
     index.saveIndex(database);
     return;
@@ -190,12 +215,12 @@ NGT::Index::loadAndCreateIndex(Index &index, const string &database, const strin
 }
 
 void 
-NGT::Index::append(const string &database, const string &dataFile, size_t threadSize, size_t dataSize) {
+NGT::Index::append(const string &database, const string &dataFile, size_t threadSize, size_t dataSize, const string &dataFormat) {
   NGT::Index	index(database);
   NGT::Timer	timer;
   timer.start();
   if (dataFile.size() != 0) {
-    index.append(dataFile, dataSize);
+    index.append(dataFile, dataSize, dataFormat);
   }
   timer.stop();
   cerr << "Data loading time=" << timer.time << " (sec) " << timer.time * 1000.0 << " (msec)" << endl;
@@ -236,13 +261,19 @@ NGT::Index::remove(const string &database, vector<ObjectID> &objects, bool force
   NGT::Index	index(database);
   NGT::Timer	timer;
   timer.start();
+  vector<ObjectID> ids;
+  ids.reserve(objects.size());
   for (vector<ObjectID>::iterator i = objects.begin(); i != objects.end(); i++) {
-    try {
-      index.remove(*i, force);
-    } catch (Exception &err) {
-      cerr << "Warning: Cannot remove the node. ID=" << *i << " : " << err.what() << endl;
+    if (!force && index.getObjectSpace().getRepository().isEmpty(*i)) {
+      cerr << "Warning: Cannot remove the node. ID=" << *i << " : Not found the specified id" << endl;
       continue;
     }
+    ids.push_back(*i);
+  }
+  try {
+    index.remove(ids, force);
+  } catch (Exception &err) {
+    cerr << "Warning: Cannot remove the nodes. : " << err.what() << endl;
   }
   timer.stop();
   cerr << "Data removing time=" << timer.time << " (sec) " << timer.time * 1000.0 << " (msec)" << endl;
@@ -251,6 +282,19 @@ NGT::Index::remove(const string &database, vector<ObjectID> &objects, bool force
   return;
 }
 
+void
+NGT::Index::compact(const string &database, vector<ObjectID> &newIDs) {
+  NGT::Index	index(database);
+  NGT::Timer	timer;
+  timer.start();
+  index.compact(newIDs);
+  timer.stop();
+  cerr << "Data compaction time=" << timer.time << " (sec) " << timer.time * 1000.0 << " (msec)" << endl;
+  cerr << "# of objects=" << index.getObjectRepositorySize() - 1 << endl;
+  index.saveIndex(database);
+  return;
+}
+
 void 
 NGT::Index::importIndex(const string &database, const string &file) {
   Index *idx = 0;
@@ -319,6 +363,50 @@ NGT::Index::makeSparseObject(std::vector<uint32_t> &object)
   return obj;
 }
 
+size_t
+NGT::Index::warmup(WarmupMode mode, const std::string &queryFile, size_t querySize, float epsilon, size_t resultSize)
+{
+  int rss = NGT::Common::getProcessVmRSS();
+  switch (mode) {
+  case WarmupModeSweep:
+    touchPages();
+    break;
+  case WarmupModeQuery:
+    replayQueries(*this, queryFile, querySize, epsilon, resultSize);
+    break;
+  default:
+    {
+      std::stringstream msg;
+      msg << "NGT::Index::warmup: Invalid warmup mode. " << mode;
+      NGTThrowException(msg);
+    }
+  }
+  int loaded = NGT::Common::getProcessVmRSS() - rss;
+  return loaded > 0 ? static_cast<size_t>(loaded) * 1024 : 0;
+}
+
+size_t
+NGT::Index::touchPages()
+{
+  ObjectRepository &repo = getObjectSpace().getRepository();
+  size_t objectSize = getObjectSpace().getByteSizeOfObject();
+  size_t repositorySize = repo.size();
+  size_t touchedSize = 0;
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:touchedSize)
+  for (size_t id = 1; id < repositorySize; id++) {
+    if (repo.isEmpty(id)) {
+      continue;
+    }
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    MemoryCache::touch(repo.get(id)->getPointer(0, repo.getAllocator()), objectSize);
+#else
+    MemoryCache::touch(repo.get(id)->getPointer(), objectSize);
+#endif
+    touchedSize += objectSize;
+  }
+  return touchedSize + getIndex().touchPages();
+}
+
 void 
 NGT::Index::Property::set(NGT::Property &prop) {
   if (prop.dimension != -1) dimension = prop.dimension;
@@ -329,10 +417,15 @@ NGT::Index::Property::set(NGT::Property &prop) {
   if (prop.databaseType != DatabaseTypeNone) databaseType = prop.databaseType;
   if (prop.objectAlignment != ObjectAlignmentNone) objectAlignment = prop.objectAlignment;
   if (prop.pathAdjustmentInterval != -1) pathAdjustmentInterval = prop.pathAdjustmentInterval;
+  if (prop.searchGraphCompression != SearchGraphCompressionNotSet) searchGraphCompression = prop.searchGraphCompression;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
   if (prop.graphSharedMemorySize != -1) graphSharedMemorySize = prop.graphSharedMemorySize;
   if (prop.treeSharedMemorySize != -1) treeSharedMemorySize = prop.treeSharedMemorySize;
   if (prop.objectSharedMemorySize != -1) objectSharedMemorySize = prop.objectSharedMemorySize;
+  setMemoryMapOption(prop);
+#else
+  if (prop.journalCompactionRate != -1.0) journalCompactionRate = prop.journalCompactionRate;
+  if (prop.repositoryFormat != RepositoryFormatNotSet) repositoryFormat = prop.repositoryFormat;
 #endif
   if (prop.prefetchOffset != -1) prefetchOffset = prop.prefetchOffset;
   if (prop.prefetchSize != -1) prefetchSize = prop.prefetchSize;
@@ -348,10 +441,18 @@ NGT::Index::Property::get(NGT::Property &prop) {
   prop.indexType = indexType;
   prop.databaseType = databaseType;
   prop.pathAdjustmentInterval = pathAdjustmentInterval;
+  prop.searchGraphCompression = searchGraphCompression;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
   prop.graphSharedMemorySize = graphSharedMemorySize;
   prop.treeSharedMemorySize = treeSharedMemorySize;
   prop.objectSharedMemorySize = objectSharedMemorySize;
+  prop.mmapHugePage = mmapHugePage;
+  prop.mmapPopulate = mmapPopulate;
+  prop.mmapNumaPolicy = mmapNumaPolicy;
+  prop.mmapNumaNode = mmapNumaNode;
+#else
+  prop.journalCompactionRate = journalCompactionRate;
+  prop.repositoryFormat = repositoryFormat;
 #endif
   prop.prefetchOffset = prefetchOffset;
   prop.prefetchSize = prefetchSize;
@@ -505,18 +606,94 @@ NGT::GraphIndex::constructObjectSpace(NGT::Property &prop) {
 
 void 
 NGT::GraphIndex::loadIndex(const string &ifile, bool readOnly) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  if (!objectDisabled) {
+    objectSpace->deserialize(ifile + "/obj");
+  }
+#else
   objectSpace->deserialize(ifile + "/obj");
+#endif
+  bool searchGraph = false;
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
-  if (readOnly && property.indexType == NGT::Index::Property::IndexType::Graph) {
-    GraphIndex::NeighborhoodGraph::loadSearchGraph(ifile);
-  } else {
+  searchGraph = readOnly && property.indexType == NGT::Index::Property::IndexType::Graph;
+#endif
+  if (!searchGraph) {
     ifstream isg(ifile + "/grp");
     repository.deserialize(isg);
   }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  // the journal of the graph and tree index is applied after the tree is loaded.
+  if (property.indexType == NGT::Index::Property::IndexType::Graph) {
+    vector<Journal::Section> sections;
+    getJournalSections(sections);
+    if (searchGraph) {
+      sections[1] = Journal::Section();
+    }
+    if (objectDisabled) {
+      sections[0] = Journal::Section();
+    }
+    replayJournal(ifile, sections);
+    startJournal(ifile);
+  }
+#endif
+#ifdef NGT_GRAPH_READ_ONLY_GRAPH
+  if (searchGraph) {
+    // the search graph refers to the objects which the journal has been applied to.
+    GraphIndex::NeighborhoodGraph::loadSearchGraph(ifile, isSearchGraphCompressed());
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    vector<Journal::Section> sections;
+    getJournalSections(sections, true);
+    journal.replay(ifile, sections);
+#endif
+  }
+#endif
+}
+
+size_t
+NGT::GraphIndex::touchPages()
+{
+  size_t touchedSize = 0;
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR) && defined(NGT_GRAPH_READ_ONLY_GRAPH)
+  if (readOnly && !mappedSearchRepository.empty()) {
+    size_t size = mappedSearchRepository.getMappedSize();
+    MemoryCache::touch(mappedSearchRepository.getAddress(), size);
+    return size;
+  }
+#endif
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR) && defined(NGT_GRAPH_READ_ONLY_GRAPH)
+  if (readOnly && !compressedSearchRepository.empty()) {
+    size_t size = compressedSearchRepository.getArenaSize();
+    MemoryCache::touch(compressedSearchRepository.getArena(), size);
+    return size;
+  }
+  if (readOnly && !searchRepository.empty()) {
+    size_t repositorySize = searchRepository.size();
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:touchedSize)
+    for (size_t id = 1; id < repositorySize; id++) {
+      ReadOnlyGraphNode &node = searchRepository[id];
+      size_t size = node.reservedSize * sizeof(ReadOnlyGraphNode::value_type);
+      MemoryCache::touch(node.data(), size);
+      touchedSize += size;
+    }
+    return touchedSize;
+  }
+#endif
+  size_t repositorySize = repository.size();
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:touchedSize)
+  for (size_t id = 1; id < repositorySize; id++) {
+    if (repository.isEmpty(id)) {
+      continue;
+    }
+    GraphNode *node = repository.VECTOR::get(id);
+    size_t size = node->size() * sizeof(ObjectDistance);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    MemoryCache::touch(node->begin(repository.getAllocator()), size);
 #else
-  ifstream isg(ifile + "/grp");
-  repository.deserialize(isg);
+    MemoryCache::touch(node->data(), size);
 #endif
+    touchedSize += size + sizeof(GraphNode);
+  }
+  return touchedSize;
 }
 
 void 
@@ -530,9 +707,12 @@ NGT::GraphIndex::exportProperty(const std::string &file) {
 }
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-NGT::GraphIndex::GraphIndex(const string &allocator, bool rdonly):readOnly(rdonly) {
+NGT::GraphIndex::GraphIndex(const string &allocator, bool rdonly, Index::Property *mmapProperty):readOnly(rdonly) {
   NGT::Property prop;
   prop.load(allocator);
+  if (mmapProperty != 0) {
+    prop.setMemoryMapOption(*mmapProperty);
+  }
   if (prop.databaseType != NGT::Index::Property::DatabaseType::MemoryMappedFile) {
     NGTThrowException("GraphIndex: Cannot open. Not memory mapped file type.");
   }
@@ -540,6 +720,13 @@ NGT::GraphIndex::GraphIndex(const string &allocator, bool rdonly):readOnly(rdonl
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
   searchUnupdatableGraph = NeighborhoodGraph::Search::getMethod(prop.distanceType, prop.objectType,
 								objectSpace->getRepository().size());
+  if (readOnly) {
+    // the search falls back to the shared graph if the search graph is unavailable.
+    openSearchGraph(allocator);
+  } else {
+    // the search graph becomes inconsistent once the index is updated.
+    MappedSearchGraphRepository::remove(allocator);
+  }
 #endif
 }
 
@@ -579,18 +766,26 @@ GraphAndTreeIndex::createTreeIndex()
 void 
 NGT::GraphIndex::initialize(const string &allocator, NGT::Property &prop) {
   constructObjectSpace(prop);
-  repository.open(allocator + "/grp", prop.graphSharedMemorySize);
-  objectSpace->open(allocator + "/obj", prop.objectSharedMemorySize);
+  MemoryManager::open_option_st option;
+  prop.getMemoryMapOption(option);
+  repository.open(allocator + "/grp", prop.graphSharedMemorySize, &option);
+  objectSpace->open(allocator + "/obj", prop.objectSharedMemorySize, &option);
   setProperty(prop);
 }
 #else // NGT_SHARED_MEMORY_ALLOCATOR
-NGT::GraphIndex::GraphIndex(const string &database, bool rdOnly):readOnly(rdOnly) {
+NGT::GraphIndex::GraphIndex(const string &database, bool rdOnly, Index::OpenType openType):readOnly(rdOnly),
+									     objectDisabled((openType & Index::OpenTypeObjectDisabled) != 0) {
   NGT::Property prop;
   prop.load(database);
   if (prop.databaseType != NGT::Index::Property::DatabaseType::Memory) {
     NGTThrowException("GraphIndex: Cannot open. Not memory type.");
   }
   assert(prop.dimension != 0);
+#ifdef NGT_GRAPH_READ_ONLY_GRAPH
+  if (readOnly && objectDisabled) {
+    NGTThrowException("GraphIndex: Cannot open. The search graph for the read only mode needs the objects.");
+  }
+#endif
   initialize(prop);
   loadIndex(database, readOnly);
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
@@ -33,6 +33,7 @@
 #include	"NGT/Tree.h"
 #include	"NGT/Thread.h"
 #include	"NGT/Graph.h"
+#include	"NGT/Journal.h"
 
 
 namespace NGT {
@@ -63,6 +64,22 @@ namespace NGT {
 	Memory			= 1,
 	MemoryMappedFile	= 2
       };
+      enum NumaPolicy {
+	NumaPolicyNotSet	= -1,
+	NumaPolicyNone		= 0,
+	NumaPolicyInterleave	= 1,
+	NumaPolicyBind		= 2
+      };
+      enum SearchGraphCompression {
+	SearchGraphCompressionNotSet	= -1,
+	SearchGraphCompressionNone	= 0,
+	SearchGraphCompressionVarint	= 1
+      };
+      enum RepositoryFormat {
+	RepositoryFormatNotSet	= -1,
+	RepositoryFormatLegacy	= 0,
+	RepositoryFormatChunked	= 1
+      };
       Property() { setDefault(); }
       void setDefault() {
 	dimension 	= 0;
@@ -72,13 +89,20 @@ namespace NGT {
 	indexType	= IndexType::GraphAndTree;
 	objectAlignment	= ObjectAlignment::ObjectAlignmentFalse;
 	pathAdjustmentInterval = 0;
+	searchGraphCompression	= SearchGraphCompressionNone;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	databaseType	= DatabaseType::MemoryMappedFile;
       	graphSharedMemorySize	= 512; // MB
       	treeSharedMemorySize	= 512; // MB
       	objectSharedMemorySize	= 512; // MB  512 is up to 50M objects.
+	mmapHugePage		= 0;
+	mmapPopulate		= 0;
+	mmapNumaPolicy		= NumaPolicyNone;
+	mmapNumaNode		= -1;
 #else
 	databaseType	= DatabaseType::Memory;
+	journalCompactionRate	= 0.0;
+	repositoryFormat	= RepositoryFormatLegacy;
 #endif
 	prefetchOffset	= 0;
 	prefetchSize	= 0;
@@ -92,10 +116,18 @@ namespace NGT {
 	databaseType	= DatabaseTypeNone;
 	objectAlignment	= ObjectAlignment::ObjectAlignmentNone;
 	pathAdjustmentInterval	= -1;
+	searchGraphCompression	= SearchGraphCompressionNotSet;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
       	graphSharedMemorySize	= -1;
       	treeSharedMemorySize	= -1;
       	objectSharedMemorySize	= -1;
+	mmapHugePage		= -1;
+	mmapPopulate		= -1;
+	mmapNumaPolicy		= NumaPolicyNotSet;
+	mmapNumaNode		= -1;
+#else
+	journalCompactionRate	= -1.0;
+	repositoryFormat	= RepositoryFormatNotSet;
 #endif
 	prefetchOffset	= -1;
 	prefetchSize	= -1;
@@ -143,10 +175,31 @@ namespace NGT {
 	default : std::cerr << "Fatal error. Invalid objectAlignment. " << objectAlignment << std::endl; abort();
 	}
 	p.set("PathAdjustmentInterval", pathAdjustmentInterval);
+	switch (searchGraphCompression) {
+	case SearchGraphCompression::SearchGraphCompressionNone:	p.set("SearchGraphCompression", "None"); break;
+	case SearchGraphCompression::SearchGraphCompressionVarint:	p.set("SearchGraphCompression", "Varint"); break;
+	default : std::cerr << "Fatal error. Invalid search graph compression. " << searchGraphCompression << std::endl; abort();
+	}
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	p.set("GraphSharedMemorySize", graphSharedMemorySize);
 	p.set("TreeSharedMemorySize", treeSharedMemorySize);
 	p.set("ObjectSharedMemorySize", objectSharedMemorySize);
+	p.set("MmapHugePage", mmapHugePage);
+	p.set("MmapPopulate", mmapPopulate);
+	switch (mmapNumaPolicy) {
+	case NumaPolicy::NumaPolicyNone:	p.set("MmapNumaPolicy", "None"); break;
+	case NumaPolicy::NumaPolicyInterleave:	p.set("MmapNumaPolicy", "Interleave"); break;
+	case NumaPolicy::NumaPolicyBind:	p.set("MmapNumaPolicy", "Bind"); break;
+	default : std::cerr << "Fatal error. Invalid NUMA policy. " << mmapNumaPolicy << std::endl; abort();
+	}
+	p.set("MmapNumaNode", mmapNumaNode);
+#else
+	p.set("JournalCompactionRate", journalCompactionRate);
+	switch (repositoryFormat) {
+	case RepositoryFormat::RepositoryFormatLegacy:	p.set("RepositoryFormat", "Legacy"); break;
+	case RepositoryFormat::RepositoryFormatChunked:	p.set("RepositoryFormat", "Chunked"); break;
+	default : std::cerr << "Fatal error. Invalid repository format. " << repositoryFormat << std::endl; abort();
+	}
 #endif
 	p.set("PrefetchOffset", prefetchOffset);
 	p.set("PrefetchSize", prefetchSize);
@@ -243,10 +296,47 @@ namespace NGT {
 	  objectAlignment = ObjectAlignment::ObjectAlignmentFalse;
 	}
 	pathAdjustmentInterval  = p.getl("PathAdjustmentInterval", pathAdjustmentInterval);
+	it = p.find("SearchGraphCompression");
+	if (it != p.end()) {
+	  if (it->second == "None") {
+	    searchGraphCompression = SearchGraphCompression::SearchGraphCompressionNone;
+	  } else if (it->second == "Varint") {
+	    searchGraphCompression = SearchGraphCompression::SearchGraphCompressionVarint;
+	  } else {
+	    std::cerr << "Invalid search graph compression in the property. " << it->first << ":" << it->second << std::endl;
+	  }
+	}
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	graphSharedMemorySize  = p.getl("GraphSharedMemorySize", graphSharedMemorySize);
 	treeSharedMemorySize   = p.getl("TreeSharedMemorySize", treeSharedMemorySize);
 	objectSharedMemorySize = p.getl("ObjectSharedMemorySize", objectSharedMemorySize);
+	mmapHugePage = p.getl("MmapHugePage", mmapHugePage);
+	mmapPopulate = p.getl("MmapPopulate", mmapPopulate);
+	it = p.find("MmapNumaPolicy");
+	if (it != p.end()) {
+	  if (it->second == "None") {
+	    mmapNumaPolicy = NumaPolicy::NumaPolicyNone;
+	  } else if (it->second == "Interleave") {
+	    mmapNumaPolicy = NumaPolicy::NumaPolicyInterleave;
+	  } else if (it->second == "Bind") {
+	    mmapNumaPolicy = NumaPolicy::NumaPolicyBind;
+	  } else {
+	    std::cerr << "Invalid NUMA policy in the property. " << it->first << ":" << it->second << std::endl;
+	  }
+	}
+	mmapNumaNode = p.getl("MmapNumaNode", mmapNumaNode);
+#else
+	journalCompactionRate = p.getf("JournalCompactionRate", journalCompactionRate);
+	it = p.find("RepositoryFormat");
+	if (it != p.end()) {
+	  if (it->second == "Legacy") {
+	    repositoryFormat = RepositoryFormat::RepositoryFormatLegacy;
+	  } else if (it->second == "Chunked") {
+	    repositoryFormat = RepositoryFormat::RepositoryFormatChunked;
+	  } else {
+	    std::cerr << "Invalid repository format in the property. " << it->first << ":" << it->second << std::endl;
+	  }
+	}
 #endif
 	prefetchOffset = p.getl("PrefetchOffset", prefetchOffset);
 	prefetchSize = p.getl("PrefetchSize", prefetchSize);
@@ -262,6 +352,27 @@ namespace NGT {
 
       void set(NGT::Property &prop);
       void get(NGT::Property &prop);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      void setMemoryMapOption(Index::Property &prop) {
+	if (prop.mmapHugePage != -1) mmapHugePage = prop.mmapHugePage;
+	if (prop.mmapPopulate != -1) mmapPopulate = prop.mmapPopulate;
+	if (prop.mmapNumaPolicy != NumaPolicyNotSet) {
+	  mmapNumaPolicy = prop.mmapNumaPolicy;
+	  mmapNumaNode = prop.mmapNumaNode;
+	}
+      }
+      void getMemoryMapOption(MemoryManager::open_option_st &option) {
+	MemoryManager::MmapManager::setDefaultOpenOptionValue(option);
+	option.use_hugepage = mmapHugePage > 0;
+	option.populate = mmapPopulate > 0;
+	switch (mmapNumaPolicy) {
+	case NumaPolicy::NumaPolicyInterleave: option.numa_policy = MemoryManager::NUMA_POLICY_INTERLEAVE; break;
+	case NumaPolicy::NumaPolicyBind: option.numa_policy = MemoryManager::NUMA_POLICY_BIND; break;
+	default: option.numa_policy = MemoryManager::NUMA_POLICY_NONE; break;
+	}
+	option.numa_node = mmapNumaNode;
+      }
+#endif
       int		dimension;
       int		threadPoolSize;
       ObjectSpace::ObjectType	objectType;
@@ -270,10 +381,18 @@ namespace NGT {
       DatabaseType	databaseType;
       ObjectAlignment	objectAlignment;
       int		pathAdjustmentInterval;
+      SearchGraphCompression	searchGraphCompression;	// the graph for the read-only search.
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
       int		graphSharedMemorySize;
       int		treeSharedMemorySize;
       int		objectSharedMemorySize;
+      int		mmapHugePage;
+      int		mmapPopulate;
+      NumaPolicy	mmapNumaPolicy;
+      int		mmapNumaNode;
+#else
+      float		journalCompactionRate;	// the ratio of the journal size to the base size for compaction. 0 disables the journal.
+      RepositoryFormat	repositoryFormat;	// the layout of obj, grp and tre. the chunked one cannot be read by older versions.
 #endif
       int		prefetchOffset;
       int		prefetchSize;
@@ -359,6 +478,16 @@ namespace NGT {
       std::vector<std::pair<float, double>> table;
     };
 
+    enum WarmupMode {
+      WarmupModeSweep	= 0,	// touch all of the objects, the graph and the tree.
+      WarmupModeQuery	= 1	// replay the specified queries to touch only the pages which the search uses.
+    };
+
+    enum OpenType {
+      OpenTypeNone		= 0x00,
+      OpenTypeObjectDisabled	= 0x04	// the objects are not loaded. only the graph and the tree are available.
+    };
+
     Index():index(0) {}
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     Index(NGT::Property &prop, const std::string &database);
@@ -366,6 +495,9 @@ namespace NGT {
     Index(NGT::Property &prop);
 #endif
     Index(const std::string &database, bool rdOnly = false):index(0) { open(database, rdOnly); }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    Index(const std::string &database, bool rdOnly, OpenType openType):index(0) { open(database, rdOnly, openType); }
+#endif
     Index(const std::string &database, NGT::Property &prop):index(0) { open(database, prop);  }
     virtual ~Index() { close(); }
 
@@ -374,6 +506,16 @@ namespace NGT {
       setProperty(prop);
     }
     void open(const std::string &database, bool rdOnly = false);
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    // With OpenTypeObjectDisabled, the objects are not loaded into the memory. The index can be used only
+    // for the searches which do not refer to the objects, and cannot be saved.
+    void open(const std::string &database, bool rdOnly, OpenType openType);
+#endif
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+    // The memory mapping options of the specified property are used instead of the stored ones
+    // unless they are cleared.
+    void open(const std::string &database, bool rdOnly, Index::Property &mmapProperty);
+#endif
 
     void close() {
       if (index != 0) { 
@@ -401,18 +543,23 @@ namespace NGT {
       }
     }
     static void create(const std::string &database, NGT::Property &prop, bool redirect = false) { createGraphAndTree(database, prop, redirect); }
-    static void createGraphAndTree(const std::string &database, NGT::Property &prop, const std::string &dataFile, size_t dataSize = 0, bool redirect = false);
+    static void createGraphAndTree(const std::string &database, NGT::Property &prop, const std::string &dataFile, size_t dataSize = 0, bool redirect = false,
+				   const std::string &dataFormat = "");
     static void createGraphAndTree(const std::string &database, NGT::Property &prop, bool redirect = false) { createGraphAndTree(database, prop, "", redirect); }
-    static void createGraph(const std::string &database, NGT::Property &prop, const std::string &dataFile, size_t dataSize = 0, bool redirect = false);
+    static void createGraph(const std::string &database, NGT::Property &prop, const std::string &dataFile, size_t dataSize = 0, bool redirect = false,
+			    const std::string &dataFormat = "");
     template<typename T> size_t insert(const std::vector<T> &object);
     template<typename T> size_t append(const std::vector<T> &object);
-    static void append(const std::string &database, const std::string &dataFile, size_t threadSize, size_t dataSize); 
+    template<typename T> void update(ObjectID id, const std::vector<T> &object);
+    template<typename T> void update(std::vector<ObjectID> &ids, const std::vector<std::vector<T> > &objects, size_t threadSize = 1);
+    static void append(const std::string &database, const std::string &dataFile, size_t threadSize, size_t dataSize, const std::string &dataFormat = "");
     static void append(const std::string &database, const float *data, size_t dataSize, size_t threadSize);
     static void remove(const std::string &database, std::vector<ObjectID> &objects, bool force = false);
+    static void compact(const std::string &database, std::vector<ObjectID> &newIDs);
     static void exportIndex(const std::string &database, const std::string &file);
     static void importIndex(const std::string &database, const std::string &file);
-    virtual void load(const std::string &ifile, size_t dataSize) { getIndex().load(ifile, dataSize); }
-    virtual void append(const std::string &ifile, size_t dataSize) { getIndex().append(ifile, dataSize); }
+    virtual void load(const std::string &ifile, size_t dataSize, const std::string &dataFormat = "") { getIndex().load(ifile, dataSize, dataFormat); }
+    virtual void append(const std::string &ifile, size_t dataSize, const std::string &dataFormat = "") { getIndex().append(ifile, dataSize, dataFormat); }
     virtual void append(const float *data, size_t dataSize) { 
       redirector.begin();
       try {
@@ -461,6 +608,12 @@ namespace NGT {
     virtual void search(NGT::SearchQuery &sc) { getIndex().search(sc); }
     virtual void search(NGT::SearchContainer &sc, ObjectDistances &seeds) { getIndex().search(sc, seeds); }
     virtual void remove(ObjectID id, bool force = false) { getIndex().remove(id, force); }
+    virtual void remove(std::vector<ObjectID> &ids, bool force = false) { getIndex().remove(ids, force); }
+    virtual void compact(std::vector<ObjectID> &newIDs) { getIndex().compact(newIDs); }
+    virtual void updateObject(ObjectID id, PersistentObject *object) { getIndex().updateObject(id, object); }
+    virtual void updateObjects(std::vector<ObjectID> &ids, std::vector<PersistentObject*> &objects, size_t threadSize = 1) {
+      getIndex().updateObjects(ids, objects, threadSize);
+    }
     virtual void exportIndex(const std::string &file) { getIndex().exportIndex(file); }
     virtual void importIndex(const std::string &file) { getIndex().importIndex(file); }
     virtual bool verify(std::vector<uint8_t> &status, bool info = false, char mode = '-') { return getIndex().verify(status, info, mode); }
@@ -475,6 +628,14 @@ namespace NGT {
       size_t isize = getIndex().getSharedMemorySize(os, t); 
       return osize + isize;
     }
+    // Load the pages of the index into the memory in parallel so that the first searches are not slowed down by page faults.
+    // Returns the increase of the resident memory size in bytes.
+    size_t warmup(WarmupMode mode = WarmupModeSweep, const std::string &queryFile = "", size_t querySize = 0,
+		  float epsilon = 0.1, size_t resultSize = 20);
+    // Returns the size of the touched memory.
+    virtual size_t touchPages();
+    template <class INDEX> static void replayQueries(INDEX &index, const std::string &queryFile, size_t querySize,
+						     float epsilon, size_t resultSize);
     float getEpsilonFromExpectedAccuracy(double accuracy);
     void searchUsingOnlyGraph(NGT::SearchContainer &sc) { 
       sc.distanceComputationCount = 0;
@@ -539,7 +700,7 @@ namespace NGT {
     }
 
     static void loadAndCreateIndex(Index &index, const std::string &database, const std::string &dataFile,
-				   size_t threadSize, size_t dataSize);
+				   size_t threadSize, size_t dataSize, const std::string &dataFormat = "");
 
     Index *index;
     std::string path;
@@ -551,13 +712,16 @@ namespace NGT {
   public:
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    GraphIndex(const std::string &allocator, bool rdOnly = false);
+    GraphIndex(const std::string &allocator, bool rdOnly = false, Index::Property *mmapProperty = 0);
     GraphIndex(const std::string &allocator, NGT::Property &prop):readOnly(false) {
       initialize(allocator, prop);
+#ifdef NGT_GRAPH_READ_ONLY_GRAPH
+      MappedSearchGraphRepository::remove(allocator);
+#endif
     }
     void initialize(const std::string &allocator, NGT::Property &prop);
 #else // NGT_SHARED_MEMORY_ALLOCATOR
-    GraphIndex(const std::string &database, bool rdOnly = false);
+    GraphIndex(const std::string &database, bool rdOnly = false, Index::OpenType openType = Index::OpenTypeNone);
     GraphIndex(NGT::Property &prop):readOnly(false) {
       initialize(prop);
     }
@@ -570,6 +734,12 @@ namespace NGT {
 #endif // NGT_SHARED_MEMORY_ALLOCATOR
 
     virtual ~GraphIndex() {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR) && defined(NGT_GRAPH_READ_ONLY_GRAPH)
+      if (!readOnly) {
+	// the search graph built by the other processes while this index is open becomes stale.
+	MappedSearchGraphRepository::touch(repository.getAllocator().file);
+      }
+#endif
       destructObjectSpace();
     }
     void constructObjectSpace(NGT::Property &prop);
@@ -597,49 +767,37 @@ namespace NGT {
       objectSpace = 0;
     }
 
-    virtual void load(const std::string &ifile, size_t dataSize = 0) {
+    virtual void load(const std::string &ifile, size_t dataSize = 0, const std::string &dataFormat = "") {
       if (ifile.empty()) {
 	return;
       }
-      std::istream *is;
-      std::ifstream *ifs = 0;
-      if (ifile == "-") {
-	is = &std::cin;
-      } else {
-	ifs = new std::ifstream;
-	ifs->std::ifstream::open(ifile);
-	if (!(*ifs)) {
-	  std::stringstream msg;
-	  msg << "Index::load: Cannot open the specified file. " << ifile;
-	  NGTThrowException(msg);
-	}
-	is = ifs;
-      }
-      try {
-	objectSpace->readText(*is, dataSize);
-      } catch(Exception &err) {
-	if (ifile != "-") {
-	  delete ifs;
-	}
-	throw(err);
-      }
-      if (ifile != "-") {
-	delete ifs;
-      }
+      objectSpace->getRepository().initialize();
+      appendObjectFile(ifile, dataSize, dataFormat);
     }
 
-    virtual void append(const std::string &ifile, size_t dataSize = 0) {
+    virtual void append(const std::string &ifile, size_t dataSize = 0, const std::string &dataFormat = "") {
       if (ifile.empty()) {
 	return;
       }
+      appendObjectFile(ifile, dataSize, dataFormat);
+    }
+
+    // The format of the file is guessed from the file extension unless it is specified.
+    void appendObjectFile(const std::string &ifile, size_t dataSize, const std::string &dataFormat) {
+      VectorFile::Format format = VectorFile::getFormat(ifile, dataFormat);
       std::istream *is;
       std::ifstream *ifs = 0;
       if (ifile == "-") {
 	is = &std::cin;
       } else {
 	ifs = new std::ifstream;
-	ifs->std::ifstream::open(ifile);
+	if (format == VectorFile::FormatText) {
+	  ifs->std::ifstream::open(ifile);
+	} else {
+	  ifs->std::ifstream::open(ifile, std::ios::in | std::ios::binary);
+	}
 	if (!(*ifs)) {
+	  delete ifs;
 	  std::stringstream msg;
 	  msg << "Index::load: Cannot open the specified file. " << ifile;
 	  NGTThrowException(msg);
@@ -647,16 +805,16 @@ namespace NGT {
 	is = ifs;
       }
       try {
-	objectSpace->appendText(*is, dataSize);
-      } catch(Exception &err) {
-	if (ifile != "-") {
-	  delete ifs;
+	if (format == VectorFile::FormatText) {
+	  objectSpace->appendText(*is, dataSize);
+	} else {
+	  objectSpace->appendBinary(*is, format, dataSize);
 	}
-	throw(err);
-      }
-      if (ifile != "-") {
+      } catch(Exception &err) {
 	delete ifs;
+	throw(err);
       }
+      delete ifs;
     }
 
     virtual void append(const float *data, size_t dataSize) { objectSpace->append(data, dataSize); }
@@ -668,7 +826,7 @@ namespace NGT {
 	mkdir(ofile);
       } catch(...) {}
       if (objectSpace != 0) {
-	objectSpace->serialize(ofile + "/obj");
+	objectSpace->serialize(ofile + "/obj", isChunkedRepository());
       } else {
 	std::cerr << "saveIndex::Warning! ObjectSpace is null. continue saving..." << std::endl;
       }
@@ -684,14 +842,132 @@ namespace NGT {
 	msg << "saveIndex:: Cannot open. " << fname;
 	NGTThrowException(msg);
       }
-      repository.serialize(osg);
+      repository.serialize(osg, isChunkedRepository());
 #endif
     }
 
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    bool isChunkedRepository() { return property.repositoryFormat == Index::Property::RepositoryFormatChunked; }
+#endif
+
     virtual void saveIndex(const std::string &ofile) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      if (objectDisabled) {
+	NGTThrowException("NGT::GraphIndex::saveIndex: The index opened without the objects cannot be saved.");
+      }
+      if (saveJournal(ofile)) {
+	saveProperty(ofile);
+	return;
+      }
+      // the journal is removed in advance, since it cannot be applied to the new base files.
+      journal.remove(ofile);
+      journalPath.clear();
+#endif
+      saveRepositories(ofile);
+      saveProperty(ofile);
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      startJournal(ofile);
+#endif
+    }
+
+    virtual void saveRepositories(const std::string &ofile) {
       saveObjectRepository(ofile);
       saveGraph(ofile);
-      saveProperty(ofile);
+    }
+
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    // Append the modified entries to the journal. Returns false when all of the entries should be saved instead.
+    bool saveJournal(const std::string &ofile) {
+      if (property.journalCompactionRate <= 0.0 || journalPath != ofile || !journal.isAvailable()) {
+	return false;
+      }
+      if (journal.getSize() > property.journalCompactionRate * getBaseSize(ofile)) {
+	return false;
+      }
+      try {
+	if (!recordJournal(true)) {
+	  journal.clear();
+	  journalPath.clear();
+	  return false;
+	}
+	journal.commit(ofile);
+      } catch(Exception &err) {
+	journal.clear();
+	journalPath.clear();
+	throw err;
+      }
+      return true;
+    }
+
+    // Track the entries modified from now on to append them at the next save.
+    void startJournal(const std::string &path) {
+      if (property.journalCompactionRate <= 0.0 || readOnly || objectDisabled) {
+	journal.clear();
+	journalPath.clear();
+	return;
+      }
+      recordJournal(false);
+      journalPath = path;
+    }
+
+    virtual bool recordJournal(bool collect) {
+      ObjectRepository &objectRepository = objectSpace->getRepository();
+      ObjectSpace *space = objectSpace;
+      bool recorded = journal.record(0, objectRepository.size(), objectRepository.modifiedEntries,
+				     [&objectRepository, space](std::ostream &os, size_t idx) {
+				       objectRepository.Parent::serialize(os, idx, space);
+				     }, collect);
+      recorded = journal.record(1, repository.size(), repository.modifiedEntries, [this](std::ostream &os, size_t idx) {
+	  repository.serializeEntry(os, idx);
+	}, collect) && recorded;
+      return recorded;
+    }
+
+    // The sections to apply the journal to the object repository and the graph. When searchGraph is true,
+    // the graph entries are applied to the search graph instead, and the object repository is skipped.
+    void getJournalSections(std::vector<Journal::Section> &sections, bool searchGraph = false) {
+      ObjectRepository &objectRepository = objectSpace->getRepository();
+      if (searchGraph) {
+#ifdef NGT_GRAPH_READ_ONLY_GRAPH
+	sections.push_back(Journal::Section());
+	if (isSearchGraphCompressed()) {
+	  sections.push_back(Journal::Section([this](size_t size) { compressedSearchRepository.resize(size); },
+					      [this](std::istream &is, size_t idx) { compressedSearchRepository.replaceEntry(is, idx); }));
+	  return;
+	}
+	sections.push_back(Journal::Section([this](size_t size) { searchRepository.resize(size); },
+					    [this, &objectRepository](std::istream &is, size_t idx) {
+					      searchRepository.replaceEntry(is, idx, objectRepository);
+					    }));
+#endif
+	return;
+      }
+      ObjectSpace *space = objectSpace;
+      sections.push_back(Journal::Section([&objectRepository](size_t size) { objectRepository.setSize(size); },
+					  [&objectRepository, space](std::istream &is, size_t idx) {
+					    objectRepository.replace(is, idx, space);
+					  }));
+      sections.push_back(Journal::Section([this](size_t size) { repository.setSize(size); },
+					  [this](std::istream &is, size_t idx) { repository.replaceEntry(is, idx); }));
+    }
+
+    void replayJournal(const std::string &ifile, std::vector<Journal::Section> &sections) {
+      journal.replay(ifile, sections);
+      objectSpace->getRepository().resetRemovedList();
+      repository.resetRemovedList();
+    }
+
+    virtual size_t getBaseSize(const std::string &path) {
+      return Journal::getFileSize(path + "/obj") + Journal::getFileSize(path + "/grp");
+    }
+#endif
+
+    bool isSearchGraphCompressed() {
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      return false;
+#else
+      return property.searchGraphCompression == Index::Property::SearchGraphCompressionVarint;
+#endif
     }
 
     void saveProperty(const std::string &file);
@@ -812,6 +1088,200 @@ namespace NGT {
       }
     }
 
+    // remove the objects at once. all of the IDs are validated before the index is modified.
+    // when force is specified, the IDs without objects are removed from the graph if they exist in it,
+    // and then an exception is thrown in the same way as remove(ObjectID, bool).
+    void remove(std::vector<ObjectID> &ids, bool force) {
+      std::vector<ObjectID> targets;
+      std::vector<ObjectID> missing;
+      checkRemovedObjects(ids, targets, missing, force);
+      removeObjects(targets);
+      if (!missing.empty()) {
+	removeNodesNaively(missing);
+	throwMissingObjects(missing);
+      }
+    }
+
+    void checkRemovedObjects(std::vector<ObjectID> &ids, std::vector<ObjectID> &targets, std::vector<ObjectID> &missing, bool force) {
+      std::vector<ObjectID> sortedIDs(ids);
+      std::sort(sortedIDs.begin(), sortedIDs.end());
+      sortedIDs.erase(std::unique(sortedIDs.begin(), sortedIDs.end()), sortedIDs.end());
+      targets.clear();
+      missing.clear();
+      for (std::vector<ObjectID>::iterator i = sortedIDs.begin(); i != sortedIDs.end(); i++) {
+	if (getObjectRepository().isEmpty(*i)) {
+	  missing.push_back(*i);
+	} else {
+	  targets.push_back(*i);
+	}
+      }
+      if (!missing.empty() && !force) {
+	std::stringstream msg;
+	msg << "NGT::GraphIndex::remove: Not found the specified IDs. Nothing is removed. # of the IDs=" << missing.size() << " ID=" << missing[0];
+	NGTThrowException(msg);
+      }
+    }
+
+    void removeObjects(std::vector<ObjectID> &targets) {
+      removeEdgesReliably(targets);
+      removeFromObjectRepository(targets);
+    }
+
+    void removeFromObjectRepository(std::vector<ObjectID> &targets) {
+      for (std::vector<ObjectID>::iterator i = targets.begin(); i != targets.end(); i++) {
+	try {
+	  getObjectRepository().remove(*i);
+	} catch(Exception &err) {
+	  std::cerr << "NGT::GraphIndex::remove:: cannot remove from feature. id=" << *i << " " << err.what() << std::endl;
+	}
+      }
+    }
+
+    void removeNodesNaively(std::vector<ObjectID> &missing) {
+      try {
+	removeEdgesReliably(missing);
+      } catch(...) {}
+    }
+
+    void throwMissingObjects(std::vector<ObjectID> &missing) {
+      std::stringstream msg;
+      msg << "NGT::GraphIndex::remove: Not found the specified IDs. # of the IDs=" << missing.size() << " ID=" << missing[0]
+	  << " Even though the objects could not be found, the objects could be removed from the tree and graph if they existed in them.";
+      NGTThrowException(msg);
+    }
+
+    void checkUpdatedObjects(std::vector<ObjectID> &ids, std::vector<PersistentObject*> &objects) {
+      std::stringstream msg;
+      if (ids.size() != objects.size()) {
+	msg << "NGT::GraphIndex::update: The numbers of the IDs and the objects are inconsistent. " << ids.size() << ":" << objects.size();
+      } else {
+	std::vector<ObjectID> sortedIDs(ids);
+	std::sort(sortedIDs.begin(), sortedIDs.end());
+	for (size_t i = 0; i < sortedIDs.size(); i++) {
+	  if (objectSpace->getRepository().isEmpty(sortedIDs[i]) || NeighborhoodGraph::repository.isEmpty(sortedIDs[i])) {
+	    msg << "NGT::GraphIndex::update: The specified object does not exist. ID=" << sortedIDs[i];
+	    break;
+	  }
+	  if (i > 0 && sortedIDs[i - 1] == sortedIDs[i]) {
+	    msg << "NGT::GraphIndex::update: The specified ID is duplicated. ID=" << sortedIDs[i];
+	    break;
+	  }
+	}
+      }
+      if (!msg.str().empty()) {
+	for (std::vector<PersistentObject*>::iterator i = objects.begin(); i != objects.end(); i++) {
+	  objectSpace->deleteObject(*i);
+	}
+	NGTThrowException(msg);
+      }
+    }
+
+    // replace the object of the specified ID and relink only the node and its neighbors.
+    // the old neighbors are used as the seeds to search for the new neighbors.
+    virtual void updateObject(ObjectID id, PersistentObject *object) {
+      std::vector<ObjectID> ids(1, id);
+      std::vector<PersistentObject*> objects(1, object);
+      checkUpdatedObjects(ids, objects);
+      ObjectDistances seeds;
+      GraphNode &node = *getNode(id);
+      for (size_t i = 0; i < node.size(); i++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	seeds.push_back(ObjectDistance(node.at(i, repository.allocator).id, 0.0));
+#else
+	seeds.push_back(ObjectDistance(node[i].id, 0.0));
+#endif
+      }
+      removeEdgesReliably(id);
+      ObjectRepository &fr = objectSpace->getRepository();
+      fr.erase(id);
+      fr.put(id, object);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      Object &po = *objectSpace->allocateObject(*fr[id]);
+#else
+      Object &po = *fr[id];
+#endif
+      ObjectDistances rs;
+      if (NeighborhoodGraph::property.graphType == NeighborhoodGraph::GraphTypeANNG) {
+	NGT::SearchContainer sc(po);
+	sc.setResults(&rs);
+	sc.size = NeighborhoodGraph::property.edgeSizeForCreation;
+	sc.radius = FLT_MAX;
+	sc.explorationCoefficient = NeighborhoodGraph::property.insertionRadiusCoefficient;
+	GraphIndex::search(sc, seeds);
+      } else {
+	searchForKNNGInsertion(po, id, rs);
+      }
+      insertNode(id, rs);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      objectSpace->deleteObject(&po);
+#endif
+    }
+
+    // replace the objects at once. the nodes are removed with the batch edge repair,
+    // and then inserted again in the same way as the index creation.
+    virtual void updateObjects(std::vector<ObjectID> &ids, std::vector<PersistentObject*> &objects, size_t threadSize) {
+      checkUpdatedObjects(ids, objects);
+      removeEdgesReliably(ids);
+      ObjectRepository &fr = objectSpace->getRepository();
+      for (size_t i = 0; i < ids.size(); i++) {
+	fr.erase(ids[i]);
+	fr.put(ids[i], objects[i]);
+      }
+      createIndex(threadSize == 0 ? 1 : threadSize);
+    }
+
+    // renumber the live objects densely. newIDs[old ID] is set to the new ID, or zero for the removed objects.
+    virtual void compact(std::vector<ObjectID> &newIDs) {
+      if (readOnly) {
+	NGTThrowException("NGT::GraphIndex::compact: The index is opened as read-only.");
+      }
+      ObjectRepository &fr = objectSpace->getRepository();
+      newIDs.clear();
+      newIDs.resize(fr.size(), 0);
+      if (fr.size() == 0) {
+	return;
+      }
+      size_t count = 0;
+      for (size_t id = 1; id < fr.size(); id++) {
+	if (!fr.isEmpty(id)) {
+	  newIDs[id] = ++count;
+	}
+      }
+      GraphRepository &graph = NeighborhoodGraph::repository;
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR)
+#pragma omp parallel for
+#endif
+      for (size_t id = 1; id < graph.size(); id++) {
+	if (graph.isEmpty(id) || id >= newIDs.size() || newIDs[id] == 0) {
+	  continue;
+	}
+	GraphNode &node = *getNode(id);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	for (GraphNode::iterator i = node.begin(graph.allocator); i != node.end(graph.allocator);) {
+	  if ((*i).id >= newIDs.size() || newIDs[(*i).id] == 0) {
+	    i = node.erase(i, graph.allocator);
+	    continue;
+	  }
+	  (*i).id = newIDs[(*i).id];
+	  i++;
+	}
+	std::sort(node.begin(graph.allocator), node.end(graph.allocator));
+#else
+	for (GraphNode::iterator i = node.begin(); i != node.end();) {
+	  if ((*i).id >= newIDs.size() || newIDs[(*i).id] == 0) {
+	    i = node.erase(i);
+	    continue;
+	  }
+	  (*i).id = newIDs[(*i).id];
+	  i++;
+	}
+	std::sort(node.begin(), node.end());
+#endif
+      }
+      graph.compact(newIDs, count + 1);
+      fr.compact(newIDs, count + 1);
+    }
+
     virtual void searchForNNGInsertion(Object &po, ObjectDistances &result) {
       NGT::SearchContainer sc(po);
       sc.setResults(&result);
@@ -1108,6 +1578,8 @@ namespace NGT {
       return size;
     }
 
+    virtual size_t touchPages();
+
     float getEpsilonFromExpectedAccuracy(double accuracy) { return accuracyTable.getEpsilon(accuracy); }
     Index::Property &getProperty() { return property; }
     bool getReadOnly() { return readOnly; }
@@ -1143,10 +1615,18 @@ namespace NGT {
 	return;
       }
       if (seeds.size() == 0) {
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR) || !defined(NGT_GRAPH_READ_ONLY_GRAPH)
+#if !defined(NGT_GRAPH_READ_ONLY_GRAPH)
 	getSeedsFromGraph(repository, seeds);
+#elif defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	if (readOnly && !mappedSearchRepository.empty()) {
+	  getSeedsFromGraph(mappedSearchRepository, seeds);
+	} else {
+	  getSeedsFromGraph(repository, seeds);
+	}
 #else
-	if (readOnly) {
+	if (readOnly && !compressedSearchRepository.empty()) {
+	  getSeedsFromGraph(compressedSearchRepository, seeds);
+	} else if (readOnly) {
 	  getSeedsFromGraph(searchRepository, seeds);
 	} else {
 	  getSeedsFromGraph(repository, seeds);
@@ -1160,8 +1640,14 @@ namespace NGT {
       NGT::SearchContainer so(sc);
       try {
 	if (readOnly) {
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR) || !defined(NGT_GRAPH_READ_ONLY_GRAPH)
+#if !defined(NGT_GRAPH_READ_ONLY_GRAPH)
 	  NeighborhoodGraph::search(so, seeds);
+#elif defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  if (!mappedSearchRepository.empty()) {
+	    (*searchUnupdatableGraph)(*this, so, seeds);
+	  } else {
+	    NeighborhoodGraph::search(so, seeds);
+	  }
 #else
 	  (*searchUnupdatableGraph)(*this, so, seeds);
 #endif
@@ -1181,6 +1667,11 @@ namespace NGT {
     Index::Property			property;
 
     bool readOnly;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    bool				objectDisabled = false;
+    Journal				journal;
+    std::string				journalPath;	// the index which the journal belongs to.
+#endif
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
     void (*searchUnupdatableGraph)(NGT::NeighborhoodGraph&, NGT::SearchContainer&, NGT::ObjectDistances&);
 #endif
@@ -1192,16 +1683,20 @@ namespace NGT {
   public:
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    GraphAndTreeIndex(const std::string &allocator, bool rdOnly = false):GraphIndex(allocator, false) {
+    GraphAndTreeIndex(const std::string &allocator, bool rdOnly = false, Index::Property *mmapProperty = 0):
+      GraphIndex(allocator, rdOnly, mmapProperty) {
       initialize(allocator, 0);
     }
     GraphAndTreeIndex(const std::string &allocator, NGT::Property &prop);
     void initialize(const std::string &allocator, size_t sharedMemorySize) {
       DVPTree::objectSpace = GraphIndex::objectSpace;
-      DVPTree::open(allocator + "/tre", sharedMemorySize);
+      MemoryManager::open_option_st option;
+      GraphIndex::property.getMemoryMapOption(option);
+      DVPTree::open(allocator + "/tre", sharedMemorySize, &option);
     }
 #else
-    GraphAndTreeIndex(const std::string &database, bool rdOnly = false) : GraphIndex(database, rdOnly) {
+    GraphAndTreeIndex(const std::string &database, bool rdOnly = false, Index::OpenType openType = Index::OpenTypeNone) :
+      GraphIndex(database, rdOnly, openType) {
       GraphAndTreeIndex::loadIndex(database, rdOnly);
     }
 
@@ -1337,8 +1832,8 @@ namespace NGT {
       DVPTree::objectSpace = GraphIndex::objectSpace;
     }
 
-    void saveIndex(const std::string &ofile) {
-      GraphIndex::saveIndex(ofile);
+    void saveRepositories(const std::string &ofile) {
+      GraphIndex::saveRepositories(ofile);
 #ifndef NGT_SHARED_MEMORY_ALLOCATOR
       std::string fname = ofile + "/tre";
       std::ofstream ost(fname);
@@ -1347,7 +1842,7 @@ namespace NGT {
 	msg << "saveIndex:: Cannot open. " << fname;
 	NGTThrowException(msg);
       }
-      DVPTree::serialize(ost);
+      DVPTree::serialize(ost, GraphIndex::isChunkedRepository());
 #endif
     }
 
@@ -1355,15 +1850,65 @@ namespace NGT {
       DVPTree::objectSpace = GraphIndex::objectSpace;
       std::ifstream ist(ifile + "/tre");
       DVPTree::deserialize(ist);
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      {
+	std::vector<Journal::Section> sections;
+	getJournalSections(sections);
+	if (objectDisabled) {
+	  sections[0] = Journal::Section();
+	}
+	replayJournal(ifile, sections);
+	startJournal(ifile);
+      }
+#endif
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       if (readOnly) {
 	if (property.objectAlignment == NGT::Index::Property::ObjectAlignmentTrue) {
 	  alignObjects();
 	}
-	GraphIndex::NeighborhoodGraph::loadSearchGraph(ifile);
+	GraphIndex::NeighborhoodGraph::loadSearchGraph(ifile, isSearchGraphCompressed());
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	std::vector<Journal::Section> sections;
+	GraphIndex::getJournalSections(sections, true);
+	sections.resize(4);
+	journal.replay(ifile, sections);
+#endif
       }
 #endif
     }
+
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    bool recordJournal(bool collect) {
+      bool recorded = GraphIndex::recordJournal(collect);
+      ObjectSpace *space = DVPTree::objectSpace;
+      recorded = journal.record(2, leafNodes.size(), leafNodes.modifiedEntries, [this, space](std::ostream &os, size_t idx) {
+	  leafNodes.serialize(os, idx, space);
+	}, collect) && recorded;
+      recorded = journal.record(3, internalNodes.size(), internalNodes.modifiedEntries, [this, space](std::ostream &os, size_t idx) {
+	  internalNodes.serialize(os, idx, space);
+	}, collect) && recorded;
+      return recorded;
+    }
+
+    void getJournalSections(std::vector<Journal::Section> &sections) {
+      GraphIndex::getJournalSections(sections);
+      ObjectSpace *space = DVPTree::objectSpace;
+      sections.push_back(Journal::Section([this](size_t size) { leafNodes.setSize(size); },
+					  [this, space](std::istream &is, size_t idx) { leafNodes.replace(is, idx, space); }));
+      sections.push_back(Journal::Section([this](size_t size) { internalNodes.setSize(size); },
+					  [this, space](std::istream &is, size_t idx) { internalNodes.replace(is, idx, space); }));
+    }
+
+    void replayJournal(const std::string &ifile, std::vector<Journal::Section> &sections) {
+      GraphIndex::replayJournal(ifile, sections);
+      leafNodes.resetRemovedList();
+      internalNodes.resetRemovedList();
+    }
+
+    size_t getBaseSize(const std::string &path) {
+      return GraphIndex::getBaseSize(path) + Journal::getFileSize(path + "/tre");
+    }
+#endif
     
     void exportIndex(const std::string &ofile) {
       GraphIndex::exportIndex(ofile);
@@ -1454,6 +1999,160 @@ namespace NGT {
       GraphIndex::remove(id, force);
     }
 
+    void remove(std::vector<ObjectID> &ids, bool force = false) {
+      std::vector<ObjectID> targets;
+      std::vector<ObjectID> missing;
+      GraphIndex::checkRemovedObjects(ids, targets, missing, force);
+      std::vector<bool> removed(NeighborhoodGraph::repository.size(), false);
+      for (std::vector<ObjectID>::iterator i = targets.begin(); i != targets.end(); i++) {
+	if (*i < removed.size()) {
+	  removed[*i] = true;
+	}
+      }
+      // a duplicated object that replaces the removed one in the leaf is found through the edges of
+      // the removed node, so the replacements are determined before the graph repair drops the edges.
+      // the tree is updated only after the graph has been repaired.
+      std::vector<std::pair<ObjectID, ObjectID> > replacements;
+      std::vector<ObjectID> naive;
+      replacements.reserve(targets.size());
+      for (std::vector<ObjectID>::iterator i = targets.begin(); i != targets.end(); i++) {
+	if (NeighborhoodGraph::repository.isEmpty(*i)) {
+	  if (force) {
+	    naive.push_back(*i);
+	  }
+	  continue;
+	}
+	replacements.push_back(std::make_pair(*i, findReplacementInTree(*i, removed)));
+      }
+      GraphIndex::removeEdgesReliably(targets);
+      for (std::vector<std::pair<ObjectID, ObjectID> >::iterator i = replacements.begin(); i != replacements.end(); i++) {
+	try {
+	  if ((*i).second == 0) {
+	    DVPTree::remove((*i).first);
+	  } else {
+	    DVPTree::replace((*i).first, (*i).second);
+	  }
+	} catch(Exception &err) {
+	  std::cerr << "remove:: cannot remove from tree. id=" << (*i).first << " " << err.what() << std::endl;
+	}
+      }
+      for (std::vector<ObjectID>::iterator i = naive.begin(); i != naive.end(); i++) {
+	try {
+	  DVPTree::removeNaively(*i);
+	} catch(...) {}
+      }
+      // the objects are removed last, since the tree needs them to find the leaves.
+      GraphIndex::removeFromObjectRepository(targets);
+      if (!missing.empty()) {
+	for (std::vector<ObjectID>::iterator i = missing.begin(); i != missing.end(); i++) {
+	  try {
+	    DVPTree::removeNaively(*i);
+	  } catch(...) {}
+	}
+	GraphIndex::removeNodesNaively(missing);
+	GraphIndex::throwMissingObjects(missing);
+      }
+    }
+
+    // find a duplicated object that is not in the removed set to take over the leaf entry of the
+    // specified object. zero is returned when there is no such object.
+    ObjectID findReplacementInTree(ObjectID id, std::vector<bool> &removed) {
+      GraphNode &node = *GraphIndex::getNode(id);
+      for (size_t j = 0; j < node.size(); j++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	ObjectDistance edge = node.at(j, NeighborhoodGraph::repository.allocator);
+#else
+	ObjectDistance &edge = node[j];
+#endif
+	if (edge.distance != 0.0) {
+	  break;
+	}
+	if (edge.id != id && (edge.id >= removed.size() || !removed[edge.id])) {
+	  return edge.id;
+	}
+      }
+      return 0;
+    }
+
+    // remove the specified object from the tree. a duplicated object that is not in the removed set
+    // takes over the leaf entry instead.
+    void removeFromTree(ObjectID id, std::vector<bool> &removed) {
+      ObjectID replaceID = findReplacementInTree(id, removed);
+      if (replaceID == 0) {
+	DVPTree::remove(id);
+      } else {
+	try {
+	  DVPTree::replace(id, replaceID);
+	} catch(Exception &err) {
+	}
+      }
+    }
+
+    void insertIntoTree(ObjectID id) {
+      GraphNode &node = *GraphIndex::getNode(id);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      if (node.size() > 0 && node.at(0, NeighborhoodGraph::repository.allocator).distance == 0.0) {
+#else
+      if (node.size() > 0 && node[0].distance == 0.0) {
+#endif
+	return;
+      }
+      ObjectRepository &fr = GraphIndex::objectSpace->getRepository();
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      Object &po = *GraphIndex::objectSpace->allocateObject(*fr[id]);
+#else
+      Object &po = *fr[id];
+#endif
+      DVPTree::InsertContainer tiobj(po, id);
+      try {
+	DVPTree::insert(tiobj);
+      } catch (Exception &err) {
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	GraphIndex::objectSpace->deleteObject(&po);
+#endif
+	throw err;
+      }
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      GraphIndex::objectSpace->deleteObject(&po);
+#endif
+    }
+
+    void updateObject(ObjectID id, PersistentObject *object) {
+      std::vector<ObjectID> ids(1, id);
+      std::vector<PersistentObject*> objects(1, object);
+      GraphIndex::checkUpdatedObjects(ids, objects);
+      std::vector<bool> removed;
+      try {
+	removeFromTree(id, removed);
+      } catch(Exception &err) {
+	// the object might not be in the tree if the same object had been inserted.
+      }
+      GraphIndex::updateObject(id, object);
+      insertIntoTree(id);
+    }
+
+    void updateObjects(std::vector<ObjectID> &ids, std::vector<PersistentObject*> &objects, size_t threadSize) {
+      GraphIndex::checkUpdatedObjects(ids, objects);
+      std::vector<bool> removed(NeighborhoodGraph::repository.size(), false);
+      for (std::vector<ObjectID>::iterator i = ids.begin(); i != ids.end(); i++) {
+	removed[*i] = true;
+      }
+      for (std::vector<ObjectID>::iterator i = ids.begin(); i != ids.end(); i++) {
+	try {
+	  removeFromTree(*i, removed);
+	} catch(Exception &err) {
+	  // the object might not be in the tree if the same object had been inserted.
+	}
+      }
+      // the tree entries are inserted again in createIndex.
+      GraphIndex::updateObjects(ids, objects, threadSize);
+    }
+
+    void compact(std::vector<ObjectID> &newIDs) {
+      GraphIndex::compact(newIDs);
+      DVPTree::compact(newIDs);
+    }
+
     void searchForNNGInsertion(Object &po, ObjectDistances &result) {
       NGT::SearchContainer sc(po);
       sc.setResults(&result);
@@ -1596,6 +2295,8 @@ namespace NGT {
       return GraphIndex::getSharedMemorySize(os, t) + DVPTree::getSharedMemorySize(os, t);
     }
 
+    size_t touchPages() { return GraphIndex::touchPages() + DVPTree::touchPages(); }
+
     bool verify(std::vector<uint8_t> &status, bool info, char mode);
 
   };
@@ -1677,4 +2378,81 @@ size_t NGT::Index::insert(const std::vector<T> &object)
   return oid;
 }
 
+template<typename T>
+void NGT::Index::update(ObjectID id, const std::vector<T> &object)
+{
+  auto *o = getObjectSpace().getRepository().allocateNormalizedPersistentObject(object);
+  updateObject(id, dynamic_cast<PersistentObject*>(o));
+}
+
+template<typename T>
+void NGT::Index::update(std::vector<ObjectID> &ids, const std::vector<std::vector<T> > &objects, size_t threadSize)
+{
+  std::vector<PersistentObject*> pobjects;
+  pobjects.reserve(objects.size());
+  try {
+    for (auto i = objects.begin(); i != objects.end(); ++i) {
+      auto *o = getObjectSpace().getRepository().allocateNormalizedPersistentObject(*i);
+      pobjects.push_back(dynamic_cast<PersistentObject*>(o));
+    }
+  } catch(Exception &err) {
+    for (auto i = pobjects.begin(); i != pobjects.end(); ++i) {
+      getObjectSpace().deleteObject(*i);
+    }
+    throw err;
+  }
+  updateObjects(ids, pobjects, threadSize);
+}
 
+// Search the queries of the specified file in parallel only to fault in the pages which the searches use.
+template <class INDEX>
+void NGT::Index::replayQueries(INDEX &index, const std::string &queryFile, size_t querySize, float epsilon, size_t resultSize)
+{
+  std::ifstream is(queryFile);
+  if (!is) {
+    std::stringstream msg;
+    msg << "NGT::Index::replayQueries: Cannot open the specified query file. " << queryFile;
+    NGTThrowException(msg);
+  }
+  std::vector<std::string> queries;
+  std::string line;
+  while (getline(is, line)) {
+    if (querySize > 0 && queries.size() >= querySize) {
+      break;
+    }
+    if (!line.empty()) {
+      queries.push_back(line);
+    }
+  }
+  std::string error;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t qi = 0; qi < queries.size(); qi++) {
+    NGT::Object *query = 0;
+    try {
+      query = index.allocateObject(queries[qi], " \t");
+      NGT::SearchContainer sc(*query);
+      NGT::ObjectDistances objects;
+      sc.setResults(&objects);
+      sc.setSize(resultSize);
+      sc.setEpsilon(epsilon);
+      index.search(sc);
+    } catch (Exception &err) {
+#pragma omp critical
+      {
+	if (error.empty()) {
+	  std::stringstream msg;
+	  msg << err.what() << " query#=" << qi + 1;
+	  error = msg.str();
+	}
+      }
+    }
+    if (query != 0) {
+      index.deleteObject(query);
+    }
+  }
+  if (!error.empty()) {
+    std::stringstream msg;
+    msg << "NGT::Index::replayQueries: " << error;
+    NGTThrowException(msg);
+  }
+}
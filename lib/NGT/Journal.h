@@ -0,0 +1,295 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<unistd.h>
+#include	<sys/stat.h>
+#include	<functional>
+
+#include	"NGT/Common.h"
+
+namespace NGT {
+
+  // An append-only journal of the modified entries of the repositories (sections), where each save appends a record.
+  class Journal {
+  public:
+    static const uint64_t	magic = 0x314c4e524a54474eULL;	// "NGTJRNL1"
+    static const size_t		chunkSize = 16384;
+
+    // A stream buffer which appends the written data to a string.
+    class StringBuffer : public std::streambuf {
+    public:
+      std::string	data;
+    protected:
+      int_type overflow(int_type c) {
+	if (c != traits_type::eof()) {
+	  data.push_back(static_cast<char>(c));
+	}
+	return c;
+      }
+      std::streamsize xsputn(const char *s, std::streamsize n) {
+	data.append(s, n);
+	return n;
+      }
+    };
+
+    // resize(size) sets the number of entries of the repository, and decode(is, idx) replaces the idx-th entry
+    // with the one in the stream. The section is skipped when they are empty.
+    class Section {
+    public:
+      Section() {}
+      Section(std::function<void(size_t)> r, std::function<void(std::istream&, size_t)> d):resize(r), decode(d) {}
+      std::function<void(size_t)>			resize;
+      std::function<void(std::istream&, size_t)>	decode;
+    };
+
+    Journal():fileSize(0) {}
+
+    static std::string getFileName(const std::string &database) { return database + "/jnl"; }
+
+    static size_t getFileSize(const std::string &file) {
+      struct stat st;
+      return stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    // Collect the entries modified since the last save, or only start tracking them when collect is false.
+    template <typename ENCODER>
+    bool record(size_t section, size_t size, ModifiedEntries &modifiedEntries, ENCODER encode, bool collect) {
+      if (collect && section >= sizes.size()) {
+	NGTThrowException("NGT::Journal::record: The section is not tracked.");
+      }
+      if (sizes.size() <= section) {
+	sizes.resize(section + 1, 0);
+	trackers.resize(section + 1, 0);
+      }
+      size_t previousSize = sizes[section];
+      sizes[section] = size;
+      trackers[section] = &modifiedEntries;
+      if (!collect) {
+	modifiedEntries.enable(true);
+	return true;
+      }
+      if (modifiedEntries.isAll()) {
+	return false;
+      }
+      std::vector<size_t> ids;
+      modifiedEntries.get(ids);
+      modifiedEntries.enable(true);
+      ids.erase(std::lower_bound(ids.begin(), ids.end(), std::min(previousSize, size)), ids.end());
+      for (size_t idx = previousSize; idx < size; idx++) {
+	ids.push_back(idx);
+      }
+      size_t numberOfChunks = (ids.size() + chunkSize - 1) / chunkSize;
+      std::vector<std::string> entries(numberOfChunks);
+#pragma omp parallel for schedule(dynamic)
+      for (size_t ci = 0; ci < numberOfChunks; ci++) {
+	StringBuffer buffer;
+	std::ostream os(&buffer);
+	size_t end = std::min((ci + 1) * chunkSize, ids.size());
+	for (size_t i = ci * chunkSize; i < end; i++) {
+	  buffer.data.clear();
+	  encode(os, ids[i]);
+	  uint64_t entryHeader[2] = {ids[i], buffer.data.size()};
+	  entries[ci].append(reinterpret_cast<const char*>(entryHeader), sizeof(entryHeader));
+	  entries[ci].append(buffer.data);
+	}
+      }
+      if (payloads.size() <= section) {
+	payloads.resize(section + 1);
+      }
+      uint64_t count = ids.size();
+      uint64_t entrySize = 0;
+      for (size_t ci = 0; ci < numberOfChunks; ci++) {
+	entrySize += entries[ci].size();
+      }
+      std::string &payload = payloads[section];
+      payload.clear();
+      payload.reserve(sizeof(uint64_t) * 3 + entrySize);
+      uint64_t repositorySize = size;
+      payload.append(reinterpret_cast<const char*>(&repositorySize), sizeof(repositorySize));
+      payload.append(reinterpret_cast<const char*>(&count), sizeof(count));
+      payload.append(reinterpret_cast<const char*>(&entrySize), sizeof(entrySize));
+      for (size_t ci = 0; ci < numberOfChunks; ci++) {
+	payload.append(entries[ci]);
+	std::string().swap(entries[ci]);
+      }
+      modified = modified || count != 0 || size != previousSize;
+      return true;
+    }
+
+    // Append the collected entries of all of the sections as a record. Returns the size of the record.
+    // Nothing is appended if no entry was modified.
+    size_t commit(const std::string &database) {
+      if (!modified) {
+	payloads.clear();
+	return 0;
+      }
+      std::string fname = getFileName(database);
+      uint64_t payloadSize = 0;
+      for (auto i = payloads.begin(); i != payloads.end(); ++i) {
+	payloadSize += (*i).size();
+      }
+      try {
+	if (getFileSize(fname) > fileSize && truncate(fname.c_str(), fileSize) != 0) {
+	  std::stringstream msg;
+	  msg << "NGT::Journal::commit: Cannot truncate the torn record. " << fname;
+	  NGTThrowException(msg);
+	}
+	std::ofstream os(fname, std::ios::app | std::ios::binary);
+	if (!os.is_open()) {
+	  std::stringstream msg;
+	  msg << "NGT::Journal::commit: Cannot open the journal. " << fname;
+	  NGTThrowException(msg);
+	}
+	Serializer::write(os, magic);
+	Serializer::write(os, static_cast<uint64_t>(payloads.size()));
+	Serializer::write(os, payloadSize);
+	for (auto i = payloads.begin(); i != payloads.end(); ++i) {
+	  os.write((*i).data(), (*i).size());
+	}
+	Serializer::write(os, payloadSize);
+	Serializer::write(os, magic);
+	os.flush();
+	if (!os) {
+	  std::stringstream msg;
+	  msg << "NGT::Journal::commit: Cannot write the journal. " << fname;
+	  NGTThrowException(msg);
+	}
+      } catch (Exception &err) {
+	// the tracked entries are no longer consistent with the file.
+	clear();
+	throw err;
+      }
+      payloads.clear();
+      modified = false;
+      size_t recordSize = sizeof(uint64_t) * 5 + payloadSize;
+      fileSize += recordSize;
+      return recordSize;
+    }
+
+    // Apply the records to the repositories of the sections.
+    void replay(const std::string &database, std::vector<Section> &sections) {
+      fileSize = 0;
+      std::string fname = getFileName(database);
+      std::ifstream is(fname, std::ios::binary);
+      if (!is.is_open()) {
+	return;
+      }
+      size_t totalSize = getFileSize(fname);
+      for (size_t recordCount = 0;; recordCount++) {
+	uint64_t header[3];
+	is.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (is.gcount() == 0) {
+	  break;
+	}
+	uint64_t trailer[2] = {0, 0};
+	std::vector<char> payload;
+	if (is.gcount() == sizeof(header) && header[0] == magic &&
+	    fileSize + sizeof(header) + header[2] + sizeof(trailer) <= totalSize) {
+	  payload.resize(header[2]);
+	  is.read(payload.data(), payload.size());
+	  is.read(reinterpret_cast<char*>(trailer), sizeof(trailer));
+	}
+	if (!is || trailer[0] != header[2] || trailer[1] != magic) {
+	  std::cerr << "NGT::Journal::replay: Warning! The last record is torn. It is ignored. "
+		    << fname << " record#=" << recordCount << std::endl;
+	  break;
+	}
+	if (header[1] != sections.size()) {
+	  std::stringstream msg;
+	  msg << "NGT::Journal::replay: The number of the sections is inconsistent. " << fname << " "
+	      << header[1] << ":" << sections.size();
+	  NGTThrowException(msg);
+	}
+	size_t pos = 0;
+	for (size_t si = 0; si < sections.size(); si++) {
+	  uint64_t sectionHeader[3];
+	  if (!read(payload, pos, sectionHeader, sizeof(sectionHeader)) || pos + sectionHeader[2] > payload.size()) {
+	    std::stringstream msg;
+	    msg << "NGT::Journal::replay: The record is corrupted. " << fname << " record#=" << recordCount;
+	    NGTThrowException(msg);
+	  }
+	  if (!sections[si].resize) {
+	    pos += sectionHeader[2];
+	    continue;
+	  }
+	  sections[si].resize(sectionHeader[0]);
+	  for (uint64_t ei = 0; ei < sectionHeader[1]; ei++) {
+	    uint64_t entryHeader[2];
+	    if (!read(payload, pos, entryHeader, sizeof(entryHeader)) || entryHeader[0] >= sectionHeader[0] ||
+		pos + entryHeader[1] > payload.size()) {
+	      std::stringstream msg;
+	      msg << "NGT::Journal::replay: The entry is corrupted. " << fname << " record#=" << recordCount;
+	      NGTThrowException(msg);
+	    }
+	    ChunkedSerializer::MemoryBuffer mb(payload.data() + pos, entryHeader[1]);
+	    std::istream eis(&mb);
+	    sections[si].decode(eis, entryHeader[0]);
+	    if (!eis) {
+	      std::stringstream msg;
+	      msg << "NGT::Journal::replay: Cannot decode the entry. " << fname << " record#=" << recordCount
+		  << " ID=" << entryHeader[0];
+	      NGTThrowException(msg);
+	    }
+	    pos += entryHeader[1];
+	  }
+	}
+	fileSize += sizeof(header) + payload.size() + sizeof(trailer);
+      }
+    }
+
+    void remove(const std::string &database) {
+      std::remove(getFileName(database).c_str());
+      fileSize = 0;
+    }
+
+    void clear() {
+      for (auto i = trackers.begin(); i != trackers.end(); ++i) {
+	if (*i != 0) {
+	  (*i)->enable(false);
+	}
+      }
+      trackers.clear();
+      sizes.clear();
+      payloads.clear();
+      modified = false;
+    }
+
+    // Returns true if the modified entries are tracked.
+    bool isAvailable() { return !sizes.empty(); }
+
+    // The size of the valid records in the journal file.
+    size_t getSize() { return fileSize; }
+
+  protected:
+    static bool read(std::vector<char> &payload, size_t &pos, void *data, size_t size) {
+      if (pos + size > payload.size()) {
+	return false;
+      }
+      memcpy(data, payload.data() + pos, size);
+      pos += size;
+      return true;
+    }
+
+    std::vector<size_t>			sizes;		// the number of the entries of each section at the last save.
+    std::vector<ModifiedEntries*>	trackers;
+    std::vector<std::string>		payloads;
+    bool				modified = false;
+    size_t				fileSize;
+  };
+
+} // namespace NGT
@@ -0,0 +1,723 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include	"NGT/defines.h"
+#include	"NGT/Common.h"
+#include	"NGT/Index.h"
+#include	"NGT/MappedIndex.h"
+#include	"NGT/HashBasedBooleanSet.h"
+
+#include	<sys/mman.h>
+#include	<sys/stat.h>
+#include	<unistd.h>
+
+using namespace std;
+using namespace NGT;
+
+static const char	mappedIndexMagic[8]	= {'N', 'G', 'T', 'M', 'A', 'P', 'P', 'D'};
+static const uint64_t	mappedIndexVersion	= 1;
+
+static inline uint64_t
+alignOffset(uint64_t offset, uint64_t alignment)
+{
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+static void
+writePadding(ofstream &os, uint64_t &position, uint64_t target)
+{
+  static const char zeros[4096] = {0};
+  while (position < target) {
+    size_t size = target - position < sizeof(zeros) ? target - position : sizeof(zeros);
+    os.write(zeros, size);
+    position += size;
+  }
+}
+
+template <typename T> static void
+writeArray(ofstream &os, uint64_t &position, const vector<T> &array)
+{
+  if (array.empty()) {
+    return;
+  }
+  os.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+  position += array.size() * sizeof(T);
+}
+
+void
+MappedIndex::build(NGT::Index &index, const string &file)
+{
+  GraphIndex &graph = static_cast<GraphIndex&>(index.getIndex());
+  GraphAndTreeIndex *gtindex = dynamic_cast<GraphAndTreeIndex*>(&index.getIndex());
+  ObjectSpace &objectSpace = graph.getObjectSpace();
+  ObjectRepository &objectRepository = objectSpace.getRepository();
+  NGT::Property prop;
+  index.getProperty(prop);
+
+  if (prop.distanceType == ObjectSpace::DistanceTypeSparseJaccard) {
+    NGTThrowException("NGT::MappedIndex::build: Sparse objects are not supported.");
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, mappedIndexMagic, sizeof(header.magic));
+  header.version		= mappedIndexVersion;
+  header.objectType		= prop.objectType;
+  header.distanceType		= prop.distanceType;
+  header.dimension		= objectSpace.getDimension();
+  header.paddedDimension	= objectSpace.getPaddedDimension();
+  header.objectStride		= alignOffset(objectSpace.getByteSizeOfObject(), 64);
+  header.numberOfObjects	= objectRepository.size();
+  header.edgeSizeForSearch	= prop.edgeSizeForSearch;
+  header.seedType		= prop.seedType;
+  header.seedSize		= prop.seedSize;
+  header.dynamicEdgeSizeBase	= prop.dynamicEdgeSizeBase;
+  header.dynamicEdgeSizeRate	= prop.dynamicEdgeSizeRate;
+  header.prefetchOffset		= objectSpace.getPrefetchOffset();
+  header.prefetchSize		= objectSpace.getPrefetchSize();
+
+  const size_t nOfObjects = header.numberOfObjects;
+  const size_t byteSize = objectSpace.getByteSizeOfObject();
+
+  // graph
+  vector<uint64_t> graphIndex(nOfObjects + 1, 0);
+  vector<uint32_t> graphEdges;
+  for (size_t id = 1; id < nOfObjects; id++) {
+    graphIndex[id] = graphEdges.size();
+    if (objectRepository.isEmpty(id) || id >= graph.repository.size() || graph.repository.isEmpty(id)) {
+      continue;
+    }
+    GraphNode &node = *graph.getNode(id);
+    for (size_t i = 0; i < node.size(); i++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      ObjectID nid = node.at(i, graph.repository.allocator).id;
+#else
+      ObjectID nid = node[i].id;
+#endif
+      if (nid >= nOfObjects || objectRepository.isEmpty(nid)) {
+	continue;
+      }
+      graphEdges.push_back(nid);
+    }
+  }
+  graphIndex[nOfObjects] = graphEdges.size();
+  header.numberOfEdges = graphEdges.size();
+
+  // tree
+  vector<uint32_t> internalChildren;
+  vector<float> internalBorders;
+  vector<uint64_t> leafIndex;
+  vector<uint32_t> leafObjects;
+  if (gtindex != 0) {
+    DVPTree &tree = static_cast<DVPTree&>(*gtindex);
+    const size_t csize = tree.internalChildrenSize;
+    header.childrenSize = csize;
+    header.numberOfInternalNodes = tree.internalNodes.size();
+    header.numberOfLeafNodes = tree.leafNodes.size();
+    internalChildren.resize(header.numberOfInternalNodes * csize, 0);
+    internalBorders.resize(header.numberOfInternalNodes * (csize - 1), 0.0);
+    for (size_t nid = 1; nid < header.numberOfInternalNodes; nid++) {
+      if (tree.internalNodes.isEmpty(nid)) {
+	continue;
+      }
+      InternalNode &node = *tree.internalNodes.get(nid);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      Node::ID *children = node.getChildren(tree.internalNodes.allocator);
+      Distance *borders = node.getBorders(tree.internalNodes.allocator);
+#else
+      Node::ID *children = node.getChildren();
+      Distance *borders = node.getBorders();
+#endif
+      for (size_t ci = 0; ci < csize; ci++) {
+	internalChildren[nid * csize + ci] = children[ci].get();
+      }
+      for (size_t bi = 0; bi < csize - 1; bi++) {
+	internalBorders[nid * (csize - 1) + bi] = borders[bi];
+      }
+    }
+    leafIndex.resize(header.numberOfLeafNodes + 1, 0);
+    for (size_t nid = 1; nid < header.numberOfLeafNodes; nid++) {
+      leafIndex[nid] = leafObjects.size();
+      if (tree.leafNodes.isEmpty(nid)) {
+	continue;
+      }
+      LeafNode &leaf = *tree.leafNodes.get(nid);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      ObjectDistance *objects = leaf.getObjectIDs(tree.leafNodes.allocator);
+#else
+      ObjectDistance *objects = leaf.getObjectIDs();
+#endif
+      for (size_t i = 0; i < leaf.getObjectSize(); i++) {
+	leafObjects.push_back(objects[i].id);
+      }
+    }
+    leafIndex[header.numberOfLeafNodes] = leafObjects.size();
+    header.numberOfLeafObjects = leafObjects.size();
+    if (header.numberOfInternalNodes > 1 && !tree.internalNodes.isEmpty(1)) {
+      Node::ID root;
+      root.setID(1);
+      root.setType(Node::ID::Internal);
+      header.rootNodeID = root.get();
+    } else if (header.numberOfLeafNodes > 1 && !tree.leafNodes.isEmpty(1)) {
+      Node::ID root;
+      root.setID(1);
+      root.setType(Node::ID::Leaf);
+      header.rootNodeID = root.get();
+    }
+  }
+
+  header.objectOffset		= alignOffset(sizeof(Header), 4096);
+  header.graphIndexOffset	= alignOffset(header.objectOffset + nOfObjects * header.objectStride, 64);
+  header.graphEdgeOffset	= alignOffset(header.graphIndexOffset + graphIndex.size() * sizeof(uint64_t), 64);
+  header.internalChildrenOffset	= alignOffset(header.graphEdgeOffset + graphEdges.size() * sizeof(uint32_t), 64);
+  header.internalBordersOffset	= alignOffset(header.internalChildrenOffset + internalChildren.size() * sizeof(uint32_t), 64);
+  header.pivotOffset		= alignOffset(header.internalBordersOffset + internalBorders.size() * sizeof(float), 64);
+  header.leafIndexOffset	= alignOffset(header.pivotOffset + header.numberOfInternalNodes * header.objectStride, 64);
+  header.leafObjectOffset	= alignOffset(header.leafIndexOffset + leafIndex.size() * sizeof(uint64_t), 64);
+  header.fileSize		= header.leafObjectOffset + leafObjects.size() * sizeof(uint32_t);
+
+  // the image is written into a temporary file and renamed, because truncating the file which is mapped
+  // by the other processes makes them crash. they keep searching the previous image until they reopen it.
+  stringstream tmp;
+  tmp << file << "." << getpid();
+  ofstream os(tmp.str(), ios::out | ios::binary | ios::trunc);
+  if (!os) {
+    stringstream msg;
+    msg << "NGT::MappedIndex::build: Cannot open the file. " << tmp.str();
+    NGTThrowException(msg);
+  }
+  uint64_t position = 0;
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  position += sizeof(header);
+
+  vector<uint8_t> buffer(header.objectStride);
+  writePadding(os, position, header.objectOffset);
+  for (size_t id = 0; id < nOfObjects; id++) {
+    memset(buffer.data(), 0, buffer.size());
+    if (id != 0 && !objectRepository.isEmpty(id)) {
+      memcpy(buffer.data(), objectSpace.getObject(id), byteSize);
+    }
+    os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    position += buffer.size();
+  }
+
+  writePadding(os, position, header.graphIndexOffset);
+  writeArray(os, position, graphIndex);
+  writePadding(os, position, header.graphEdgeOffset);
+  writeArray(os, position, graphEdges);
+  writePadding(os, position, header.internalChildrenOffset);
+  writeArray(os, position, internalChildren);
+  writePadding(os, position, header.internalBordersOffset);
+  writeArray(os, position, internalBorders);
+
+  writePadding(os, position, header.pivotOffset);
+  for (size_t nid = 0; nid < header.numberOfInternalNodes; nid++) {
+    memset(buffer.data(), 0, buffer.size());
+    DVPTree &tree = static_cast<DVPTree&>(*gtindex); // numberOfInternalNodes is zero without a tree.
+    if (nid != 0 && !tree.internalNodes.isEmpty(nid)) {
+      InternalNode &node = *tree.internalNodes.get(nid);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      memcpy(buffer.data(), &node.getPivot(objectSpace).at(0, objectRepository.getAllocator()), byteSize);
+#else
+      memcpy(buffer.data(), &node.getPivot()[0], byteSize);
+#endif
+    }
+    os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    position += buffer.size();
+  }
+
+  writePadding(os, position, header.leafIndexOffset);
+  writeArray(os, position, leafIndex);
+  writePadding(os, position, header.leafObjectOffset);
+  writeArray(os, position, leafObjects);
+
+  os.close();
+  if (!os || rename(tmp.str().c_str(), file.c_str()) != 0) {
+    unlink(tmp.str().c_str());
+    stringstream msg;
+    msg << "NGT::MappedIndex::build: Cannot write the file. " << file;
+    NGTThrowException(msg);
+  }
+}
+
+void
+MappedIndex::build(const string &database)
+{
+  NGT::Index index(database, false);
+  build(index, getFileName(database));
+}
+
+void
+MappedIndex::open(const string &database)
+{
+  close();
+  string file = getFileName(database);
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    stringstream msg;
+    msg << "NGT::MappedIndex::open: Cannot open the file. " << file;
+    NGTThrowException(msg);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    ::close(fd);
+    stringstream msg;
+    msg << "NGT::MappedIndex::open: Invalid file size. " << file;
+    NGTThrowException(msg);
+  }
+  void *addr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    stringstream msg;
+    msg << "NGT::MappedIndex::open: Cannot map the file. " << file;
+    NGTThrowException(msg);
+  }
+  base = static_cast<uint8_t*>(addr);
+  header = reinterpret_cast<Header*>(base);
+  mappedSize = st.st_size;
+  mappedFile = file;
+  mappedDevice = st.st_dev;
+  mappedInode = st.st_ino;
+  if (memcmp(header->magic, mappedIndexMagic, sizeof(header->magic)) != 0 ||
+      header->version != mappedIndexVersion || header->fileSize != mappedSize) {
+    close();
+    stringstream msg;
+    msg << "NGT::MappedIndex::open: Not a mapped index or an incompatible version. " << file;
+    NGTThrowException(msg);
+  }
+  comparator		= getComparator(static_cast<ObjectSpace::DistanceType>(header->distanceType),
+					static_cast<ObjectSpace::ObjectType>(header->objectType));
+  graphIndex		= reinterpret_cast<uint64_t*>(base + header->graphIndexOffset);
+  graphEdges		= reinterpret_cast<uint32_t*>(base + header->graphEdgeOffset);
+  internalChildren	= reinterpret_cast<uint32_t*>(base + header->internalChildrenOffset);
+  internalBorders	= reinterpret_cast<float*>(base + header->internalBordersOffset);
+  leafIndex		= reinterpret_cast<uint64_t*>(base + header->leafIndexOffset);
+  leafObjects		= reinterpret_cast<uint32_t*>(base + header->leafObjectOffset);
+}
+
+size_t
+MappedIndex::warmup(Index::WarmupMode mode, const string &queryFile, size_t querySize, float epsilon, size_t resultSize)
+{
+  int rss = NGT::Common::getProcessVmRSS();
+  switch (mode) {
+  case Index::WarmupModeSweep:
+    touchPages();
+    break;
+  case Index::WarmupModeQuery:
+    Index::replayQueries(*this, queryFile, querySize, epsilon, resultSize);
+    break;
+  default:
+    {
+      stringstream msg;
+      msg << "NGT::MappedIndex::warmup: Invalid warmup mode. " << mode;
+      NGTThrowException(msg);
+    }
+  }
+  int loaded = NGT::Common::getProcessVmRSS() - rss;
+  return loaded > 0 ? static_cast<size_t>(loaded) * 1024 : 0;
+}
+
+size_t
+MappedIndex::touchPages()
+{
+  checkOpen("touchPages");
+  // all of the sections are touched since they are contiguous in the file.
+  madvise(base, mappedSize, MADV_WILLNEED);
+  const size_t chunkSize = 1024 * 1024;
+  size_t numberOfChunks = (mappedSize + chunkSize - 1) / chunkSize;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t ci = 0; ci < numberOfChunks; ci++) {
+    size_t offset = ci * chunkSize;
+    MemoryCache::touch(base + offset, min(chunkSize, mappedSize - offset));
+  }
+  return mappedSize;
+}
+
+bool
+MappedIndex::isReplaced()
+{
+  if (header == 0) {
+    return false;
+  }
+  struct stat st;
+  if (stat(mappedFile.c_str(), &st) != 0) {
+    return false;
+  }
+  return st.st_dev != mappedDevice || st.st_ino != mappedInode;
+}
+
+void
+MappedIndex::close()
+{
+  if (header != 0) {
+    munmap(base, mappedSize);
+  }
+  header = 0;
+  base = 0;
+  mappedSize = 0;
+}
+
+MappedIndex::Comparator
+MappedIndex::getComparator(ObjectSpace::DistanceType dtype, ObjectSpace::ObjectType otype)
+{
+  switch (otype) {
+  case ObjectSpace::Uint8:
+    switch (dtype) {
+    case ObjectSpace::DistanceTypeHamming :	return PrimitiveComparator::HammingUint8::compare;
+    case ObjectSpace::DistanceTypeJaccard :	return PrimitiveComparator::JaccardUint8::compare;
+    case ObjectSpace::DistanceTypeL2 :		return PrimitiveComparator::L2Uint8::compare;
+    case ObjectSpace::DistanceTypeL1 :		return PrimitiveComparator::L1Uint8::compare;
+    default : break;
+    }
+    break;
+  case ObjectSpace::Float:
+    switch (dtype) {
+    case ObjectSpace::DistanceTypeNormalizedCosine :	return PrimitiveComparator::NormalizedCosineSimilarityFloat::compare;
+    case ObjectSpace::DistanceTypeCosine :		return PrimitiveComparator::CosineSimilarityFloat::compare;
+    case ObjectSpace::DistanceTypeNormalizedAngle :	return PrimitiveComparator::NormalizedAngleFloat::compare;
+    case ObjectSpace::DistanceTypeAngle :		return PrimitiveComparator::AngleFloat::compare;
+    case ObjectSpace::DistanceTypeNormalizedL2 :	return PrimitiveComparator::NormalizedL2Float::compare;
+    case ObjectSpace::DistanceTypeL2 :			return PrimitiveComparator::L2Float::compare;
+    case ObjectSpace::DistanceTypeL1 :			return PrimitiveComparator::L1Float::compare;
+    case ObjectSpace::DistanceTypePoincare :		return PrimitiveComparator::PoincareFloat::compare;
+    case ObjectSpace::DistanceTypeLorentz :		return PrimitiveComparator::LorentzFloat::compare;
+    default : break;
+    }
+    break;
+  default:
+    break;
+  }
+  stringstream msg;
+  msg << "NGT::MappedIndex::getComparator: Not supported distance or object type. " << dtype << ":" << otype;
+  NGTThrowException(msg);
+}
+
+Object *
+MappedIndex::allocateObject(const vector<float> &object)
+{
+  checkOpen("allocateObject");
+  return allocateObject(object, header->dimension, header->objectStride,
+			static_cast<ObjectSpace::ObjectType>(header->objectType),
+			static_cast<ObjectSpace::DistanceType>(header->distanceType));
+}
+
+Object *
+MappedIndex::allocateObject(const vector<float> &object, size_t dimension, size_t stride,
+			    ObjectSpace::ObjectType otype, ObjectSpace::DistanceType dtype)
+{
+  if (object.size() != dimension) {
+    stringstream msg;
+    msg << "NGT::MappedIndex::allocateObject: Invalid dimension. " << object.size() << ":" << dimension;
+    NGTThrowException(msg);
+  }
+  vector<float> v(object);
+  switch (dtype) {
+  case ObjectSpace::DistanceTypeNormalizedL2:
+  case ObjectSpace::DistanceTypeNormalizedAngle:
+  case ObjectSpace::DistanceTypeNormalizedCosine:
+    {
+      float sum = 0.0;
+      for (size_t i = 0; i < v.size(); i++) {
+	sum += v[i] * v[i];
+      }
+      if (sum == 0.0) {
+	NGTThrowException("NGT::MappedIndex::allocateObject: Error! the object is an invalid zero vector for the normalized distances.");
+      }
+      sum = sqrt(sum);
+      for (size_t i = 0; i < v.size(); i++) {
+	v[i] /= sum;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  Object *o = new Object(stride);
+  if (otype == ObjectSpace::Uint8) {
+    uint8_t *data = static_cast<uint8_t*>(o->getPointer());
+    for (size_t i = 0; i < v.size(); i++) {
+      data[i] = static_cast<uint8_t>(v[i]);
+    }
+  } else {
+    memcpy(o->getPointer(), v.data(), v.size() * sizeof(float));
+  }
+  return o;
+}
+
+Object *
+MappedIndex::allocateObject(const string &line, const string &sep)
+{
+  checkOpen("allocateObject");
+  vector<string> tokens;
+  NGT::Common::tokenize(line, tokens, sep);
+  if (header->dimension > tokens.size()) {
+    stringstream msg;
+    msg << "NGT::MappedIndex::allocateObject: too few dimension. " << tokens.size() << ":" << header->dimension << ". " << line;
+    NGTThrowException(msg);
+  }
+  vector<float> object(header->dimension);
+  for (size_t idx = 0; idx < header->dimension; idx++) {
+    object[idx] = NGT::Common::strtod(tokens[idx]);
+  }
+  return allocateObject(object);
+}
+
+size_t
+MappedIndex::getEdgeSize(NGT::SearchContainer &sc)
+{
+  int64_t esize = sc.edgeSize == -1 ? header->edgeSizeForSearch : sc.edgeSize;
+  size_t edgeSize = INT_MAX;
+  if (esize == 0) {
+    edgeSize = INT_MAX;
+  } else if (esize > 0) {
+    edgeSize = esize;
+  } else if (esize == -2) {
+    double add = pow(10, (sc.explorationCoefficient - 1.0) * static_cast<float>(header->dynamicEdgeSizeRate));
+    edgeSize = add >= static_cast<double>(INT_MAX) ? INT_MAX : header->dynamicEdgeSizeBase + add;
+  } else {
+    stringstream msg;
+    msg << "NGT::MappedIndex::getEdgeSize: Invalid edge size parameters " << sc.edgeSize << ":" << header->edgeSizeForSearch;
+    NGTThrowException(msg);
+  }
+  return edgeSize;
+}
+
+void
+MappedIndex::getSeedsFromTree(NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  // descend the tree in the same way as DVPTree::search with SearchLeaf and zero radius.
+  Node::ID nodeID;
+  nodeID.setRaw(header->rootNodeID);
+  const size_t csize = header->childrenSize;
+  const void *query = &sc.object[0];
+  while (nodeID.getType() == Node::ID::Internal) {
+    Node::NodeID nid = nodeID.getID();
+    Distance d = (*comparator)(query, getPivotAddress(nid), header->paddedDimension);
+#ifdef NGT_DISTANCE_COMPUTATION_COUNT
+    sc.distanceComputationCount++;
+#endif
+    float *borders = &internalBorders[nid * (csize - 1)];
+    size_t mid;
+    for (mid = 0; mid < csize - 1; mid++) {
+      if (d < borders[mid]) {
+	break;
+      }
+    }
+    nodeID.setRaw(internalChildren[nid * csize + mid]);
+  }
+  Node::NodeID leafID = nodeID.getID();
+  for (uint64_t i = leafIndex[leafID]; i < leafIndex[leafID + 1]; i++) {
+    seeds.push_back(ObjectDistance(leafObjects[i], 0.0));
+  }
+  if (sc.useAllNodesInLeaf || header->seedType == NeighborhoodGraph::SeedTypeAllLeafNodes) {
+    return;
+  }
+  size_t seedSize = header->seedSize == 0 ? sc.size : header->seedSize;
+  seedSize = seedSize > sc.size ? sc.size : seedSize;
+  if (seeds.size() > seedSize) {
+    srand(leafID);
+    for (size_t i = seeds.size(); i > seedSize; i--) {
+      double random = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+      size_t idx = floor(i * random);
+      seeds[idx] = seeds[i - 1];
+    }
+    seeds.resize(seedSize);
+  }
+}
+
+void
+MappedIndex::getSeedsFromGraph(ObjectDistances &seeds)
+{
+  if (header->numberOfObjects <= 1) {
+    return;
+  }
+  size_t repositorySize = header->numberOfObjects - 1;
+  size_t seedSize = repositorySize < static_cast<size_t>(header->seedSize) ? repositorySize : header->seedSize;
+  if (header->seedType == NeighborhoodGraph::SeedTypeFixedNodes) {
+    for (size_t i = 1; i <= seedSize; i++) {
+      seeds.push_back(ObjectDistance(i, 0.0));
+    }
+  } else if (header->seedType == NeighborhoodGraph::SeedTypeFirstNode) {
+    seeds.push_back(ObjectDistance(1, 0.0));
+  } else {
+    size_t emptyCount = 0;
+    while (seedSize > seeds.size()) {
+      double random = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+      size_t idx = floor(repositorySize * random) + 1;
+      if (graphIndex[idx] == graphIndex[idx + 1]) {
+	// removed objects have no edges.
+	if (++emptyCount > repositorySize) {
+	  break;
+	}
+	continue;
+      }
+      ObjectDistance obj(idx, 0.0);
+      if (find(seeds.begin(), seeds.end(), obj) != seeds.end()) {
+	continue;
+      }
+      seeds.push_back(obj);
+    }
+  }
+}
+
+void
+MappedIndex::search(NGT::SearchContainer &sc)
+{
+  checkOpen("search");
+  sc.distanceComputationCount = 0;
+  sc.visitCount = 0;
+  ObjectDistances seeds;
+  if (header->rootNodeID != 0) {
+    getSeedsFromTree(sc, seeds);
+  }
+  search(sc, seeds);
+}
+
+void
+MappedIndex::searchUsingOnlyGraph(NGT::SearchContainer &sc)
+{
+  checkOpen("searchUsingOnlyGraph");
+  sc.distanceComputationCount = 0;
+  sc.visitCount = 0;
+  ObjectDistances seeds;
+  search(sc, seeds);
+}
+
+void
+MappedIndex::search(NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  checkOpen("search");
+  if (sc.size == 0) {
+    while (!sc.workingResult.empty()) sc.workingResult.pop();
+    return;
+  }
+  if (seeds.size() == 0) {
+    getSeedsFromGraph(seeds);
+  }
+  if (sc.expectedAccuracy > 0.0) {
+    NGTThrowException("NGT::MappedIndex::search: The expected accuracy is not supported for mapped indexes. Specify epsilon instead.");
+  }
+  NGT::SearchContainer so(sc);
+  if (header->numberOfObjects < 5000000) {
+    searchGraph<NeighborhoodGraph::BooleanVector>(so, seeds);
+  } else {
+    searchGraph<HashBasedBooleanSet>(so, seeds);
+  }
+  sc.workingResult = std::move(so.workingResult);
+  sc.distanceComputationCount = so.distanceComputationCount;
+  sc.visitCount = so.visitCount;
+}
+
+template <typename CHECK_LIST>
+void
+MappedIndex::searchGraph(NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  if (sc.explorationCoefficient == 0.0) {
+    sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
+  }
+  size_t edgeSize = getEdgeSize(sc);
+  const size_t dimension = header->paddedDimension;
+  const size_t prefetchSize = header->prefetchSize;
+  const size_t prefetchOffset = header->prefetchOffset;
+  const void *query = &sc.object[0];
+
+  std::priority_queue<ObjectDistance, std::vector<ObjectDistance>, std::greater<ObjectDistance> > unchecked;
+  CHECK_LIST distanceChecked(header->numberOfObjects);
+  ResultPriorityQueue results;
+
+  for (size_t i = 0; i < seeds.size(); i++) {
+    if (i + prefetchOffset < seeds.size()) {
+      MemoryCache::prefetch(getObjectAddress(seeds[i + prefetchOffset].id), prefetchSize);
+    }
+    seeds[i].distance = (*comparator)(query, getObjectAddress(seeds[i].id), dimension);
+#ifdef NGT_DISTANCE_COMPUTATION_COUNT
+    sc.distanceComputationCount++;
+#endif
+  }
+  std::sort(seeds.begin(), seeds.end());
+  for (ObjectDistances::iterator ri = seeds.begin(); ri != seeds.end(); ri++) {
+    if ((results.size() < (unsigned int)sc.size) && ((*ri).distance <= sc.radius)) {
+      results.push((*ri));
+    } else {
+      break;
+    }
+  }
+  if (results.size() >= sc.size) {
+    sc.radius = results.top().distance;
+  }
+  for (ObjectDistances::iterator ri = seeds.begin(); ri != seeds.end(); ri++) {
+    distanceChecked.insert((*ri).id);
+    unchecked.push(*ri);
+  }
+
+  Distance explorationRadius = sc.explorationCoefficient * sc.radius;
+  vector<uint32_t> neighbors;
+  ObjectDistance result;
+  while (!unchecked.empty()) {
+    ObjectDistance target = unchecked.top();
+    unchecked.pop();
+    if (target.distance > explorationRadius) {
+      break;
+    }
+    uint32_t *neighborptr = &graphEdges[graphIndex[target.id]];
+    size_t neighborSize = graphIndex[target.id + 1] - graphIndex[target.id];
+    neighborSize = neighborSize < edgeSize ? neighborSize : edgeSize;
+    neighbors.clear();
+    for (size_t i = 0; i < neighborSize; i++) {
+      if (!distanceChecked[neighborptr[i]]) {
+	if (neighbors.size() < prefetchOffset) {
+	  MemoryCache::prefetch(getObjectAddress(neighborptr[i]), prefetchSize);
+	}
+	neighbors.push_back(neighborptr[i]);
+      }
+    }
+    for (size_t idx = 0; idx < neighbors.size(); idx++) {
+      if (idx + prefetchOffset < neighbors.size()) {
+	MemoryCache::prefetch(getObjectAddress(neighbors[idx + prefetchOffset]), prefetchSize);
+      }
+#ifdef NGT_VISIT_COUNT
+      sc.visitCount++;
+#endif
+      ObjectID nid = neighbors[idx];
+      distanceChecked.insert(nid);
+#ifdef NGT_DISTANCE_COMPUTATION_COUNT
+      sc.distanceComputationCount++;
+#endif
+      Distance distance = (*comparator)(query, getObjectAddress(nid), dimension);
+      if (distance <= explorationRadius) {
+	result.set(nid, distance);
+	unchecked.push(result);
+	if (distance <= sc.radius) {
+	  results.push(result);
+	  if (results.size() >= sc.size) {
+	    if (results.size() > sc.size) {
+	      results.pop();
+	    }
+	    sc.radius = results.top().distance;
+	    explorationRadius = sc.explorationCoefficient * sc.radius;
+	  }
+	}
+      }
+    }
+  }
+
+  if (sc.resultIsAvailable()) {
+    ObjectDistances &qresults = sc.getResult();
+    qresults.moveFrom(results);
+  } else {
+    sc.workingResult = std::move(results);
+  }
+}
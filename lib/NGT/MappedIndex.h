@@ -0,0 +1,149 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<sys/types.h>
+
+#include	"NGT/Index.h"
+
+namespace NGT {
+
+  // A read-only image of an index which is searched directly on the memory-mapped file.
+  // The file consists of a header followed by the following sections.
+  //   objects          : padded objects with a fixed 64-byte aligned stride. removed objects are zero-filled.
+  //   graph            : CSR layout. offsets (uint64 x (# of objects + 1)) and neighbor IDs (uint32).
+  //   internal nodes   : children raw node IDs (uint32 x children size) and borders (float x (children size - 1)).
+  //   pivots           : pivots of the internal nodes with the same stride as the objects.
+  //   leaf nodes       : CSR layout. offsets (uint64 x (# of leaves + 1)) and object IDs (uint32).
+  // The tree sections are empty for a graph-only index.
+  // Since the file is mapped with PROT_READ and MAP_SHARED and never modified, any number of processes can
+  // search one image without locking, sharing the pages in the page cache.
+  class MappedIndex {
+  public:
+    class Header {
+    public:
+      char	magic[8];
+      uint64_t	version;
+      uint64_t	objectType;
+      uint64_t	distanceType;
+      uint64_t	dimension;
+      uint64_t	paddedDimension;
+      uint64_t	objectStride;
+      uint64_t	numberOfObjects;
+      uint64_t	objectOffset;
+      uint64_t	graphIndexOffset;
+      uint64_t	graphEdgeOffset;
+      uint64_t	numberOfEdges;
+      int64_t	edgeSizeForSearch;
+      int64_t	seedType;
+      int64_t	seedSize;
+      int64_t	dynamicEdgeSizeBase;
+      int64_t	dynamicEdgeSizeRate;
+      uint64_t	prefetchOffset;
+      uint64_t	prefetchSize;
+      uint64_t	rootNodeID;
+      uint64_t	childrenSize;
+      uint64_t	numberOfInternalNodes;
+      uint64_t	numberOfLeafNodes;
+      uint64_t	numberOfLeafObjects;
+      uint64_t	internalChildrenOffset;
+      uint64_t	internalBordersOffset;
+      uint64_t	pivotOffset;
+      uint64_t	leafIndexOffset;
+      uint64_t	leafObjectOffset;
+      uint64_t	fileSize;
+    };
+
+    typedef double (*Comparator)(const void*, const void*, size_t);
+
+    MappedIndex():header(0), mappedSize(0) {}
+    MappedIndex(const std::string &database):header(0), mappedSize(0) { open(database); }
+    ~MappedIndex() { close(); }
+
+    void open(const std::string &database);
+    void close();
+    bool isOpen() { return header != 0; }
+    // Returns true if the image was exported again after it was opened. Reopen it to search the new image.
+    bool isReplaced();
+
+    static void build(NGT::Index &index, const std::string &file);
+    static void build(const std::string &database);
+    static std::string getFileName(const std::string &database) { return database + "/mapped"; }
+
+    Object *allocateObject(const std::vector<float> &object);
+    // Allocate a query object in the layout of the objects in the images. The object is normalized for the normalized distances.
+    static Object *allocateObject(const std::vector<float> &object, size_t dimension, size_t stride,
+				  ObjectSpace::ObjectType otype, ObjectSpace::DistanceType dtype);
+    Object *allocateObject(const std::string &line, const std::string &sep);
+    void deleteObject(Object *object) { delete object; }
+
+    void search(NGT::SearchContainer &sc);
+    void searchUsingOnlyGraph(NGT::SearchContainer &sc);
+    void search(NGT::SearchContainer &sc, ObjectDistances &seeds);
+
+    // Returns the increase of the resident memory size in bytes. See NGT::Index::warmup.
+    size_t warmup(Index::WarmupMode mode = Index::WarmupModeSweep, const std::string &queryFile = "", size_t querySize = 0,
+		  float epsilon = 0.1, size_t resultSize = 20);
+    size_t touchPages();
+
+    void *getObject(ObjectID id) {
+      checkOpen("getObject");
+      if (id == 0 || id >= header->numberOfObjects) {
+	std::stringstream msg;
+	msg << "NGT::MappedIndex::getObject: The specified ID is out of the range. " << id << ":" << header->numberOfObjects;
+	NGTThrowException(msg);
+      }
+      return getObjectAddress(id);
+    }
+    size_t getNumberOfObjects() {
+      checkOpen("getNumberOfObjects");
+      return header->numberOfObjects == 0 ? 0 : header->numberOfObjects - 1;
+    }
+    size_t getDimension() { checkOpen("getDimension"); return header->dimension; }
+    Header &getHeader() { checkOpen("getHeader"); return *header; }
+
+    static Comparator getComparator(ObjectSpace::DistanceType dtype, ObjectSpace::ObjectType otype);
+
+  protected:
+    void checkOpen(const std::string &method) {
+      if (header == 0) {
+	NGTThrowException("NGT::MappedIndex::" + method + ": The index is not open.");
+      }
+    }
+    uint8_t *getObjectAddress(ObjectID id) { return base + header->objectOffset + header->objectStride * id; }
+    uint8_t *getPivotAddress(uint32_t id) { return base + header->pivotOffset + header->objectStride * id; }
+    size_t getEdgeSize(NGT::SearchContainer &sc);
+    void getSeedsFromTree(NGT::SearchContainer &sc, ObjectDistances &seeds);
+    void getSeedsFromGraph(ObjectDistances &seeds);
+    template <typename CHECK_LIST> void searchGraph(NGT::SearchContainer &sc, ObjectDistances &seeds);
+
+    Header	*header;
+    uint8_t	*base;
+    size_t	mappedSize;
+    std::string	mappedFile;
+    dev_t	mappedDevice;
+    ino_t	mappedInode;
+    Comparator	comparator;
+    uint64_t	*graphIndex;
+    uint32_t	*graphEdges;
+    uint32_t	*internalChildren;
+    float	*internalBorders;
+    uint64_t	*leafIndex;
+    uint32_t	*leafObjects;
+  };
+
+} // namespace NGT
@@ -23,6 +23,14 @@ namespace MemoryManager{
     optionst.use_expand = MMAP_DEFAULT_ALLOW_EXPAND;
     optionst.reuse_type = REUSE_DATA_CLASSIFY;
   }
+
+  void MmapManager::setDefaultOpenOptionValue(open_option_st &optionst)
+  {
+    optionst.use_hugepage = false;
+    optionst.populate = false;
+    optionst.numa_policy = NUMA_POLICY_NONE;
+    optionst.numa_node = -1;
+  }
   
   size_t MmapManager::getAlignSize(size_t size){
     if((size % MMAP_MEMORY_ALIGN) == 0){
@@ -129,7 +137,7 @@ namespace MemoryManager{
     }
   }
 
-  bool MmapManager::openMemory(const std::string &filePath)
+  bool MmapManager::openMemory(const std::string &filePath, const open_option_st *optionst)
   {
     try{
       if(_impl->isOpen == true){
@@ -139,6 +147,9 @@ namespace MemoryManager{
       
       const std::string controlFile = filePath + MMAP_CNTL_FILE_SUFFIX;
       _impl->filePath = filePath; 
+      if(optionst != NULL){
+        _impl->openOption = *optionst;
+      }
       
       int32_t fd;
       
@@ -171,6 +182,15 @@ namespace MemoryManager{
         if(munmap(boot_p, MMAP_CNTL_FILE_SIZE) == -1) throw MmapManagerException("munmap error : " + getErrorStr(errno));
         throw MmapManagerException("file open error = " + std::string(filePath.c_str())  + err_str);
       }
+
+      try{
+        _impl->checkAdviceAvailable(fd);
+      }catch(MmapManagerException &e){
+        if(close(fd) == -1) std::cerr << filePath << "[WARN] : filedescript cannot close" << std::endl;
+        errno = 0;
+        if(munmap(boot_p, MMAP_CNTL_FILE_SIZE) == -1) throw MmapManagerException("munmap error : " + getErrorStr(errno));
+        throw e;
+      }
       
       _impl->mmapCntlHead = (control_st*)( (char *)boot_p + sizeof(boot_st)); 
       _impl->mmapCntlAddr = (void *)boot_p;
@@ -178,7 +198,7 @@ namespace MemoryManager{
       for(uint64_t i = 0; i < _impl->mmapCntlHead->unit_num; i++){
         off_t offset = _impl->mmapCntlHead->base_size * i;
         errno = 0;
-        _impl->mmapDataAddr[i] = mmap(NULL, _impl->mmapCntlHead->base_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+        _impl->mmapDataAddr[i] = mmap(NULL, _impl->mmapCntlHead->base_size, PROT_READ | PROT_WRITE, _impl->getMapFlags(), fd, offset);
         if(_impl->mmapDataAddr[i] == MAP_FAILED){
 	  if (errno == EINVAL) {
 	    std::cerr << "MmapManager::openMemory: Fatal error. EINVAL" << std::endl
@@ -191,6 +211,7 @@ namespace MemoryManager{
           closeMemory(true); 
           throw MmapManagerException(err_str);
         }
+        _impl->adviseUnit(_impl->mmapDataAddr[i], _impl->mmapCntlHead->base_size, i);
       }
       if(close(fd) == -1) std::cerr << controlFile << "[WARN] : filedescript cannot close" << std::endl;
       
@@ -51,6 +51,19 @@ namespace MemoryManager{
     option_reuse_t reuse_type; 
   }init_option_st;
 
+  typedef enum _option_numa_t{
+    NUMA_POLICY_NONE,
+    NUMA_POLICY_INTERLEAVE,	// interleave the pages of each unit across all online nodes
+    NUMA_POLICY_BIND,		// bind each unit to the specified node, or to the nodes in turn if the node is negative
+  }option_numa_t;
+
+  typedef struct _open_option_st{
+    bool use_hugepage;		// madvise(MADV_HUGEPAGE)
+    bool populate;		// MAP_POPULATE and madvise(MADV_WILLNEED)
+    option_numa_t numa_policy;
+    int32_t numa_node;
+  }open_option_st;
+
 
   class MmapManager{
   public:
@@ -58,7 +71,7 @@ namespace MemoryManager{
     ~MmapManager();
         
     bool init(const std::string &filePath, size_t size, const init_option_st *optionst = NULL) const;
-    bool openMemory(const std::string &filePath);
+    bool openMemory(const std::string &filePath, const open_option_st *optionst = NULL);
     void closeMemory(const bool force = false);
     off_t alloc(const size_t size, const bool not_reuse_flag = false);
     void free(const off_t p);
@@ -84,6 +97,7 @@ namespace MemoryManager{
 
     // static method --- 
     static void setDefaultOptionValue(init_option_st &optionst);
+    static void setDefaultOpenOptionValue(open_option_st &optionst);
     static size_t getAlignSize(size_t size);
 
   private:
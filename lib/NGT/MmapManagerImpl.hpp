@@ -27,6 +27,21 @@
 #include <sstream>
 #include <cstring>
 #include <cassert>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#ifdef __linux__
+#include <linux/magic.h>
+#endif
+
+#ifndef MPOL_BIND
+#define MPOL_BIND		2
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE		3
+#endif
 
 namespace MemoryManager{
   
@@ -42,6 +57,7 @@ namespace MemoryManager{
     control_st *mmapCntlHead;
     std::string filePath;         
     void *mmapDataAddr[MMAP_MAX_UNIT_NUM];
+    open_option_st openOption;
 
     void initBootStruct(boot_st &bst, size_t size) const;
     void initFreeStruct(free_st &fst) const;
@@ -50,6 +66,10 @@ namespace MemoryManager{
 
     void setupChunkHead(chunk_head_st *chunk_head, const bool delete_flg, const uint16_t unit_id, const off_t free_next, const size_t size) const;
     bool expandMemory();
+    int getMapFlags() const;
+    void adviseUnit(void *addr, size_t size, uint16_t unit_id) const;
+    void checkAdviceAvailable(int32_t fd) const;
+    static std::vector<int32_t> getOnlineNumaNodes();
     int32_t formatFile(const std::string &targetFile, size_t size) const;
     void clearChunk(const off_t chunk_off) const;
 
@@ -73,7 +93,116 @@ namespace MemoryManager{
   };
 
 
-  MmapManager::Impl::Impl(MmapManager &ommanager):mmanager(ommanager), isOpen(false), mmapCntlAddr(NULL), mmapCntlHead(NULL){}
+  MmapManager::Impl::Impl(MmapManager &ommanager):mmanager(ommanager), isOpen(false), mmapCntlAddr(NULL), mmapCntlHead(NULL){
+    MmapManager::setDefaultOpenOptionValue(openOption);
+  }
+
+  int MmapManager::Impl::getMapFlags() const
+  {
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    // the pages should be faulted in after the NUMA policy is applied.
+    if(openOption.populate && openOption.numa_policy == NUMA_POLICY_NONE){
+      flags |= MAP_POPULATE;
+    }
+#endif
+    return flags;
+  }
+
+  // the kernel ignores the memory policy for the page cache of regular files and backs only shmem
+  // with transparent huge pages, so these options are rejected unless the file is on tmpfs or hugetlbfs.
+  void MmapManager::Impl::checkAdviceAvailable(int32_t fd) const
+  {
+    if(!openOption.use_hugepage && openOption.numa_policy == NUMA_POLICY_NONE){
+      return;
+    }
+#if defined(__linux__) && defined(TMPFS_MAGIC) && defined(HUGETLBFS_MAGIC)
+    struct statfs st;
+    errno = 0;
+    if(fstatfs(fd, &st) == -1){
+      throw MmapManagerException(filePath + " fstatfs error. " + getErrorStr(errno));
+    }
+    if(static_cast<unsigned long>(st.f_type) == TMPFS_MAGIC || static_cast<unsigned long>(st.f_type) == HUGETLBFS_MAGIC){
+      return;
+    }
+#endif
+    throw MmapManagerException(filePath + " : The huge page and NUMA options are available only for the files on tmpfs or hugetlbfs.");
+  }
+
+  void MmapManager::Impl::adviseUnit(void *addr, size_t size, uint16_t unit_id) const
+  {
+    if(openOption.use_hugepage){
+#ifdef MADV_HUGEPAGE
+      errno = 0;
+      if(madvise(addr, size, MADV_HUGEPAGE) == -1){
+        std::cerr << filePath << "[WARN] : madvise(MADV_HUGEPAGE) error. " << getErrorStr(errno) << std::endl;
+      }
+#else
+      std::cerr << filePath << "[WARN] : MADV_HUGEPAGE is not available." << std::endl;
+#endif
+    }
+    if(openOption.numa_policy != NUMA_POLICY_NONE){
+#ifdef SYS_mbind
+      const size_t maxNode = 1024;
+      unsigned long mask[maxNode / (sizeof(unsigned long) * 8)] = {0};
+      std::vector<int32_t> nodes = getOnlineNumaNodes();
+      int mode = MPOL_INTERLEAVE;
+      if(openOption.numa_policy == NUMA_POLICY_BIND){
+        mode = MPOL_BIND;
+        int32_t node = openOption.numa_node >= 0 ? openOption.numa_node : nodes[unit_id % nodes.size()];
+        nodes.assign(1, node);
+      }
+      for(size_t i = 0; i < nodes.size(); i++){
+        if(nodes[i] >= 0 && static_cast<size_t>(nodes[i]) < maxNode){
+          mask[nodes[i] / (sizeof(unsigned long) * 8)] |= 1UL << (nodes[i] % (sizeof(unsigned long) * 8));
+        }
+      }
+      errno = 0;
+      if(syscall(SYS_mbind, addr, size, mode, mask, maxNode, 0) == -1){
+        std::cerr << filePath << "[WARN] : mbind error. " << getErrorStr(errno) << std::endl;
+      }
+#else
+      std::cerr << filePath << "[WARN] : mbind is not available." << std::endl;
+#endif
+    }
+    if(openOption.populate){
+      errno = 0;
+      if(madvise(addr, size, MADV_WILLNEED) == -1){
+        std::cerr << filePath << "[WARN] : madvise(MADV_WILLNEED) error. " << getErrorStr(errno) << std::endl;
+      }
+    }
+  }
+
+  std::vector<int32_t> MmapManager::Impl::getOnlineNumaNodes()
+  {
+    // the format of the file is a list of ranges such as "0-3,6".
+    std::vector<int32_t> nodes;
+    std::ifstream ifs("/sys/devices/system/node/online");
+    std::string ranges;
+    if(ifs && std::getline(ifs, ranges)){
+      std::stringstream ss(ranges);
+      std::string range;
+      while(std::getline(ss, range, ',')){
+        int32_t first = 0, last = 0;
+        char c;
+        std::stringstream rs(range);
+        if(!(rs >> first)){
+          continue;
+        }
+        last = first;
+        if(rs >> c && c == '-'){
+          rs >> last;
+        }
+        for(int32_t n = first; n <= last; n++){
+          nodes.push_back(n);
+        }
+      }
+    }
+    if(nodes.empty()){
+      nodes.push_back(0);
+    }
+    return nodes;
+  }
   
   
   void MmapManager::Impl::initBootStruct(boot_st &bst, size_t size) const 
@@ -141,7 +270,7 @@ namespace MemoryManager{
 
     const off_t offset = mmapCntlHead->base_size * mmapCntlHead->unit_num;
     errno = 0;
-    void *new_area = mmap(NULL, mmapCntlHead->base_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    void *new_area = mmap(NULL, mmapCntlHead->base_size, PROT_READ | PROT_WRITE, getMapFlags(), fd, offset);
     if(new_area == MAP_FAILED){
       const std::string err_str = getErrorStr(errno);
       
@@ -157,6 +286,7 @@ namespace MemoryManager{
     if(close(fd) == -1) std::cerr << filePath << "[WARN] : filedescript cannot close" << std::endl;
     
     mmapDataAddr[mmapCntlHead->unit_num] = new_area;
+    adviseUnit(new_area, mmapCntlHead->base_size, mmapCntlHead->unit_num);
     
     mmapCntlHead->unit_num = new_unit_num;
     mmapCntlHead->active_unit++;
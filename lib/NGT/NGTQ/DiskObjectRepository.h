@@ -0,0 +1,254 @@
+//
+// Copyright (C) 2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<fcntl.h>
+#include	<cerrno>
+#include	<unistd.h>
+#include	<list>
+#include	<mutex>
+#include	<unordered_map>
+
+#include	"NGT/Index.h"
+
+namespace NGTQG {
+
+  // The full-precision objects of the quantized graph on the disk. The objects are read only for the final
+  // re-ranking of the search, so that the objects do not have to reside in the memory.
+  // The file consists of the following.
+  //   header  : magic, object size, # of objects, stride, # of objects per block (uint64 x 5),
+  //             which is padded to the data offset.
+  //   objects : the objects of all of the IDs, each of which is padded to the stride.
+  // The objects are read by the block which consists of the objects of the consecutive IDs, and the blocks
+  // are kept in an LRU cache.
+  class DiskObjectRepository {
+  public:
+    static const uint64_t	magic = 0x314a424f4454474eULL;	// "NGTDOBJ1"
+    static const size_t		dataOffset = 4096;
+    static const size_t		blockSize = 4096;
+    static const size_t		alignment = 64;
+    static const size_t		maxRunSize = 32;	// the max # of the consecutive blocks in one read.
+    static const size_t		defaultCacheSize = 64 * 1024 * 1024;
+
+    class Header {
+    public:
+      uint64_t	magic;
+      uint64_t	objectSize;
+      uint64_t	size;
+      uint64_t	stride;
+      uint64_t	objectsPerBlock;
+    };
+
+    DiskObjectRepository():fd(-1), cacheCapacity(0), readCount(0), hitCount(0) {
+      memset(&header, 0, sizeof(header));
+    }
+    ~DiskObjectRepository() { close(); }
+
+    static std::string getFileName(const std::string &indexPath) { return indexPath + "/qg/dobj"; }
+
+    // Write all of the objects of the object space to the file. Removed objects are filled with zeros.
+    static void build(const std::string &file, NGT::ObjectSpace &objectSpace) {
+      NGT::ObjectRepository &objectRepository = objectSpace.getRepository();
+      Header h;
+      h.magic = magic;
+      h.objectSize = objectSpace.getByteSizeOfObject();
+      h.size = objectRepository.size();
+      h.stride = (h.objectSize + alignment - 1) / alignment * alignment;
+      h.objectsPerBlock = std::max(static_cast<size_t>(1), blockSize / h.stride);
+      std::stringstream tmp;
+      tmp << file << "." << getpid();
+      std::ofstream os(tmp.str(), std::ios::binary | std::ios::trunc);
+      if (!os.is_open()) {
+	std::stringstream msg;
+	msg << "NGTQG::DiskObjectRepository::build: Cannot open. " << tmp.str();
+	NGTThrowException(msg);
+      }
+      std::vector<char> record(std::max(static_cast<size_t>(dataOffset), static_cast<size_t>(h.stride)), 0);
+      memcpy(record.data(), &h, sizeof(h));
+      os.write(record.data(), dataOffset);
+      size_t paddedSize = (h.size + h.objectsPerBlock - 1) / h.objectsPerBlock * h.objectsPerBlock;
+      for (size_t id = 0; id < paddedSize; id++) {
+	memset(record.data(), 0, h.stride);
+	if (id < h.size && !objectRepository.isEmpty(id)) {
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	  memcpy(record.data(), objectRepository.get(id)->getPointer(0, objectRepository.getAllocator()), h.objectSize);
+#else
+	  memcpy(record.data(), &(*objectRepository.get(id))[0], h.objectSize);
+#endif
+	}
+	os.write(record.data(), h.stride);
+      }
+      os.close();
+      if (!os || std::rename(tmp.str().c_str(), file.c_str()) != 0) {
+	std::remove(tmp.str().c_str());
+	std::stringstream msg;
+	msg << "NGTQG::DiskObjectRepository::build: Cannot write. " << file;
+	NGTThrowException(msg);
+      }
+    }
+
+    // The cache size is specified in bytes.
+    void open(const std::string &file, size_t cacheSize = defaultCacheSize) {
+      close();
+      fd = ::open(file.c_str(), O_RDONLY);
+      if (fd < 0) {
+	std::stringstream msg;
+	msg << "NGTQG::DiskObjectRepository::open: Cannot open. " << file;
+	NGTThrowException(msg);
+      }
+      if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+	  header.magic != magic || header.stride < header.objectSize || header.objectsPerBlock == 0) {
+	close();
+	std::stringstream msg;
+	msg << "NGTQG::DiskObjectRepository::open: Invalid file. " << file;
+	NGTThrowException(msg);
+      }
+      cacheCapacity = cacheSize / getBlockSize();
+    }
+
+    void close() {
+      if (fd >= 0) {
+	::close(fd);
+	fd = -1;
+      }
+      cache.clear();
+      lru.clear();
+      memset(&header, 0, sizeof(header));
+    }
+
+    bool isOpen() { return fd >= 0; }
+
+    // Read the objects of the specified IDs into the buffer in the order of the IDs. The blocks which are not
+    // in the cache are read at once after the read-ahead of all of them is requested, and the consecutive
+    // blocks are read by one pread.
+    void get(const std::vector<NGT::ObjectID> &ids, std::vector<uint8_t> &objects) {
+      size_t objectSize = header.objectSize;
+      objects.resize(ids.size() * objectSize);
+      std::vector<size_t> missed;
+      {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (size_t i = 0; i < ids.size(); i++) {
+	  if (ids[i] >= header.size) {
+	    std::stringstream msg;
+	    msg << "NGTQG::DiskObjectRepository::get: Invalid ID. " << ids[i] << ":" << header.size;
+	    NGTThrowException(msg);
+	  }
+	  auto entry = cache.find(ids[i] / header.objectsPerBlock);
+	  if (entry == cache.end()) {
+	    missed.push_back(ids[i] / header.objectsPerBlock);
+	    continue;
+	  }
+	  lru.splice(lru.begin(), lru, (*entry).second.position);
+	  memcpy(&objects[i * objectSize], getObject((*entry).second.data, ids[i]), objectSize);
+	  hitCount++;
+	}
+      }
+      if (missed.empty()) {
+	return;
+      }
+      std::sort(missed.begin(), missed.end());
+      missed.erase(std::unique(missed.begin(), missed.end()), missed.end());
+      size_t bsize = getBlockSize();
+      std::vector<uint8_t> blocks(missed.size() * bsize);
+      std::vector<std::pair<size_t, size_t>> runs;
+      for (size_t bi = 0; bi < missed.size(); bi++) {
+	if (!runs.empty() && missed[bi - 1] + 1 == missed[bi] && runs.back().second < maxRunSize) {
+	  runs.back().second++;
+	} else {
+	  runs.push_back(std::make_pair(bi, 1));
+	}
+      }
+#ifdef POSIX_FADV_WILLNEED
+      if (runs.size() > 1) {
+	for (auto r = runs.begin(); r != runs.end(); ++r) {
+	  posix_fadvise(fd, getOffset(missed[(*r).first]), (*r).second * bsize, POSIX_FADV_WILLNEED);
+	}
+      }
+#endif
+      for (auto r = runs.begin(); r != runs.end(); ++r) {
+	read(&blocks[(*r).first * bsize], (*r).second * bsize, getOffset(missed[(*r).first]));
+      }
+      for (size_t i = 0; i < ids.size(); i++) {
+	size_t block = ids[i] / header.objectsPerBlock;
+	auto bi = std::lower_bound(missed.begin(), missed.end(), block);
+	if (bi == missed.end() || *bi != block) {
+	  continue;
+	}
+	memcpy(&objects[i * objectSize], getObject(&blocks[std::distance(missed.begin(), bi) * bsize], ids[i]), objectSize);
+      }
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      readCount += missed.size();
+      for (size_t bi = 0; bi < missed.size() && cacheCapacity > 0; bi++) {
+	if (cache.find(missed[bi]) != cache.end()) {
+	  continue;
+	}
+	if (cache.size() >= cacheCapacity) {
+	  cache.erase(lru.back());
+	  lru.pop_back();
+	}
+	lru.push_front(missed[bi]);
+	Block &b = cache[missed[bi]];
+	b.position = lru.begin();
+	b.data.assign(blocks.begin() + bi * bsize, blocks.begin() + (bi + 1) * bsize);
+      }
+    }
+
+    size_t size() { return header.size; }
+    size_t getObjectSize() { return header.objectSize; }
+    size_t getBlockSize() { return header.objectsPerBlock * header.stride; }
+    size_t getReadCount() { return readCount; }
+    size_t getHitCount() { return hitCount; }
+
+  protected:
+    class Block {
+    public:
+      std::list<size_t>::iterator	position;
+      std::vector<uint8_t>		data;
+    };
+
+    uint8_t *getObject(std::vector<uint8_t> &block, NGT::ObjectID id) { return getObject(block.data(), id); }
+    uint8_t *getObject(uint8_t *block, NGT::ObjectID id) { return block + (id % header.objectsPerBlock) * header.stride; }
+    off_t getOffset(size_t block) { return dataOffset + block * getBlockSize(); }
+
+    void read(uint8_t *buffer, size_t size, off_t offset) {
+      while (size > 0) {
+	ssize_t s = pread(fd, buffer, size, offset);
+	if (s < 0 && errno == EINTR) {
+	  continue;
+	}
+	if (s <= 0) {
+	  std::stringstream msg;
+	  msg << "NGTQG::DiskObjectRepository::read: Cannot read. offset=" << offset << " size=" << size;
+	  NGTThrowException(msg);
+	}
+	buffer += s;
+	size -= s;
+	offset += s;
+      }
+    }
+
+    int						fd;
+    Header					header;
+    size_t					cacheCapacity;	// the max # of the cached blocks.
+    std::mutex					cacheMutex;
+    std::list<size_t>				lru;
+    std::unordered_map<size_t, Block>		cache;
+    size_t					readCount;	// the # of the read blocks.
+    size_t					hitCount;	// the # of the objects found in the cache.
+  };
+
+}
@@ -36,6 +36,7 @@ public:
       try {
 	objectPath = args.get("#2");
       } catch (...) {}
+      objectFormat = args.getString("F", "");
 
       char objectType = args.getChar("o", 'f');
       char distanceType = args.getChar("D", '2');
@@ -50,6 +51,18 @@ public:
       property.localDivisionNo = args.getl("N", 8);
       property.batchSize = args.getl("b", 1000);
       property.localClusteringSampleCoefficient = args.getl("s", 10);
+      {
+	char rotationType = args.getChar("O", 'n');
+	switch (rotationType) {
+	case 'n': property.rotationType = NGTQ::RotationTypeNone; break;
+	case 'p': property.rotationType = NGTQ::RotationTypePermutation; break;
+	case 'r': property.rotationType = NGTQ::RotationTypeRotation; break;
+	default:
+	  std::stringstream msg;
+	  msg << "Command::CreateParameters: Error: Invalid rotation type. " << rotationType;
+	  NGTThrowException(msg);
+	}
+      }
       {
 	char localCentroidType = args.getChar("T", 'f');
 	property.singleLocalCodebook = localCentroidType == 't' ? true : false;
@@ -113,6 +126,7 @@ public:
 
     std::string index;
     std::string objectPath;
+    std::string objectFormat;
     size_t numOfObjects;
     NGTQ::Property property;
     NGT::Property globalProperty;
@@ -130,7 +144,8 @@ public:
       "[-C global-codebook-size-limit] [-c local-codebook-size-limit] [-N local-division-no] "
       "[-T single-local-centroid (t|f)] [-e epsilon] [-i index-type (t:Tree|g:Graph)] "
       "[-M global-centroid-creation-mode (d|s)] [-L global-centroid-creation-mode (d|k|s)] "
-      "[-s local-sample-coefficient] "
+      "[-s local-sample-coefficient] [-F data-format(t|fvecs|bvecs|ivecs|npy|f32|u8)] "
+      "[-O rotation (n:none|p:permutation|r:rotation)] "
       "index(output) data.tsv(input)";
 
     try {
@@ -149,7 +164,7 @@ public:
       NGTQ::Index::create(createParameters.index, createParameters.property, createParameters.globalProperty, createParameters.localProperty);
 
       cerr << "ngtq: Append" << endl;
-      NGTQ::Index::append(createParameters.index, createParameters.objectPath, createParameters.numOfObjects);
+      NGTQ::Index::append(createParameters.index, createParameters.objectPath, createParameters.numOfObjects, createParameters.objectFormat);
     } catch(NGT::Exception &err) {
       std::cerr << err.what() << std::endl;
       cerr << usage << endl;
@@ -241,8 +256,8 @@ public:
   void 
   append(NGT::Args &args)
   {
-    const string usage = "Usage: ngtq append [-n data-size] "
-      "index(output) data.tsv(input)";
+    const string usage = "Usage: ngtq append [-n data-size] [-F data-format(t|fvecs|bvecs|ivecs|npy|f32|u8)] "
+      "[-p #-of-thread] index(output) data.tsv(input)";
     string index;
     try {
       index = args.get("#1");
@@ -259,12 +274,14 @@ public:
     }
 
     size_t dataSize = args.getl("n", 0);
+    string dataFormat = args.getString("F", "");
+    size_t numOfThreads = args.getl("p", 0);
 
     if (debugLevel >= 1) {
       cerr << "data size=" << dataSize << endl;
     }
 
-    NGTQ::Index::append(index, data, dataSize);
+    NGTQ::Index::append(index, data, dataSize, dataFormat, numOfThreads);
 
   }
 
@@ -17,8 +17,6 @@
 
 #include	"NGT/NGTQ/NGTQGCommand.h"
 
-#if !defined(NGT_SHARED_MEMORY_ALLOCATOR) && !defined(NGTQ_SHARED_INVERTED_INDEX)
-
 using namespace std;
 
 
@@ -32,18 +30,20 @@ NGTQG::Command::create(NGT::Args &args)
     "[-C global-codebook-size-limit] [-c local-codebook-size-limit] "
     "[-Q dimension-of-subvector] [-i index-type (t:Tree|g:Graph)] "
     "[-M global-centroid-creation-mode (d|s)] [-l global-centroid-creation-mode (d|k|s)] "
-    "[-s local-sample-coefficient] "
-    "index(output)";
+    "[-s local-sample-coefficient] [-F data-format(t|fvecs|bvecs|ivecs|npy|f32|u8)] "
+    "index(output) [data.tsv(input)]";
 
   try {
     NGT::Command::CreateParameters createParameters(args);
 
     switch (createParameters.indexType) {
     case 't':
-      NGT::Index::createGraphAndTree(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects);
+      NGT::Index::createGraphAndTree(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects,
+				     false, createParameters.objectFormat);
       break;
     case 'g':
-      NGT::Index::createGraph(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects);
+      NGT::Index::createGraph(createParameters.index, createParameters.property, createParameters.objectPath, createParameters.numOfObjects,
+			      false, createParameters.objectFormat);
       break;
     }
   } catch(NGT::Exception &err) {
@@ -65,6 +65,9 @@ NGTQG::Command::create(NGT::Args &args)
       return;
     }
   
+    // the local IDs of the quantized graph are stored in 4 bits up to 16 centroids, otherwise in 8 bits.
+    NGTQG::QuantizedGraphRepository::checkLocalCodebookSize(createParameters.property.localCentroidLimit);
+
     createParameters.index += "/qg";
   
     cerr << "ngtqg: Create" << endl;
@@ -86,7 +89,9 @@ NGTQG::Command::build(NGT::Args &args)
 void 
 NGTQG::Command::quantize(NGT::Args &args)
 {
-  const std::string usage = "Usage: ngtqg quantize  [-Q dimension-of-subvector] [-E max-number-of-edges] index";
+  const std::string usage = "Usage: ngtqg quantize  [-Q dimension-of-subvector] [-E max-number-of-edges] "
+    "[-V t|f (build the disk object file)] [-p #-of-threads] [-c local-codebook-size (16|256)] "
+    "[-L n|c (graph layout n:node c:compact)] index";
   string indexPath;
   try {
     indexPath = args.get("#1");
@@ -97,7 +102,22 @@ NGTQG::Command::quantize(NGT::Args &args)
   }
   size_t maxNumOfEdges = args.getl("E", 128);
   size_t dimensionOfSubvector = args.getl("Q", 0);
-  NGTQG::Index::quantize(indexPath, dimensionOfSubvector, maxNumOfEdges);
+  bool buildDiskObjects = args.getChar("V", 'f') == 't';
+  size_t numOfThreads = args.getl("p", 0);
+  size_t localCodebookSize = args.getl("c", 16);
+  char layout = args.getChar("L", 'n');
+  if (layout != 'n' && layout != 'c') {
+    cerr << "ngtqg: Invalid graph layout. " << layout << endl;
+    cerr << usage << endl;
+    return;
+  }
+  try {
+    NGTQG::Index::quantize(indexPath, dimensionOfSubvector, maxNumOfEdges, buildDiskObjects, numOfThreads, localCodebookSize,
+			   layout == 'c');
+  } catch (NGT::Exception &err) {
+    cerr << "ngtqg: Error " << err.what() << endl;
+    cerr << usage << endl;
+  }
 }
 
 void
@@ -171,7 +191,11 @@ search(NGTQG::Index &index, NGTQG::Command::SearchParameters &searchParameters,
       NGT::Timer timer;
       switch (searchParameters.indexType) {
       case 't': timer.start(); index.NGTQG::Index::search(searchQuery); timer.stop(); break;
-      case 's': timer.start(); index.linearSearch(searchQuery); timer.stop(); break;
+      case 's':
+	if (index.isDiskResident()) {
+	  NGTThrowException("NGTQG: The linear search is not available for the disk resident objects.");
+	}
+	timer.start(); index.linearSearch(searchQuery); timer.stop(); break;
       }
       totalTime += timer.time;
       if (searchParameters.outputMode[0] == 'e') {
@@ -219,7 +243,8 @@ search(NGTQG::Index &index, NGTQG::Command::SearchParameters &searchParameters,
 void
 NGTQG::Command::search(NGT::Args &args) {
   const string usage = "Usage: ngtqg search [-i index-type(g|t|s)] [-n result-size] [-e epsilon] [-E edge-size] "
-    "[-o output-mode] [-p result-expansion] index(input) query.tsv(input)";
+    "[-o output-mode] [-p result-expansion] [-m open-mode(r|w)] [-V disk-object-cache-size(MB)] "
+    "index(input) query.tsv(input)";
 
   string indexPath;
   try {
@@ -231,7 +256,16 @@ NGTQG::Command::search(NGT::Args &args) {
   }
   NGTQG::Command::SearchParameters searchParameters(args);
 
-  NGTQG::Index index(indexPath, 128);
+  bool readOnly = searchParameters.openMode == 'r';
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+  NGTQG::Index index(indexPath, 128, readOnly);
+#else
+  // the objects are read from the disk only for the re-ranking if the cache size is specified.
+  // since the read-only graph refers to the objects, the index is opened as writable in that case.
+  long cacheSize = args.getl("V", -1);
+  NGTQG::Index index(indexPath, 128, readOnly && cacheSize < 0, cacheSize >= 0,
+		     static_cast<size_t>(std::max(cacheSize, 0L)) * 1024 * 1024);
+#endif
 
   if (debugLevel >= 1) {
     cerr << "indexType=" << searchParameters.indexType << endl;
@@ -253,7 +287,10 @@ NGTQG::Command::search(NGT::Args &args) {
     cerr << "ngtqg: Error" << endl;
     cerr << usage << endl;
   }
-
+  if (debugLevel >= 1 && index.isDiskResident()) {
+    cerr << "diskObjectReadBlocks=" << index.diskObjects.getReadCount() << endl;
+    cerr << "diskObjectCacheHits=" << index.diskObjects.getHitCount() << endl;
+  }
 }
 
 
@@ -291,5 +328,3 @@ NGTQG::Command::info(NGT::Args &args)
     cerr << usage << endl;
   }
 }
-
-#endif 
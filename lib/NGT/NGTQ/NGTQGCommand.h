@@ -57,19 +57,11 @@ namespace NGTQG {
       float	stepOfResultExpansion;
   };
 
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR) || defined(NGTQ_SHARED_INVERTED_INDEX)
-    void create(NGT::Args &args) {};
-    void build(NGT::Args &args) {};
-    void quantize(NGT::Args &args) {};
-    void search(NGT::Args &args) {};
-    void info(NGT::Args &args) {};
-#else
     void create(NGT::Args &args);
     void build(NGT::Args &args);
     void quantize(NGT::Args &args);
     void search(NGT::Args &args);
     void info(NGT::Args &args);
-#endif
     
     void setDebugLevel(int level) { debugLevel = level; }
     int getDebugLevel() { return debugLevel; }
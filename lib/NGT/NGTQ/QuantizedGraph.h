@@ -16,9 +16,11 @@
 
 #pragma once
 
+#include	<sys/mman.h>
 
 #include	"NGT/Index.h"
 #include	"NGT/NGTQ/Quantizer.h"
+#include	"NGT/NGTQ/DiskObjectRepository.h"
 
 
 #define GLOBAL_SIZE	1
@@ -38,106 +40,474 @@ namespace NGTQG {
       template <typename QTYPE> SearchQuery(const std::vector<QTYPE> &q): NGT::QueryContainer(q) {}
   };
   
+  // The buffers which are reused by the searches of a thread, so that a search does not allocate them.
+  class SearchContext {
+  public:
+    void initialize(NGTQ::QuantizedObjectDistance &quantizedObjectDistance) {
+      if (lookupTable.isInitialized(quantizedObjectDistance.localCodebookNo, quantizedObjectDistance.localCodebookCentroidNo)) {
+	return;
+      }
+      quantizedObjectDistance.initialize(lookupTable);
+      work.resize(lookupTable.size);
+    }
+    NGTQ::QuantizedObjectDistance::DistanceLookupTableUint8	lookupTable;
+    std::vector<float>		work;
+    std::vector<uint8_t>	gatheredObjects;
+    NGTQ::QuantizedObjectDistance::DistanceLookupTableArena	arena;	// for the batched queries.
+  };
+
+  // The node owns the quantized objects, so that it is only moved when the repository grows.
   class QuantizedNode {
   public:
+    QuantizedNode():objects(0) {}
+    QuantizedNode(QuantizedNode &&node) noexcept:ids(std::move(node.ids)), objects(node.objects) { node.objects = 0; }
+    QuantizedNode(const QuantizedNode&) = delete;
+    QuantizedNode &operator=(const QuantizedNode&) = delete;
     ~QuantizedNode() {
       delete[] static_cast<uint8_t*>(objects);
     }
     std::vector<uint32_t> ids;
     void *objects;
   };
+
+  // The neighbor IDs of a node, which refer to either the IDs of a quantized node or the mapped graph file.
+  class QuantizedNodeIDs {
+  public:
+    QuantizedNodeIDs(const uint32_t *i, size_t s):ids(i), numOfIDs(s) {}
+    size_t size() const { return numOfIDs; }
+    uint32_t operator[](size_t idx) const { return ids[idx]; }
+    const uint32_t	*ids;
+    size_t		numOfIDs;
+  };
   
+  // The compact layout stores the code of each object once instead of the codes of the neighbors of each node.
   class QuantizedGraphRepository : public std::vector<QuantizedNode> {
     typedef std::vector<QuantizedNode> PARENT;
   public:
-    QuantizedGraphRepository(NGTQ::Index &quantizedIndex): numOfSubspaces(quantizedIndex.getQuantizer().property.localDivisionNo) {}
-    ~QuantizedGraphRepository() {}
+    static const uint64_t	compactMagic = 0x314743475154474eULL;	// "NGTQGCG1"
+
+    class MappedNode {
+    public:
+      const uint32_t	*ids;
+      size_t		numOfIDs;
+      void		*objects;
+    };
+
+    QuantizedGraphRepository(NGTQ::Index &quantizedIndex):
+      numOfSubspaces(quantizedIndex.getQuantizer().property.localDivisionNo),
+      localCodebookSize(quantizedIndex.getQuantizer().property.localCentroidLimit), compact(false),
+      codeSize(0), codeArray(0), mappedAddress(0), mappedSize(0) {
+      checkLocalCodebookSize(localCodebookSize);
+    }
+    ~QuantizedGraphRepository() { unmap(); }
+
+    static void checkLocalCodebookSize(size_t size) {
+      if (size == 0 || size > 256) {
+	std::stringstream msg;
+	msg << "NGTQG::QuantizedGraphRepository: The local codebook size should be from 1 to 256. " << size;
+	NGTThrowException(msg);
+      }
+    }
 
     void *get(size_t id) {
-      return PARENT::at(id).objects;
+      return isMapped() ? mappedNodes.at(id).objects : PARENT::at(id).objects;
+    }
+
+    QuantizedNodeIDs getIDs(size_t id) {
+      if (isMapped()) {
+	MappedNode &node = mappedNodes.at(id);
+	return QuantizedNodeIDs(node.ids, node.numOfIDs);
+      }
+      std::vector<uint32_t> &ids = PARENT::at(id).ids;
+      return QuantizedNodeIDs(ids.data(), ids.size());
+    }
+
+    size_t size() { return isMapped() ? mappedNodes.size() : PARENT::size(); }
+    bool isEmpty(size_t id) { return getIDs(id).size() == 0; }
+    bool isMapped() { return mappedAddress != 0; }
+    bool isUint4() { return localCodebookSize <= 16; }
+    bool isCompact() { return compact; }
+
+    size_t getStreamSize(NGTQ::QuantizedObjectProcessingStream &stream, size_t numOfIDs) {
+      return isUint4() ? stream.getUint4StreamSize(numOfIDs) : stream.getStreamSize(numOfIDs);
+    }
+
+    size_t getAlignedNumOfSubspaces() { return ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE; }
+
+    // The nodes are extended in the memory. The new nodes of the mapped graph refer to the nodes in the memory.
+    void setSize(size_t size) {
+      if (PARENT::size() < size) {
+	PARENT::resize(size);
+      }
+      if (isMapped() && mappedNodes.size() < size) {
+	mappedNodes.resize(size);
+      }
+    }
+
+    // The codes of the mapped graph are copied into the memory to be extended.
+    void resizeCodes(size_t size) {
+      if (codes.empty() && codeArray != 0) {
+	codes.assign(codeArray, codeArray + this->size() * codeSize);
+      }
+      if (codes.size() < size * codeSize) {
+	codes.resize(size * codeSize, 0);
+      }
+      codeArray = codes.data();
+    }
+
+    // Replace the node with the specified IDs and objects. The node of the mapped graph is replaced in the memory.
+    void setNode(size_t id, std::vector<uint32_t> &ids, void *objects) {
+      QuantizedNode &node = PARENT::at(id);
+      node.ids.swap(ids);
+      delete[] static_cast<uint8_t*>(node.objects);
+      node.objects = objects;
+      if (isMapped()) {
+	MappedNode &mappedNode = mappedNodes.at(id);
+	mappedNode.ids = node.ids.data();
+	mappedNode.numOfIDs = node.ids.size();
+	mappedNode.objects = objects;
+      }
     }
 
-    std::vector<uint32_t>& getIDs(size_t id) {
-      return PARENT::at(id).ids;
+    // Set the code of the object from the local IDs of the subspaces, which start from one.
+    void setCode(size_t id, const uint16_t *localIDs) {
+      uint8_t *code = &codes[id * codeSize];
+      memset(code, 0, codeSize);
+      for (size_t idx = 0; idx < numOfSubspaces; idx++) {
+	if (localIDs[idx] == 0) {
+	  continue;
+	}
+	if (isUint4()) {
+	  code[idx / 2] |= (localIDs[idx] - 1) << ((idx & 1) * 4);
+	} else {
+	  code[idx] = localIDs[idx] - 1;
+	}
+      }
+    }
+
+    // The codes of the specified neighbors are arranged into the blocks in the same way as the node layout.
+    uint8_t *gatherObjects(const QuantizedNodeIDs &ids, std::vector<uint8_t> &stream) {
+      size_t numOfIDs = ids.size();
+      size_t alignedNumOfSubspaces = getAlignedNumOfSubspaces();
+      size_t numOfBlocks = (numOfIDs + NGTQ_SIMD_BLOCK_SIZE - 1) / NGTQ_SIMD_BLOCK_SIZE;
+      size_t blockSize = NGTQ_SIMD_BLOCK_SIZE * alignedNumOfSubspaces / (isUint4() ? 2 : 1);
+      if (stream.size() < numOfBlocks * blockSize) {
+	stream.resize(numOfBlocks * blockSize);
+      }
+      uint8_t *block = stream.data();
+      for (size_t bidx = 0; bidx < numOfBlocks; bidx++, block += blockSize) {
+	const uint32_t *bids = ids.ids + bidx * NGTQ_SIMD_BLOCK_SIZE;
+	size_t n = std::min(static_cast<size_t>(NGTQ_SIMD_BLOCK_SIZE), numOfIDs - bidx * NGTQ_SIMD_BLOCK_SIZE);
+	if (n < NGTQ_SIMD_BLOCK_SIZE) {
+	  // the codes of the vacant objects should be in the range of the lookup table.
+	  memset(block, 0, blockSize);
+	}
+	if (isUint4()) {
+	  for (size_t oft = 0; oft < n; oft++) {
+	    const uint8_t *code = codeArray + static_cast<size_t>(bids[oft]) * codeSize;
+	    uint8_t *dst = block + oft / 2;
+	    size_t shift = (oft & 1) * 4;
+	    for (size_t idx = 0; idx < codeSize; idx++) {
+	      // each byte of a code has the local IDs of the two subspaces.
+	      uint8_t lo = code[idx] & 0x0f;
+	      uint8_t hi = code[idx] >> 4;
+	      if (shift == 0) {
+		dst[idx * 16] = lo;
+		dst[idx * 16 + 8] = hi;
+	      } else {
+		dst[idx * 16] |= lo << 4;
+		dst[idx * 16 + 8] |= hi << 4;
+	      }
+	    }
+	  }
+	} else {
+	  for (size_t oft = 0; oft < n; oft++) {
+	    const uint8_t *code = codeArray + static_cast<size_t>(bids[oft]) * codeSize;
+	    for (size_t idx = 0; idx < codeSize; idx++) {
+	      block[idx * NGTQ_SIMD_BLOCK_SIZE + oft] = code[idx];
+	    }
+	  }
+	}
+      }
+      return stream.data();
     }
     
-    void construct(NGT::Index &ngtindex, NGTQ::Index &quantizedIndex, size_t maxNoOfEdges) {
-      NGTQ::InvertedIndexEntry<uint16_t> invertedIndexObjects(numOfSubspaces);
-      quantizedIndex.getQuantizer().extractInvertedIndexObject(invertedIndexObjects);
+    // The quantized objects of each node are packed independently of the other nodes, so that the nodes are
+    // processed in parallel. When numOfThreads is zero, the default number of the threads of OpenMP is used.
+    void construct(NGT::Index &ngtindex, NGTQ::Index &quantizedIndex, size_t maxNoOfEdges, size_t numOfThreads = 0,
+		   bool compactLayout = false) {
+      unmap();
+      std::vector<uint16_t> localIDs;
+      quantizedIndex.getQuantizer().extractLocalIDs(localIDs);
       
       NGT::GraphAndTreeIndex &index = static_cast<NGT::GraphAndTreeIndex&>(ngtindex.getIndex());
       NGT::NeighborhoodGraph &graph = static_cast<NGT::NeighborhoodGraph&>(index);
 
       NGT::GraphRepository &graphRepository = graph.repository;
+      PARENT::clear();
       PARENT::resize(graphRepository.size());
+      modifiedCodes.addAll();
+      modifiedNodes.addAll();
 
+      if (numOfThreads == 0) {
+	numOfThreads = omp_get_max_threads();
+      }
+      compact = compactLayout;
+      std::vector<uint8_t>().swap(codes);
+      codeArray = 0;
+      codeSize = 0;
+      if (compact) {
+	setCodes(localIDs, graphRepository.size(), numOfThreads);
+      }
+      bool error = false;
+      std::string message;
+#pragma omp parallel for schedule(dynamic) num_threads(numOfThreads)
       for (size_t id = 1; id < graphRepository.size(); id++) {
-	NGT::GraphNode &node = *graphRepository.VECTOR::get(id);
-	size_t numOfEdges = node.size() < maxNoOfEdges ? node.size() : maxNoOfEdges;
-	(*this)[id].ids.reserve(numOfEdges);
-	NGTQ::QuantizedObjectProcessingStream quantizedStream(quantizedIndex.getQuantizer(), numOfEdges);
+	if (graphRepository.isEmpty(id)) {
+	  continue;
+	}
+	try {
+	  constructNode(id, *graphRepository.VECTOR::get(id), graphRepository, quantizedIndex, localIDs, maxNoOfEdges);
+	} catch (NGT::Exception &err) {
+#pragma omp critical
+	  {
+	    error = true;
+	    message = err.what();
+	  }
+	}
+      }
+      if (error) {
+	NGTThrowException("NGTQG::QuantizedGraphRepository::construct: " + message);
+      }
+    }
+
+    void constructNode(size_t id, NGT::GraphNode &node, NGT::GraphRepository &graphRepository,
+		       NGTQ::Index &quantizedIndex, std::vector<uint16_t> &localIDs, size_t maxNoOfEdges) {
+      size_t numOfEdges = node.size() < maxNoOfEdges ? node.size() : maxNoOfEdges;
+      (*this)[id].ids.reserve(numOfEdges);
+      NGTQ::QuantizedObjectProcessingStream quantizedStream(quantizedIndex.getQuantizer(), compact ? 0 : numOfEdges);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-	for (auto i = node.begin(graphRepository.allocator); i != node.end(graphRepository.allocator); ++i) {
-	  if (distance(node.begin(graphRepository.allocator), i) >= static_cast<int64_t>(numOfEdges)) {
+      for (auto i = node.begin(graphRepository.allocator); i != node.end(graphRepository.allocator); ++i) {
+	if (distance(node.begin(graphRepository.allocator), i) >= static_cast<int64_t>(numOfEdges)) {
 #else
-	for (auto i = node.begin(); i != node.end(); i++) {
-	  if (distance(node.begin(), i) >= static_cast<int64_t>(numOfEdges)) {
+      for (auto i = node.begin(); i != node.end(); i++) {
+	if (distance(node.begin(), i) >= static_cast<int64_t>(numOfEdges)) {
 #endif
-	    break;
-	  }
-	  if ((*i).id == 0) {
-	    std::cerr << "something strange" << std::endl;
-	    abort();
-	    continue;
-	  }
-	  (*this)[id].ids.push_back((*i).id);
-	  for (size_t idx = 0; idx < numOfSubspaces; idx++) {
+	  break;
+	}
+	if ((*i).id == 0) {
+	  std::stringstream msg;
+	  msg << "Invalid edge of the node. ID=" << id;
+	  NGTThrowException(msg);
+	}
+	(*this)[id].ids.push_back((*i).id);
+	for (size_t idx = 0; idx < numOfSubspaces; idx++) {
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-            size_t dataNo = distance(node.begin(graphRepository.allocator), i);  
+	  size_t dataNo = distance(node.begin(graphRepository.allocator), i);
 #else
-            size_t dataNo = distance(node.begin(), i);  
+	  size_t dataNo = distance(node.begin(), i);
 #endif
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-	    abort();
+	  uint16_t localID = (*i).id * numOfSubspaces + idx < localIDs.size() ? localIDs[(*i).id * numOfSubspaces + idx] : 0;
+	  if (localID < 1 || localID > localCodebookSize) {
+	    std::stringstream msg;
+	    msg << "Invalid local centroid ID. ID=" << (*i).id << ":" << localID;
+	    NGTThrowException(msg);
+	  }
+	  if (!compact) {
+	    quantizedStream.arrangeQuantizedObject(dataNo, idx, localID - 1);
+	  }
+	}
+      }
+
+      if (compact) {
+	(*this)[id].objects = 0;
+      } else {
+	(*this)[id].objects = isUint4() ? quantizedStream.compressIntoUint4() : quantizedStream.getStream();
+      }
+    }
+
+    void setCodes(std::vector<uint16_t> &localIDs, size_t size, size_t numOfThreads) {
+      codeSize = getAlignedNumOfSubspaces() / (isUint4() ? 2 : 1);
+      codes.assign(size * codeSize, 0);
+      codeArray = codes.data();
+      localIDs.resize(size * numOfSubspaces, 0);
+#pragma omp parallel for num_threads(numOfThreads)
+      for (size_t id = 1; id < size; id++) {
+	setCode(id, &localIDs[id * numOfSubspaces]);
+      }
+    }
+
+    // Only the nodes whose edges are changed by the insertion are rebuilt with the codes of the inserted objects.
+    void update(NGT::Index &ngtindex, NGTQ::Quantizer &quantizer, const std::vector<uint32_t> &ids,
+		const std::vector<uint16_t> &localIDs, size_t maxNoOfEdges, size_t numOfThreads) {
+      NGT::GraphAndTreeIndex &index = static_cast<NGT::GraphAndTreeIndex&>(ngtindex.getIndex());
+      NGT::GraphRepository &graphRepository = static_cast<NGT::NeighborhoodGraph&>(index).repository;
+      size_t size = graphRepository.size();
+      if (codeSize == 0) {
+	// the codes of the node layout are built at the first insertion.
+	std::vector<uint16_t> allLocalIDs;
+	quantizer.extractLocalIDs(allLocalIDs);
+	setCodes(allLocalIDs, size, numOfThreads);
+      } else {
+	resizeCodes(size);
+      }
+      setSize(size);
+      for (size_t i = 0; i < ids.size(); i++) {
+	for (size_t idx = 0; idx < numOfSubspaces; idx++) {
+	  uint16_t localID = localIDs[i * numOfSubspaces + idx];
+	  if (localID < 1 || localID > localCodebookSize) {
+	    std::stringstream msg;
+	    msg << "NGTQG::QuantizedGraphRepository::update: Invalid local centroid ID. ID=" << ids[i] << ":" << localID;
+	    NGTThrowException(msg);
+	  }
+	}
+	setCode(ids[i], &localIDs[i * numOfSubspaces]);
+	if (compact) {
+	  modifiedCodes.add(ids[i]);
+	}
+      }
+      std::vector<uint32_t> targets;
+      NGT::Property prop;
+      ngtindex.getProperty(prop);
+      if (prop.truncationThreshold != 0 || prop.pathAdjustmentInterval > 0) {
+	targets.reserve(size);
+	for (size_t id = 1; id < size; id++) {
+	  targets.push_back(id);
+	}
+      } else {
+	getInsertedNeighborhood(graphRepository, ids, targets);
+      }
+#pragma omp parallel for schedule(dynamic) num_threads(numOfThreads)
+      for (size_t ti = 0; ti < targets.size(); ti++) {
+	size_t id = targets[ti];
+	std::vector<uint32_t> edges;
+	if (!graphRepository.isEmpty(id)) {
+	  NGT::GraphNode &node = *graphRepository.VECTOR::get(id);
+	  size_t numOfEdges = node.size() < maxNoOfEdges ? node.size() : maxNoOfEdges;
+	  edges.reserve(numOfEdges);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	  for (auto i = node.begin(graphRepository.allocator); edges.size() < numOfEdges; ++i) {
 #else
-	    if (invertedIndexObjects[(*i).id].localID[idx] < 1 || invertedIndexObjects[(*i).id].localID[idx] > 16) {
-	      std::cerr << "Fatal inner error! Invalid local centroid ID. ID=" << (*i).id << ":" << invertedIndexObjects[(*i).id].localID[idx] << std::endl;
-	      abort();
-	    }
-	    quantizedStream.arrangeQuantizedObject(dataNo, idx, invertedIndexObjects[(*i).id].localID[idx] - 1);
+	  for (auto i = node.begin(); edges.size() < numOfEdges; ++i) {
 #endif
+	    edges.push_back((*i).id);
 	  }
-	} 
-
+	}
+	QuantizedNodeIDs current = getIDs(id);
+	if (edges.size() == current.size() && std::equal(edges.begin(), edges.end(), current.ids)) {
+	  continue;
+	}
+	uint8_t *objects = 0;
+	if (!compact && !edges.empty()) {
+	  std::vector<uint8_t> stream;
+	  gatherObjects(QuantizedNodeIDs(edges.data(), edges.size()), stream);
+	  NGTQ::QuantizedObjectProcessingStream processingStream(numOfSubspaces);
+	  size_t streamSize = getStreamSize(processingStream, edges.size());
+	  objects = new uint8_t[streamSize];
+	  memcpy(objects, stream.data(), streamSize);
+	}
+	setNode(id, edges, objects);
+	modifiedNodes.add(id);
+      }
+    }
 
-	(*this)[id].objects = quantizedStream.compressIntoUint4();
+    // the inserted nodes and all of their neighbors, which might have got the reverse edges, in the order of the IDs.
+    void getInsertedNeighborhood(NGT::GraphRepository &graphRepository, const std::vector<uint32_t> &ids,
+				 std::vector<uint32_t> &targets) {
+      targets.clear();
+      for (auto id = ids.begin(); id != ids.end(); ++id) {
+	targets.push_back(*id);
+	if (graphRepository.isEmpty(*id)) {
+	  continue;
+	}
+	NGT::GraphNode &node = *graphRepository.VECTOR::get(*id);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	for (auto i = node.begin(graphRepository.allocator); i != node.end(graphRepository.allocator); ++i) {
+#else
+	for (auto i = node.begin(); i != node.end(); ++i) {
+#endif
+	  targets.push_back((*i).id);
+	}
       }
+      std::sort(targets.begin(), targets.end());
+      targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+      targets.erase(std::remove(targets.begin(), targets.end(), 0), targets.end());
     }
 
     void serialize(std::ofstream &os, NGT::ObjectSpace *objspace = 0) {
       NGTQ::QuantizedObjectProcessingStream quantizedObjectProcessingStream(numOfSubspaces);
-      uint64_t n = numOfSubspaces;
+      uint64_t n;
+      if (compact) {
+	n = compactMagic;
+	NGT::Serializer::write(os, n);
+      }
+      n = numOfSubspaces;
       NGT::Serializer::write(os, n);
-      n = PARENT::size();
+      n = size();
       NGT::Serializer::write(os, n);
-      for (auto i = PARENT::begin(); i != PARENT::end(); ++i) {
-	NGT::Serializer::write(os, (*i).ids);
-	size_t streamSize = quantizedObjectProcessingStream.getUint4StreamSize((*i).ids.size());
-	NGT::Serializer::write(os, static_cast<uint8_t*>((*i).objects), streamSize);
+      if (compact) {
+	n = codeSize;
+	NGT::Serializer::write(os, n);
+	os.write(reinterpret_cast<const char*>(codeArray), size() * codeSize);
+      }
+      for (size_t id = 0; id < size(); id++) {
+	serializeNode(os, id, quantizedObjectProcessingStream);
+      }
+    }
+
+    void serializeNode(std::ostream &os, size_t id, NGTQ::QuantizedObjectProcessingStream &stream) {
+      QuantizedNodeIDs ids = getIDs(id);
+      uint32_t numOfIDs = ids.size();
+      NGT::Serializer::write(os, numOfIDs);
+      os.write(reinterpret_cast<const char*>(ids.ids), numOfIDs * sizeof(uint32_t));
+      if (!compact) {
+	size_t streamSize = getStreamSize(stream, numOfIDs);
+	NGT::Serializer::write(os, static_cast<uint8_t*>(get(id)), streamSize);
       }
     }
 
+    void deserializeNode(std::istream &is, size_t id) {
+      NGTQ::QuantizedObjectProcessingStream quantizedObjectProcessingStream(numOfSubspaces);
+      std::vector<uint32_t> ids;
+      NGT::Serializer::read(is, ids);
+      uint8_t *objects = 0;
+      if (!compact) {
+	size_t streamSize = getStreamSize(quantizedObjectProcessingStream, ids.size());
+	objects = new uint8_t[streamSize];
+	NGT::Serializer::read(is, objects, streamSize);
+      }
+      setNode(id, ids, objects);
+    }
+
     void deserialize(std::ifstream &is, NGT::ObjectSpace *objectspace = 0) {
       try {
 	NGTQ::QuantizedObjectProcessingStream quantizedObjectProcessingStream(numOfSubspaces);
 	uint64_t n;
 	NGT::Serializer::read(is, n);
+	compact = n == compactMagic;
+	if (compact) {
+	  NGT::Serializer::read(is, n);
+	}
 	numOfSubspaces = n;
 	NGT::Serializer::read(is, n);
 	PARENT::resize(n);
+	std::vector<uint8_t>().swap(codes);
+	codeArray = 0;
+	codeSize = 0;
+	if (compact) {
+	  NGT::Serializer::read(is, n);
+	  codeSize = n;
+	  codes.resize(PARENT::size() * codeSize);
+	  codeArray = codes.data();
+	  NGT::Serializer::read(is, codeArray, codes.size());
+	}
 	for (auto i = PARENT::begin(); i != PARENT::end(); ++i) {
 	  NGT::Serializer::read(is, (*i).ids);
-          size_t streamSize = quantizedObjectProcessingStream.getUint4StreamSize((*i).ids.size());
+	  if (compact) {
+	    (*i).objects = 0;
+	    continue;
+	  }
+          size_t streamSize = getStreamSize(quantizedObjectProcessingStream, (*i).ids.size());
 	  uint8_t *objectStream = new uint8_t[streamSize];
 	  NGT::Serializer::read(is, objectStream, streamSize);
 	  (*i).objects = objectStream;
@@ -149,47 +519,319 @@ namespace NGTQG {
       }
     }
 
+    // The modified nodes are appended to the journal until it gets larger than the graph file, which might be mapped.
     void save(const string &path) {
       const std::string p(path + "/grp");
-      std::ofstream os(p);
+      if (journalPath == path && journal.isAvailable() && journal.getSize() <= NGT::Journal::getFileSize(p) &&
+	  recordJournal(true)) {
+	journal.commit(path);
+	return;
+      }
+      // the journal is removed in advance, since it cannot be applied to the new graph file.
+      journal.clear();
+      journal.remove(path);
+      journalPath.clear();
+      std::stringstream tmp;
+      tmp << p << "." << getpid();
+      std::ofstream os(tmp.str());
       serialize(os);
+      os.close();
+      if (!os || std::rename(tmp.str().c_str(), p.c_str()) != 0) {
+	std::remove(tmp.str().c_str());
+	std::stringstream msg;
+	msg << "QuantizedGraph::save: Cannot write. " << p;
+	NGTThrowException(msg);
+      }
+      recordJournal(false);
+      journalPath = path;
+    }
+
+    bool recordJournal(bool collect) {
+      bool recorded = journal.record(0, compact ? size() : 0, modifiedCodes, [this](std::ostream &os, size_t idx) {
+	  os.write(reinterpret_cast<const char*>(codeArray + idx * codeSize), codeSize);
+	}, collect);
+      recorded = journal.record(1, size(), modifiedNodes, [this](std::ostream &os, size_t idx) {
+	  NGTQ::QuantizedObjectProcessingStream quantizedObjectProcessingStream(numOfSubspaces);
+	  serializeNode(os, idx, quantizedObjectProcessingStream);
+	}, collect) && recorded;
+      return recorded;
+    }
+
+    void replayJournal(const string &path) {
+      std::vector<NGT::Journal::Section> sections;
+      sections.push_back(NGT::Journal::Section([this](size_t size) { if (compact) resizeCodes(size); },
+					       [this](std::istream &is, size_t idx) {
+						 is.read(reinterpret_cast<char*>(&codes.at(idx * codeSize)), codeSize);
+					       }));
+      sections.push_back(NGT::Journal::Section([this](size_t size) { setSize(size); },
+					       [this](std::istream &is, size_t idx) { deserializeNode(is, idx); }));
+      journal.replay(path, sections);
+      recordJournal(false);
+      journalPath = path;
     }
 
     void load(const string &path) {
       const std::string p(path + "/grp");
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      map(p);
+#else
       std::ifstream is(p);
       deserialize(is);
+#endif
+      replayJournal(path);
     }
 
-    size_t numOfSubspaces;
+    void map(const string &file) {
+      unmap();
+      PARENT::clear();
+      std::vector<uint8_t>().swap(codes);
+      int fd = ::open(file.c_str(), O_RDONLY);
+      if (fd == -1) {
+	std::stringstream msg;
+	msg << "QuantizedGraph::map: Cannot open. " << file;
+	NGTThrowException(msg);
+      }
+      struct stat st;
+      void *addr = MAP_FAILED;
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+	addr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      }
+      ::close(fd);
+      if (addr == MAP_FAILED) {
+	std::stringstream msg;
+	msg << "QuantizedGraph::map: Cannot map. " << file;
+	NGTThrowException(msg);
+      }
+      mappedAddress = addr;
+      mappedSize = st.st_size;
+      uint8_t *ptr = static_cast<uint8_t*>(addr);
+      uint8_t *end = ptr + mappedSize;
+      NGTQ::QuantizedObjectProcessingStream quantizedObjectProcessingStream(numOfSubspaces);
+      try {
+	if (ptr + sizeof(uint64_t) * 2 > end) {
+	  NGTThrowException("The file is too short.");
+	}
+	compact = reinterpret_cast<uint64_t*>(ptr)[0] == compactMagic;
+	if (compact) {
+	  ptr += sizeof(uint64_t);
+	  if (ptr + sizeof(uint64_t) * 3 > end) {
+	    NGTThrowException("The file is too short.");
+	  }
+	}
+	numOfSubspaces = reinterpret_cast<uint64_t*>(ptr)[0];
+	size_t n = reinterpret_cast<uint64_t*>(ptr)[1];
+	ptr += sizeof(uint64_t) * 2;
+	if (compact) {
+	  codeSize = reinterpret_cast<uint64_t*>(ptr)[0];
+	  ptr += sizeof(uint64_t);
+	  codeArray = ptr;
+	  ptr += n * codeSize;
+	  if (ptr > end) {
+	    NGTThrowException("The file is too short.");
+	  }
+	}
+	mappedNodes.resize(n);
+	for (auto i = mappedNodes.begin(); i != mappedNodes.end(); ++i) {
+	  if (ptr + sizeof(uint32_t) > end) {
+	    NGTThrowException("The file is too short.");
+	  }
+	  (*i).numOfIDs = *reinterpret_cast<uint32_t*>(ptr);
+	  (*i).ids = reinterpret_cast<uint32_t*>(ptr + sizeof(uint32_t));
+	  ptr += sizeof(uint32_t) * ((*i).numOfIDs + 1);
+	  (*i).objects = compact ? 0 : ptr;
+	  if (!compact) {
+	    ptr += getStreamSize(quantizedObjectProcessingStream, (*i).numOfIDs);
+	  }
+	  if (ptr > end) {
+	    NGTThrowException("The file is too short.");
+	  }
+	}
+      } catch(NGT::Exception &err) {
+	unmap();
+	std::stringstream msg;
+	msg << "QuantizedGraph::map: Invalid file. " << file << " " << err.what();
+	NGTThrowException(msg);
+      }
+    }
+
+    void unmap() {
+      if (mappedAddress != 0) {
+	munmap(mappedAddress, mappedSize);
+	codeArray = 0;
+      }
+      mappedAddress = 0;
+      mappedSize = 0;
+      std::vector<MappedNode>().swap(mappedNodes);
+    }
+
+    size_t			numOfSubspaces;
+    size_t			localCodebookSize;
+    bool			compact;
+    size_t			codeSize;	// the byte size of the code of an object for the compact layout.
+    std::vector<uint8_t>	codes;
+    uint8_t			*codeArray;	// the codes or the mapped codes.
+    void			*mappedAddress;
+    size_t			mappedSize;
+    std::vector<MappedNode>	mappedNodes;
+    NGT::ModifiedEntries	modifiedCodes;
+    NGT::ModifiedEntries	modifiedNodes;
+    NGT::Journal		journal;
+    std::string			journalPath;	// the graph which the journal belongs to.
   };
 
 
   class Index : public NGT::Index {
   public:
-    Index(const std::string &indexPath, size_t maxNoOfEdges = 128) :
-      NGT::Index(indexPath, false),
+    // The quantized graph is built with the specified number of threads unless it is built in advance.
+    Index(const std::string &indexPath, size_t maxNoOfEdges = 128, bool readOnly = false, size_t numOfThreads = 0) :
+      NGT::Index(indexPath, readOnly),
       path(indexPath),
       quantizedIndex(indexPath + "/qg"),
-      quantizedGraph(quantizedIndex)  
+      quantizedGraph(quantizedIndex),
+      maxNoOfEdges(maxNoOfEdges),
+      inserted(false)
       {
-	{
+	loadQuantizedGraph(maxNoOfEdges, numOfThreads);
+      }
+
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    // When diskResident is true, only the objects for the re-ranking are read from the disk object file.
+    Index(const std::string &indexPath, size_t maxNoOfEdges, bool readOnly, bool diskResident,
+	  size_t cacheSize = DiskObjectRepository::defaultCacheSize) :
+      NGT::Index(indexPath, readOnly, diskResident ? NGT::Index::OpenTypeObjectDisabled : NGT::Index::OpenTypeNone),
+      path(indexPath),
+      quantizedIndex(indexPath + "/qg"),
+      quantizedGraph(quantizedIndex),
+      maxNoOfEdges(maxNoOfEdges),
+      inserted(false)
+      {
+	if (diskResident) {
 	  struct stat st;
-	  std::string qgpath(path + "/qg/grp");
-	  if (stat(qgpath.c_str(), &st) == 0) {
-	    quantizedGraph.load(path + "/qg");
-	  } else {
-	    quantizedGraph.construct(*this, quantizedIndex, maxNoOfEdges);
+	  if (stat((path + "/qg/grp").c_str(), &st) != 0) {
+	    NGTThrowException("NGTQG::Index: The quantized graph is not built yet. The objects are needed to build it.");
 	  }
+	  if (stat(DiskObjectRepository::getFileName(path).c_str(), &st) != 0) {
+	    NGTThrowException("NGTQG::Index: The disk object file is not built or is removed by the insertion. Quantize the index again.");
+	  }
+	  diskObjects.open(DiskObjectRepository::getFileName(path), cacheSize);
+	  if (diskObjects.getObjectSize() != getObjectSpace().getByteSizeOfObject() ||
+	      diskObjects.size() != static_cast<NGT::GraphIndex&>(getIndex()).repository.size()) {
+	    std::stringstream msg;
+	    msg << "NGTQG::Index: The disk object file is inconsistent with the index. Quantize the index again. "
+		<< DiskObjectRepository::getFileName(path);
+	    NGTThrowException(msg);
+	  }
+	}
+	loadQuantizedGraph(maxNoOfEdges);
+      }
+#endif
+
+    void loadQuantizedGraph(size_t maxNoOfEdges, size_t numOfThreads = 0) {
+      struct stat st;
+      std::string qgpath(path + "/qg/grp");
+      if (stat(qgpath.c_str(), &st) == 0) {
+	quantizedGraph.load(path + "/qg");
+      } else if (static_cast<NGT::GraphIndex&>(getIndex()).getReadOnly()) {
+	NGTThrowException("NGTQG::Index: The quantized graph is not built yet. The index cannot be opened as read-only.");
+      } else {
+	quantizedGraph.construct(*this, quantizedIndex, maxNoOfEdges, numOfThreads);
+      }
+    }
+
+    bool isDiskResident() { return diskObjects.isOpen(); }
+
+    // Set the distances of the objects read from the disk object file. When primitive is true, the distances
+    // are computed in the same way as the distances of the seeds with the objects in the memory.
+    void setDistancesOfDiskObjects(NGT::Object &query, NGT::ObjectDistances &objects, bool primitive = false) {
+      std::vector<NGT::ObjectID> ids;
+      ids.reserve(objects.size());
+      for (auto i = objects.begin(); i != objects.end(); ++i) {
+	ids.push_back((*i).id);
+      }
+      std::vector<uint8_t> buffer;
+      diskObjects.get(ids, buffer);
+      NGT::ObjectSpace &objectSpace = NGT::Index::getObjectSpace();
+      NGT::ObjectSpace::Comparator &comparator = objectSpace.getComparator();
+      size_t objectSize = diskObjects.getObjectSize();
+      size_t dimension = objectSpace.getPaddedDimension();
+      // the objects are copied to an aligned object for the comparator.
+      NGT::Object *object = objectSpace.allocateObject();
+      for (size_t i = 0; i < objects.size(); i++) {
+	memcpy(&(*object)[0], &buffer[i * objectSize], objectSize);
+	if (primitive) {
+	  objects[i].distance = NGT::PrimitiveComparator::L2Float::compare(&query[0], &(*object)[0], dimension);
+	} else {
+	  objects[i].distance = comparator(query, *object);
 	}
       }
+      objectSpace.deleteObject(object);
+    }
 
+    // The disk object file no longer matches the index after the insertion, and is removed.
     void save() {
+      if (inserted) {
+	NGT::Index::save();
+	quantizedIndex.save();
+	std::remove(DiskObjectRepository::getFileName(path).c_str());
+	inserted = false;
+      }
       quantizedGraph.save(path + "/qg");
     }
 
+    // The objects are encoded with the existing codebooks. maxNoOfEdges should be the same as that of quantize().
+    template <typename T>
+    void insert(const std::vector<std::vector<T>> &objects, std::vector<NGT::ObjectID> &ids, size_t numOfThreads = 0) {
+      if (static_cast<NGT::GraphIndex&>(getIndex()).getReadOnly() || isDiskResident()) {
+	NGTThrowException("NGTQG::Index::insert: The read-only or disk resident index cannot be updated.");
+      }
+      NGTQ::Quantizer &quantizer = quantizedIndex.getQuantizer();
+      if (!quantizer.property.localCodebookState) {
+	NGTThrowException("NGTQG::Index::insert: The local codebooks are not completed. Quantize the index again.");
+      }
+      if (numOfThreads == 0) {
+	numOfThreads = omp_get_max_threads();
+      }
+      ids.clear();
+      for (auto i = objects.begin(); i != objects.end(); ++i) {
+	ids.push_back(NGT::Index::insert(*i));
+      }
+      NGT::Index::createIndex(numOfThreads);
+      inserted = true;
+
+      NGT::ObjectSpace &objectSpace = getObjectSpace();
+      std::vector<std::pair<NGT::Object*, size_t>> quantizedObjects;
+      for (auto i = ids.begin(); i != ids.end(); ++i) {
+	std::vector<float> object;
+	objectSpace.getObject(*i, object);
+	quantizer.insert(object, quantizedObjects, *i);
+      }
+      if (quantizedObjects.size() > 0) {
+	quantizer.insert(quantizedObjects);
+      }
+      std::vector<uint32_t> quantizedIDs(ids.begin(), ids.end());
+      std::vector<uint16_t> localIDs;
+      quantizer.extractLocalIDs(quantizedIDs, localIDs);
+      quantizedGraph.update(*this, quantizer, quantizedIDs, localIDs, maxNoOfEdges, numOfThreads);
+    }
+
+    template <typename T>
+    NGT::ObjectID insert(const std::vector<T> &object) {
+      std::vector<std::vector<T>> objects(1, object);
+      std::vector<NGT::ObjectID> ids;
+      insert(objects, ids);
+      return ids[0];
+    }
+
     
-    void searchQuantizedGraph(NGT::NeighborhoodGraph &graph, NGTQG::SearchContainer &sc, NGT::ObjectDistances &seeds) {
+    // The context of the calling thread is shared by all of the indexes.
+    static SearchContext &getSearchContext() {
+      static thread_local SearchContext context;
+      return context;
+    }
+
+    // When the lookup table is not specified, the table of the query is created in the search context.
+    void searchQuantizedGraph(NGT::NeighborhoodGraph &graph, NGTQG::SearchContainer &sc, NGT::ObjectDistances &seeds,
+			      NGTQ::QuantizedObjectDistance::DistanceLookupTableUint8 *lookupTable = 0) {
       size_t sizeBackup = sc.size;
       if (sc.resultExpansion > 1.0) {
 	sc.size *= sc.resultExpansion;
@@ -198,24 +840,32 @@ namespace NGTQG {
       NGTQ::Quantizer &quantizer = quantizedIndex.getQuantizer();
       NGTQ::QuantizedObjectDistance &quantizedObjectDistance = quantizer.getQuantizedObjectDistance();
 
-      NGTQ::QuantizedObjectDistance::DistanceLookupTableUint8 cache[GLOBAL_SIZE + 1];
-      for (int i = 1; i < GLOBAL_SIZE + 1; i++) {
-	quantizedObjectDistance.initialize(cache[i]);
-	quantizedObjectDistance.createDistanceLookup(sc.object, i, cache[i]);
+      SearchContext &context = getSearchContext();
+      if (lookupTable == 0) {
+	context.initialize(quantizedObjectDistance);
+	// the global codebook has only one centroid.
+	quantizedObjectDistance.createDistanceLookup(sc.object, 1, context.lookupTable, context.work.data());
+	lookupTable = &context.lookupTable;
       }
 
       if (sc.explorationCoefficient == 0.0) {
 	sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
       }
       NGT::NeighborhoodGraph::UncheckedSet unchecked;
-      NGT::NeighborhoodGraph::DistanceCheckedSet distanceChecked(graph.repository.size());
+      // the graph repository is not loaded for the read-only graph index.
+      NGT::NeighborhoodGraph::DistanceCheckedSet distanceChecked(quantizedGraph.size());
       NGT::NeighborhoodGraph::ResultSet results;
 
-      graph.setupDistances(sc, seeds, NGT::PrimitiveComparator::L2Float::compare);
+      if (isDiskResident()) {
+	setDistancesOfDiskObjects(sc.object, seeds, true);
+      } else {
+	graph.setupDistances(sc, seeds, NGT::PrimitiveComparator::L2Float::compare);
+      }
       graph.setupSeeds(sc, seeds, results, unchecked, distanceChecked);
       NGT::Distance explorationRadius = sc.explorationCoefficient * sc.radius;
       NGT::ObjectDistance result;
       NGT::ObjectDistance target;
+      std::vector<uint8_t> &gatheredObjects = context.gatheredObjects;
 
       while (!unchecked.empty()) {
 	target = unchecked.top();
@@ -223,21 +873,28 @@ namespace NGTQG {
 	if (target.distance > explorationRadius) {
 	  break;
 	}
-	auto &neighborIDs = quantizedGraph.getIDs(target.id);
+	auto neighborIDs = quantizedGraph.getIDs(target.id);
 	size_t neighborSize = neighborIDs.size();
 	float ds[neighborSize + NGTQ_SIMD_BLOCK_SIZE];
 
+	uint8_t *objects;
+	if (quantizedGraph.isCompact()) {
+	  objects = quantizedGraph.gatherObjects(neighborIDs, gatheredObjects);
+	} else {
+	  objects = static_cast<uint8_t*>(quantizedGraph.get(target.id));
 #ifdef NGTQG_PREFETCH
-	{
-	  uint8_t *lid = static_cast<uint8_t*>(quantizedGraph.get(target.id));
 	  size_t size = ((neighborSize - 1) / (NGTQ_SIMD_BLOCK_SIZE * NGTQ_BATCH_SIZE) + 1) * (NGTQ_SIMD_BLOCK_SIZE * NGTQ_BATCH_SIZE);
-	  size /= 2;
+	  size /= quantizedGraph.isUint4() ? 2 : 1;
 	  size *= quantizedIndex.getQuantizer().divisionNo; 
 
-	  NGT::MemoryCache::prefetch(lid, size);
-	}
+	  NGT::MemoryCache::prefetch(objects, size);
 #endif  //// NGTQG_PREFETCH
-	quantizedObjectDistance(quantizedGraph.get(target.id), ds, neighborSize, cache[1]);
+	}
+	if (quantizedGraph.isUint4()) {
+	  quantizedObjectDistance(objects, ds, neighborSize, *lookupTable);
+	} else {
+	  quantizedObjectDistance.getDistancesWithUint8LocalIDs(objects, ds, neighborSize, *lookupTable);
+	}
 	for (size_t idx = 0;idx < neighborSize; idx++) {
 	  NGT::Distance distance = ds[idx];
 	  auto objid = neighborIDs[idx];
@@ -270,7 +927,12 @@ namespace NGTQG {
       if (sc.resultIsAvailable()) { 
 	NGT::ObjectDistances &qresults = sc.getResult();
 	qresults.moveFrom(results);
-	if (sc.resultExpansion >= 1.0) {
+	if (sc.resultExpansion >= 1.0 && isDiskResident()) {
+	  setDistancesOfDiskObjects(sc.object, qresults);
+	  std::sort(qresults.begin(), qresults.end());
+	  sc.size = sizeBackup;
+	  qresults.resize(sc.size);
+	} else if (sc.resultExpansion >= 1.0) {
 	  {
 	    NGT::ObjectRepository &objectRepository = NGT::Index::getObjectSpace().getRepository();
 	    NGT::ObjectSpace::Comparator &comparator =  NGT::Index::getObjectSpace().getComparator();
@@ -279,10 +941,11 @@ namespace NGTQG {
 	      if (static_cast<size_t>(distance(qresults.begin(), i + 10)) < qresults.size()) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)    
 		NGT::PersistentObject &o = *objectRepository.get((*(i + 10)).id);
+		_mm_prefetch(o.getPointer(0, objectRepository.getAllocator()), _MM_HINT_T0);
 #else
 		NGT::Object &o = *objectRepository[(*(i + 10)).id];
-#endif
 		_mm_prefetch(&o[0], _MM_HINT_T0);
+#endif
 	      }
 #endif
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
@@ -298,7 +961,17 @@ namespace NGTQG {
 	  qresults.resize(sc.size);
 	}
       } else {
-	if (sc.resultExpansion >= 1.0) {
+	if (sc.resultExpansion >= 1.0 && isDiskResident()) {
+	  NGT::ObjectDistances candidates;
+	  candidates.moveFrom(results);
+	  setDistancesOfDiskObjects(sc.object, candidates);
+	  while (!sc.workingResult.empty()) { sc.workingResult.pop(); }
+	  for (auto i = candidates.begin(); i != candidates.end(); ++i) {
+	    sc.workingResult.push(*i);
+	  }
+	  sc.size = sizeBackup;
+	  while (sc.workingResult.size() > sc.size) { sc.workingResult.pop(); }
+	} else if (sc.resultExpansion >= 1.0) {
 	  {
 	    NGT::ObjectRepository &objectRepository = NGT::Index::getObjectSpace().getRepository();
 	    NGT::ObjectSpace::Comparator &comparator =  NGT::Index::getObjectSpace().getComparator();
@@ -321,28 +994,25 @@ namespace NGTQG {
 
 
 
-    void search(NGT::GraphIndex &index, NGTQG::SearchContainer &sc, NGT::ObjectDistances &seeds) {
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-      NGTThrowException("NGTQG is not available for SHARED.");
-#endif
-      if (index.getReadOnly()) {
-	NGTThrowException("NGTQG is not available for readonly mode.");
-      }
+    void search(NGT::GraphIndex &index, NGTQG::SearchContainer &sc, NGT::ObjectDistances &seeds,
+		NGTQ::QuantizedObjectDistance::DistanceLookupTableUint8 *lookupTable = 0) {
       if (sc.size == 0) {
 	while (!sc.workingResult.empty()) sc.workingResult.pop();
 	return;
       }
       if (seeds.size() == 0) {
-	index.getSeedsFromGraph(index.repository, seeds);
+	// the seeds are taken from the quantized graph, since the graph repository of the index is not loaded
+	// when the index is opened as read-only.
+	index.getSeedsFromGraph(quantizedGraph, seeds);
       }
       if (sc.expectedAccuracy > 0.0) {
 	sc.setEpsilon(getEpsilonFromExpectedAccuracy(sc.expectedAccuracy));
       }
       try {
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR) || !defined(NGT_GRAPH_READ_ONLY_GRAPH)
+#if !defined(NGT_GRAPH_READ_ONLY_GRAPH)
 	index.NeighborhoodGraph::search(sc, seeds);
 #else
-	searchQuantizedGraph(static_cast<NGT::NeighborhoodGraph&>(index), sc, seeds);
+	searchQuantizedGraph(static_cast<NGT::NeighborhoodGraph&>(index), sc, seeds, lookupTable);
 #endif
       } catch(NGT::Exception &err) {
 	std::cerr << err.what() << std::endl;
@@ -352,18 +1022,9 @@ namespace NGTQG {
     }
 
     void search(NGTQG::SearchQuery &sq) {
-      NGT::GraphAndTreeIndex &index = static_cast<NGT::GraphAndTreeIndex&>(getIndex());
       NGT::Object *query = Index::allocateObject(sq.getQuery(), sq.getQueryType());
       try {
-        NGTQG::SearchContainer sc(sq, *query);
-        sc.distanceComputationCount = 0;
-        sc.visitCount = 0;
-	NGT::ObjectDistances	seeds;
-	index.getSeedsFromTree(sc, seeds);
-	NGTQG::Index::search(static_cast<NGT::GraphIndex&>(index), sc, seeds);
-	sq.workingResult = std::move(sc.workingResult);
-	sq.distanceComputationCount = sc.distanceComputationCount;
-	sq.visitCount = sc.visitCount;
+	search(sq, *query);
       } catch(NGT::Exception &err) {
 	deleteObject(query);
 	throw err;
@@ -371,6 +1032,61 @@ namespace NGTQG {
       deleteObject(query);
     }
 
+    // The lookup tables of all of the queries are created into the arena before the queries are searched in parallel.
+    void search(std::vector<NGTQG::SearchQuery*> &queries, size_t numOfThreads = 0) {
+      if (numOfThreads == 0) {
+	numOfThreads = omp_get_max_threads();
+      }
+      std::vector<NGT::Object*> objects;
+      objects.reserve(queries.size());
+      try {
+	for (auto i = queries.begin(); i != queries.end(); ++i) {
+	  objects.push_back(Index::allocateObject((*i)->getQuery(), (*i)->getQueryType()));
+	}
+	NGTQ::QuantizedObjectDistance &quantizedObjectDistance = quantizedIndex.getQuantizer().getQuantizedObjectDistance();
+	NGTQ::QuantizedObjectDistance::DistanceLookupTableArena &arena = getSearchContext().arena;
+	quantizedObjectDistance.createDistanceLookups(objects, 1, arena, numOfThreads);
+	std::vector<std::string> errors(queries.size());
+#pragma omp parallel for schedule(dynamic) num_threads(numOfThreads)
+	for (size_t idx = 0; idx < queries.size(); idx++) {
+	  try {
+	    search(*queries[idx], *objects[idx], &arena[idx]);
+	  } catch(NGT::Exception &err) {
+	    errors[idx] = err.what();
+	  }
+	}
+	for (auto i = errors.begin(); i != errors.end(); ++i) {
+	  if (!(*i).empty()) {
+	    NGTThrowException(*i);
+	  }
+	}
+      } catch(NGT::Exception &err) {
+	for (auto i = objects.begin(); i != objects.end(); ++i) {
+	  deleteObject(*i);
+	}
+	throw err;
+      }
+      for (auto i = objects.begin(); i != objects.end(); ++i) {
+	deleteObject(*i);
+      }
+    }
+
+    void search(NGTQG::SearchQuery &sq, NGT::Object &query,
+		NGTQ::QuantizedObjectDistance::DistanceLookupTableUint8 *lookupTable = 0) {
+      NGT::GraphIndex &index = static_cast<NGT::GraphIndex&>(getIndex());
+      NGTQG::SearchContainer sc(sq, query);
+      sc.distanceComputationCount = 0;
+      sc.visitCount = 0;
+      NGT::ObjectDistances	seeds;
+      if (index.getProperty().indexType == NGT::Index::Property::IndexType::GraphAndTree) {
+	static_cast<NGT::GraphAndTreeIndex&>(index).getSeedsFromTree(sc, seeds);
+      }
+      NGTQG::Index::search(static_cast<NGT::GraphIndex&>(index), sc, seeds, lookupTable);
+      sq.workingResult = std::move(sc.workingResult);
+      sq.distanceComputationCount = sc.distanceComputationCount;
+      sq.visitCount = sc.visitCount;
+    }
+
     static size_t getNumberOfSubvectors(size_t dimension, size_t dimensionOfSubvector) {
       if (dimensionOfSubvector == 0) {
 	dimensionOfSubvector = dimension > 400 ? 2 : 1;
@@ -384,14 +1100,26 @@ namespace NGTQG {
       return dimension / dimensionOfSubvector;
     }
 
-    static void buildQuantizedGraph(const std::string indexPath, size_t maxNumOfEdges) {
-      NGTQG::Index index(indexPath, maxNumOfEdges);
-      index.save();
+    // When compactLayout is true, the code of each object is stored only once instead of the codes of the
+    // neighbors of each node, which reduces the memory but slows down the search.
+    static void buildQuantizedGraph(const std::string indexPath, size_t maxNumOfEdges, size_t numOfThreads = 0,
+				    bool compactLayout = false) {
+      NGT::Index index(indexPath);
+      NGTQ::Index quantizedIndex(indexPath + "/qg");
+      QuantizedGraphRepository quantizedGraph(quantizedIndex);
+      quantizedGraph.construct(index, quantizedIndex, maxNumOfEdges, numOfThreads, compactLayout);
+      quantizedGraph.save(indexPath + "/qg");
     }
 
-    static void buildQuantizedObjects(const std::string quantizedIndexPath, NGT::ObjectSpace &objectSpace) {
+    // The objects are assigned to the codebooks in batches, each of which is searched with the specified number
+    // of threads. When numOfThreads is zero, the thread size of the quantizer property is used.
+    static void buildQuantizedObjects(const std::string quantizedIndexPath, NGT::ObjectSpace &objectSpace,
+				      size_t numOfThreads = 0) {
       NGTQ::Index	quantizedIndex(quantizedIndexPath);
       NGTQ::Quantizer	&quantizer = quantizedIndex.getQuantizer();
+      if (numOfThreads != 0) {
+	quantizer.setThreadSize(numOfThreads);
+      }
 
       {
 	std::vector<float> meanObject(objectSpace.getDimension(), 0);
@@ -415,12 +1143,15 @@ namespace NGTQG {
       if (objects.size() > 0) {
 	quantizer.insert(objects);
       }
+      quantizer.completeLocalCodebooks();
 
       quantizedIndex.save();
       quantizedIndex.close();
     }
 
-    static void constructQuantizedGraphFrame(const std::string quantizedIndexPath, size_t dimension, size_t dimensionOfSubvector) {
+    static void constructQuantizedGraphFrame(const std::string quantizedIndexPath, size_t dimension, size_t dimensionOfSubvector,
+					     size_t localCodebookSize = 16) {
+      QuantizedGraphRepository::checkLocalCodebookSize(localCodebookSize);
       NGTQ::Property property;
       NGT::Property globalProperty;
       NGT::Property localProperty;
@@ -436,7 +1167,7 @@ namespace NGTQG {
       property.localCentroidCreationMode = NGTQ::CentroidCreationModeDynamicKmeans; 
 
       property.globalCentroidLimit = 1; 
-      property.localCentroidLimit = 16; 
+      property.localCentroidLimit = localCodebookSize; 
       property.localClusteringSampleCoefficient = 100; 
       property.localDivisionNo = NGTQG::Index::getNumberOfSubvectors(dimension, dimensionOfSubvector);
       property.dimension = dimension;
@@ -453,7 +1184,19 @@ namespace NGTQG {
 
     }
 
-    static void quantize(const std::string indexPath, float dimensionOfSubvector, size_t maxNumOfEdges) {
+    // The objects have not been quantized yet when the quantized index has only been created by the create command.
+    static bool isQuantized(const std::string quantizedIndexPath) {
+      NGTQ::Index quantizedIndex(quantizedIndexPath);
+      return quantizedIndex.getQuantizer().globalCodebook.getObjectRepositorySize() > 1;
+    }
+
+    // When numOfThreads is zero, the default number of the threads of OpenMP is used.
+    static void quantize(const std::string indexPath, float dimensionOfSubvector, size_t maxNumOfEdges,
+			 bool buildDiskObjects = false, size_t numOfThreads = 0, size_t localCodebookSize = 16,
+			 bool compactLayout = false) {
+      if (numOfThreads == 0) {
+	numOfThreads = omp_get_max_threads();
+      }
       NGT::Index	index(indexPath);
       NGT::ObjectSpace &objectSpace = index.getObjectSpace();
 
@@ -461,17 +1204,23 @@ namespace NGTQG {
       {
 	std::string quantizedIndexPath = indexPath + "/qg";
 	struct stat st;
-	if (stat(quantizedIndexPath.c_str(), &st) != 0) {
+	bool created = stat(quantizedIndexPath.c_str(), &st) == 0;
+	if (!created) {
 	  NGT::Property ngtProperty;
 	  index.getProperty(ngtProperty);
 	  //NGTQG::Command::CreateParameters createParameters(args, property.dimension);
-	  constructQuantizedGraphFrame(quantizedIndexPath, ngtProperty.dimension, dimensionOfSubvector);
-	  buildQuantizedObjects(quantizedIndexPath, objectSpace);
+	  constructQuantizedGraphFrame(quantizedIndexPath, ngtProperty.dimension, dimensionOfSubvector, localCodebookSize);
+	}
+	if (!created || !isQuantized(quantizedIndexPath)) {
+	  buildQuantizedObjects(quantizedIndexPath, objectSpace, numOfThreads);
 	  if (maxNumOfEdges != 0) {
-	    buildQuantizedGraph(indexPath, maxNumOfEdges);
+	    buildQuantizedGraph(indexPath, maxNumOfEdges, numOfThreads, compactLayout);
 	  }
 	}
       }
+      if (buildDiskObjects) {
+	DiskObjectRepository::build(DiskObjectRepository::getFileName(indexPath), objectSpace);
+      }
     }
 
     const std::string path;
@@ -479,6 +1228,9 @@ namespace NGTQG {
     NGTQ::Index blobIndex;
 
     QuantizedGraphRepository quantizedGraph;
+    DiskObjectRepository diskObjects;
+    size_t maxNoOfEdges;	// the max # of the edges of each node of the quantized graph.
+    bool inserted;
 
   }; 
 
@@ -16,6 +16,11 @@
 
 #pragma once
 
+#include	<unordered_map>
+#include	<memory>
+#include	<mutex>
+#include	<atomic>
+
 #include	"NGT/Index.h"
 #include	"NGT/ArrayFile.h"
 #include	"NGT/Clustering.h"
@@ -102,7 +107,7 @@ public:
     PARENT::back().setID(id);
   }
 
-  void serialize(std::ofstream &os, NGT::ObjectSpace *objspace = 0) {
+  void serialize(std::ostream &os, NGT::ObjectSpace *objspace = 0) {
     uint32_t sz = PARENT::size();
     NGT::Serializer::write(os, sz);
     if (numOfLocalIDs > 0xFFFF) {
@@ -114,7 +119,7 @@ public:
     os.write(reinterpret_cast<char*>(PARENT::vector), PARENT::size() * PARENT::elementSize);
   }
 
-  void deserialize(std::ifstream &is, NGT::ObjectSpace *objectspace = 0) {
+  void deserialize(std::istream &is, NGT::ObjectSpace *objectspace = 0) {
     uint32_t sz;
     uint16_t nids;
     try {
@@ -177,6 +182,12 @@ public:
    CentroidCreationModeDynamicKmeans	= 2,
  };
 
+ enum RotationType {
+   RotationTypeNone		= 0,
+   RotationTypePermutation	= 1,	// permutation of the dimensions
+   RotationTypeRotation		= 2	// orthonormal rotation
+ };
+
  enum AggregationMode {
    AggregationModeApproximateDistance				= 0,
    AggregationModeApproximateDistanceWithLookupTable		= 1,
@@ -206,6 +217,7 @@ public:
     localIDByteSize	= 0;		// finally decided by localCentroidLimit
     localCodebookState	= false;	// not completed
     localClusteringSampleCoefficient = 10;	
+    rotationType	= RotationTypeNone;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize = 512; // MB
 #endif
@@ -230,6 +242,7 @@ public:
     prop.set("LocalIDByteSize",	(long)localIDByteSize);	
     prop.set("LocalCodebookState", (long)localCodebookState);
     prop.set("LocalSampleCoefficient", (long)localClusteringSampleCoefficient);
+    prop.set("RotationType",	(long)rotationType);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     prop.set("InvertedIndexSharedMemorySize", 	(long)invertedIndexSharedMemorySize);
 #endif
@@ -275,6 +288,7 @@ public:
     localIDByteSize	= prop.getl("LocalIDByteSize", INT_MAX);
     localCodebookState	= prop.getl("LocalCodebookState", localCodebookState);
     localClusteringSampleCoefficient	= prop.getl("LocalSampleCoefficient", localClusteringSampleCoefficient);
+    rotationType	= (RotationType)prop.getl("RotationType", rotationType);
     setupLocalIDByteSize();
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize
@@ -297,6 +311,7 @@ public:
     localIDByteSize	= p.localIDByteSize;
     localCodebookState	= p.localCodebookState;
     localClusteringSampleCoefficient = p.localClusteringSampleCoefficient;
+    rotationType	= p.rotationType;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize = p.invertedIndexSharedMemorySize;
 #endif
@@ -321,6 +336,7 @@ public:
   size_t	localIDByteSize;
   bool		localCodebookState;
   size_t	localClusteringSampleCoefficient;
+  RotationType	rotationType;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
   size_t	invertedIndexSharedMemorySize;
 #endif
@@ -371,23 +387,48 @@ public:
     vector<bool>	flag;	
   };
 
+  // The table either owns the memory, or refers to the memory of an arena.
   class DistanceLookupTableUint8 {
   public:
-    DistanceLookupTableUint8():localDistanceLookup(0) {}
-    ~DistanceLookupTableUint8() {
-      if (localDistanceLookup != 0) {
+    DistanceLookupTableUint8():localDistanceLookup(0), size(0), aslignedNumOfSubspaces(0), localCodebookCentroidNo(0),
+      external(false) {}
+    ~DistanceLookupTableUint8() { release(); }
+    void initialize(size_t numOfSubspaces, size_t centroidNo) {
+      release();
+      size_t alignedNumOfSubvectors = ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
+      size = alignedNumOfSubvectors * centroidNo;
+      // the gather of the 8-bit local IDs reads 4 bytes from each of the entries.
+      localDistanceLookup = new uint8_t[getByteSize(numOfSubspaces, centroidNo)];
+      scales = new float[alignedNumOfSubvectors];
+      offsets = new float[alignedNumOfSubvectors];
+      aslignedNumOfSubspaces = alignedNumOfSubvectors;
+      localCodebookCentroidNo = centroidNo;
+    }
+    void set(uint8_t *lut, float *s, float *o, size_t numOfSubspaces, size_t centroidNo) {
+      release();
+      aslignedNumOfSubspaces = ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
+      localCodebookCentroidNo = centroidNo;
+      size = aslignedNumOfSubspaces * centroidNo;
+      localDistanceLookup = lut;
+      scales = s;
+      offsets = o;
+      external = true;
+    }
+    bool isInitialized(size_t numOfSubspaces, size_t centroidNo) {
+      return localDistanceLookup != 0 && localCodebookCentroidNo == centroidNo &&
+	aslignedNumOfSubspaces == ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
+    }
+    static size_t getByteSize(size_t numOfSubspaces, size_t centroidNo) {
+      return ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE * centroidNo + sizeof(uint32_t);
+    }
+    void release() {
+      if (localDistanceLookup != 0 && !external) {
 	delete[] localDistanceLookup;
-	localDistanceLookup = 0;
 	delete[] scales;
 	delete[] offsets;
       }
-    }
-    void initialize(size_t numOfSubspaces, size_t localCodebookCentroidNo) {
-      size_t alignedNumOfSubvectors = ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
-      size = alignedNumOfSubvectors * localCodebookCentroidNo;
-      localDistanceLookup = new uint8_t[size];
-      scales = new float[alignedNumOfSubvectors];
-      offsets = new float[alignedNumOfSubvectors];
+      localDistanceLookup = 0;
+      external = false;
     }
 
     uint8_t		*localDistanceLookup;
@@ -397,11 +438,42 @@ public:
     float		*scales;
     float		*offsets;
     float		totalOffset;
+    bool		external;
+  };
+
+  // The lookup tables of multiple queries, which are placed in a contiguous memory. The memory is reused
+  // across the batches as long as it is large enough.
+  class DistanceLookupTableArena {
+  public:
+    static const size_t alignment = 64;
+    void initialize(size_t numOfTables, size_t numOfSubspaces, size_t centroidNo) {
+      size_t alignedNumOfSubvectors = ((numOfSubspaces - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
+      size_t lutSize = align(DistanceLookupTableUint8::getByteSize(numOfSubspaces, centroidNo));
+      size_t scaleSize = align(alignedNumOfSubvectors * sizeof(float));
+      size_t tableSize = lutSize + scaleSize * 2;
+      if (memory.size() < numOfTables * tableSize + alignment) {
+	memory.resize(numOfTables * tableSize + alignment);
+      }
+      uint8_t *top = memory.data();
+      top += (alignment - reinterpret_cast<uintptr_t>(top) % alignment) % alignment;
+      tables.resize(numOfTables);
+      for (size_t idx = 0; idx < numOfTables; idx++, top += tableSize) {
+	tables[idx].set(top, reinterpret_cast<float*>(top + lutSize), reinterpret_cast<float*>(top + lutSize + scaleSize),
+			numOfSubspaces, centroidNo);
+      }
+    }
+    DistanceLookupTableUint8 &operator[](size_t idx) { return tables[idx]; }
+    size_t size() { return tables.size(); }
+  protected:
+    static size_t align(size_t s) { return (s + alignment - 1) / alignment * alignment; }
+    std::vector<uint8_t>			memory;
+    std::vector<DistanceLookupTableUint8>	tables;
   };
 
-  QuantizedObjectDistance(){}
+  QuantizedObjectDistance():localCentroids(0), transposedLocalCentroids(0) {}
   virtual ~QuantizedObjectDistance() {
     delete[] localCentroids;
+    delete[] transposedLocalCentroids;
   }
 
   virtual double operator()(NGT::Object &object, size_t objectID, void *localID) = 0;
@@ -410,6 +482,8 @@ public:
 
   virtual void operator()(void *inv, float *distances, size_t size, DistanceLookupTableUint8 &distanceLUT) = 0;
 
+  virtual void getDistancesWithUint8LocalIDs(void *inv, float *distances, size_t size, DistanceLookupTableUint8 &distanceLUT) = 0;
+
   virtual double operator()(NGT::Object &object, size_t objectID, void *localID, DistanceLookupTable &distanceLUT) = 0;
 
   template <typename T>
@@ -644,10 +718,15 @@ public:
 #else 
   inline void createDistanceLookup(NGT::Object &object, size_t objectID, DistanceLookupTable &distanceLUT) {
     assert(globalCodebook != 0);
-    NGT::Object &gcentroid = (NGT::Object &)*globalCodebook->getObjectSpace().getRepository().get(objectID);
+    NGT::PersistentObject &gcentroid = *globalCodebook->getObjectSpace().getRepository().get(objectID);
     size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    void *gcptr = &gcentroid.at(0, globalCodebook->getObjectSpace().getRepository().allocator);
+#else
+    void *gcptr = &gcentroid[0];
+#endif
 
-    createFloatL2DistanceLookup(&((NGT::Object&)object)[0], sizeOfObject, &gcentroid[0], distanceLUT.localDistanceLookup); 
+    createFloatL2DistanceLookup(&((NGT::Object&)object)[0], sizeOfObject, gcptr, distanceLUT.localDistanceLookup); 
 
   }
 #endif 
@@ -707,16 +786,95 @@ public:
 
 
   inline void createDistanceLookup(NGT::Object &object, size_t objectID, DistanceLookupTableUint8 &distanceLUT) {
+    float dlutmp[distanceLUT.size];
+    createDistanceLookup(object, objectID, distanceLUT, dlutmp);
+  }
+
+  // The work area should have the size of the lookup table in floats.
+  inline void createDistanceLookup(NGT::Object &object, size_t objectID, DistanceLookupTableUint8 &distanceLUT, float *work) {
+    float *optr = reinterpret_cast<float*>(&((NGT::Object&)object)[0]);
+    createFloatLookups(&optr, 1, getGlobalCentroid(objectID), work);
+    quantizeLookup(work, distanceLUT);
+  }
+
+  // The lookup tables of the objects are created into the arena. The objects are processed in groups, each of
+  // which shares the local centroids of each subspace on the cache, and the groups are processed in parallel.
+  void createDistanceLookups(std::vector<NGT::Object*> &objects, size_t objectID, DistanceLookupTableArena &arena,
+			     size_t numOfThreads = 0) {
+    const size_t groupSize = 8;
+    if (numOfThreads == 0) {
+      numOfThreads = omp_get_max_threads();
+    }
+    arena.initialize(objects.size(), localCodebookNo, localCodebookCentroidNo);
+    if (objects.empty()) {
+      return;
+    }
+    float *gcptr = getGlobalCentroid(objectID);
+    size_t tableSize = arena[0].size;
+    size_t numOfGroups = (objects.size() + groupSize - 1) / groupSize;
+#pragma omp parallel num_threads(numOfThreads)
+    {
+      std::vector<float> work(groupSize * tableSize);
+      std::vector<float*> optrs(groupSize);
+#pragma omp for schedule(dynamic)
+      for (size_t gidx = 0; gidx < numOfGroups; gidx++) {
+	size_t begin = gidx * groupSize;
+	size_t n = std::min(groupSize, objects.size() - begin);
+	for (size_t idx = 0; idx < n; idx++) {
+	  optrs[idx] = reinterpret_cast<float*>(&(*objects[begin + idx])[0]);
+	}
+	createFloatLookups(optrs.data(), n, gcptr, work.data(), tableSize);
+	for (size_t idx = 0; idx < n; idx++) {
+	  quantizeLookup(work.data() + idx * tableSize, arena[begin + idx]);
+	}
+      }
+    }
+  }
+
+  float *getGlobalCentroid(size_t objectID) {
     assert(globalCodebook != 0);
-    NGT::Object &gcentroid = (NGT::Object &)*globalCodebook->getObjectSpace().getRepository().get(objectID);
-    size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
+    NGT::PersistentObject &gcentroid = *globalCodebook->getObjectSpace().getRepository().get(objectID);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    return reinterpret_cast<float*>(&gcentroid.at(0, globalCodebook->getObjectSpace().getRepository().allocator));
+#else
+    return reinterpret_cast<float*>(&gcentroid[0]);
+#endif
+  }
 
-    float dlutmp[distanceLUT.size];
+  // The float lookup tables of the objects are created with the transposed local centroids, so that the
+  // innermost loop over the centroids is vectorized. The tables are placed at intervals of the stride.
+  void createFloatLookups(float **objects, size_t numOfObjects, float *gcptr, float *luts, size_t stride = 0) {
+    size_t centroidNo = localCodebookCentroidNo;
+    for (size_t li = 0; li < localCodebookNo; li++) {
+      const float *lcptr = transposedLocalCentroids + li * localDataSize * centroidNo;
+      size_t oft = li * localDataSize;
+      for (size_t oidx = 0; oidx < numOfObjects; oidx++) {
+	float *lut = luts + oidx * stride + li * centroidNo;
+	const float *optr = objects[oidx] + oft;
+	for (size_t k = 0; k < centroidNo; k++) {
+	  lut[k] = 0.0;
+	}
+	for (size_t d = 0; d < localDataSize; d++) {
+	  const float *lc = lcptr + d * centroidNo;
 #ifdef NGTQG_DOT_PRODUCT
-    createFloatDotProductLookup(&((NGT::Object&)object)[0], sizeOfObject, &gcentroid[0], dlutmp);
+	  float o = optr[d];
+	  float g = gcptr[oft + d];
+	  for (size_t k = 0; k < centroidNo; k++) {
+	    lut[k] += o * (lc[k] + g);
+	  }
 #else
-    createFloatL2DistanceLookup(&((NGT::Object&)object)[0], sizeOfObject, &gcentroid[0], dlutmp);
+	  float r = optr[d] - gcptr[oft + d];
+	  for (size_t k = 0; k < centroidNo; k++) {
+	    float sub = r - lc[k];
+	    lut[k] += sub * sub;
+	  }
 #endif
+	}
+      }
+    }
+  }
+
+  void quantizeLookup(float *dlutmp, DistanceLookupTableUint8 &distanceLUT) {
     {
       uint8_t *cdlu = distanceLUT.localDistanceLookup;
       float *dlu = dlutmp;
@@ -725,12 +883,8 @@ public:
       float max = -FLT_MAX;
       for (size_t li = 0; li < localCodebookNo; li++) {    
 	for (size_t k = 1; k < localCodebookCentroidNo; k++) {
-	  if (dlu[k] > max) {
-	    max = dlu[k];
-	  }
-	  if (dlu[k] < min) {
-	    min = dlu[k];
-	  }
+	  max = std::max(max, dlu[k]);
+	  min = std::min(min, dlu[k]);
 	}
 	dlu += localCodebookCentroidNo;
       }
@@ -738,11 +892,13 @@ public:
       float scale = (max - min) / 255.0;
       dlu = dlutmp;
       for (size_t li = 0; li < localCodebookNo; li++) {
+	// since the values are not negative, the values are rounded by the truncation to be vectorized.
 	for (size_t k = 1; k < localCodebookCentroidNo; k++) {
-	  int32_t tmp = std::round((dlu[k] - offset) / scale);
+	  int32_t tmp = static_cast<int32_t>((dlu[k] - offset) / scale + 0.5f);
 	  assert(tmp >= 0 && tmp <= 255);
-	  *cdlu++ = static_cast<uint8_t>(tmp);
+	  cdlu[k - 1] = static_cast<uint8_t>(tmp);
 	}
+	cdlu += localCodebookCentroidNo - 1;
 	dlu += localCodebookCentroidNo;
 	distanceLUT.offsets[li] = offset;
 	distanceLUT.scales[li] = scale;
@@ -784,6 +940,18 @@ public:
 
     localCentroids = lc;
 
+    // the centroids of each subspace are transposed into the dimensions of the centroids.
+    float *tlc = new float[localCodebookNo * localCodebookCentroidNo * localDataSize]();
+    for (size_t li = 0; li < localCodebookNo; li++) {
+      for (size_t k = 1; k < localCodebookCentroidNo; k++) {
+	for (size_t d = 0; d < localDataSize; d++) {
+	  tlc[(li * localDataSize + d) * localCodebookCentroidNo + k] = lc[(li * localCodebookCentroidNo + k) * localDataSize + d];
+	}
+      }
+    }
+    delete[] transposedLocalCentroids;
+    transposedLocalCentroids = tlc;
+
 
 
   }
@@ -811,6 +979,7 @@ public:
   size_t	sizeOfType;
 
   float		*localCentroids;	
+  float		*transposedLocalCentroids;
 
   size_t	localCodebookCentroidNoSIMD;
 
@@ -902,6 +1071,10 @@ public:
     cerr << "operator is not implemented" << endl;
     abort();
   }
+  inline void getDistancesWithUint8LocalIDs(void *inv, float *distances, size_t size, DistanceLookupTableUint8 &distanceLUT) {
+    cerr << "getDistancesWithUint8LocalIDs is not implemented" << endl;
+    abort();
+  }
 #endif // NGTQ_DISTANCE_ANGLE
 
 };
@@ -1095,6 +1268,85 @@ public:
   }
 #endif 
 
+  // The local IDs of up to 256 local centroids are not packed unlike the 4-bit local IDs. Since the lookup table
+  // of a subspace does not fit in a register, the entries are gathered with the local IDs and summed in 32 bits.
+  inline void getDistancesWithUint8LocalIDs(void *inv, float *distances, size_t size, DistanceLookupTableUint8 &distanceLUT) {
+    uint8_t *localID = static_cast<uint8_t*>(inv);
+    size_t alignedNumOfSubvectors = ((localDivisionNo - 1) / NGTQ_BATCH_SIZE + 1) * NGTQ_BATCH_SIZE;
+    size_t lutSize = localCodebookCentroidNo - 1;
+    auto *last = localID + ((size + NGTQ_SIMD_BLOCK_SIZE - 1) / NGTQ_SIMD_BLOCK_SIZE) * NGTQ_SIMD_BLOCK_SIZE * alignedNumOfSubvectors;
+    float *d = distances;
+#if defined(NGTQG_AVX512)
+    const __m512i mask512xFF = _mm512_set1_epi32(0xff);
+    const __m512 scale = _mm512_set1_ps(distanceLUT.scales[0]);
+    const __m512 offset = _mm512_set1_ps(distanceLUT.totalOffset);
+    while (localID < last) {
+      uint8_t *lut = distanceLUT.localDistanceLookup;
+      __m512i depu32 = _mm512_setzero_si512();
+      for (size_t li = 0; li < alignedNumOfSubvectors; li++) {
+	_mm_prefetch(&localID[0] + 64 * 8, _MM_HINT_T0);
+	__m512i obj = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i const*)&localID[0]));
+	__m512i vtmp = _mm512_i32gather_epi32(obj, lut, 1);
+	depu32 = _mm512_add_epi32(depu32, _mm512_and_si512(vtmp, mask512xFF));
+	lut += lutSize;
+	localID += NGTQ_SIMD_BLOCK_SIZE;
+      }
+      __m512 distance = _mm512_add_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(depu32), scale), offset);
+#if defined(NGTQG_DOT_PRODUCT)
+      distance = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(1.0), distance), _mm512_set1_ps(2.0));
+#endif
+      _mm512_storeu_ps(d, _mm512_sqrt_ps(distance));
+      d += NGTQ_SIMD_BLOCK_SIZE;
+    }
+#elif defined(NGTQG_AVX2)
+    const __m256i mask256xFF = _mm256_set1_epi32(0xff);
+    const __m256 scale = _mm256_set1_ps(distanceLUT.scales[0]);
+    const __m256 offset = _mm256_set1_ps(distanceLUT.totalOffset);
+    while (localID < last) {
+      uint8_t *lut = distanceLUT.localDistanceLookup;
+      __m256i depu32l = _mm256_setzero_si256();
+      __m256i depu32h = _mm256_setzero_si256();
+      for (size_t li = 0; li < alignedNumOfSubvectors; li++) {
+	_mm_prefetch(&localID[0] + 64 * 8, _MM_HINT_T0);
+	__m256i objl = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)&localID[0]));
+	__m256i objh = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)&localID[8]));
+	__m256i vtmpl = _mm256_i32gather_epi32(reinterpret_cast<int const*>(lut), objl, 1);
+	__m256i vtmph = _mm256_i32gather_epi32(reinterpret_cast<int const*>(lut), objh, 1);
+	depu32l = _mm256_add_epi32(depu32l, _mm256_and_si256(vtmpl, mask256xFF));
+	depu32h = _mm256_add_epi32(depu32h, _mm256_and_si256(vtmph, mask256xFF));
+	lut += lutSize;
+	localID += NGTQ_SIMD_BLOCK_SIZE;
+      }
+      __m256 distancel = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(depu32l), scale), offset);
+      __m256 distanceh = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(depu32h), scale), offset);
+#if defined(NGTQG_DOT_PRODUCT)
+      distancel = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0), distancel), _mm256_set1_ps(2.0));
+      distanceh = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0), distanceh), _mm256_set1_ps(2.0));
+#endif
+      _mm256_storeu_ps(d, _mm256_sqrt_ps(distancel));
+      _mm256_storeu_ps(d + 8, _mm256_sqrt_ps(distanceh));
+      d += NGTQ_SIMD_BLOCK_SIZE;
+    }
+#else
+    uint32_t dtmp[NGTQ_SIMD_BLOCK_SIZE];
+    while (localID < last) {
+      uint8_t *lut = distanceLUT.localDistanceLookup;
+      memset(dtmp, 0, sizeof(uint32_t) * NGTQ_SIMD_BLOCK_SIZE);
+      for (size_t li = 0; li < alignedNumOfSubvectors; li++) {
+	for (size_t i = 0; i < NGTQ_SIMD_BLOCK_SIZE; i++) {
+	  dtmp[i] += lut[localID[i]];
+	}
+	lut += lutSize;
+	localID += NGTQ_SIMD_BLOCK_SIZE;
+      }
+      for (size_t i = 0; i < NGTQ_SIMD_BLOCK_SIZE; i++) {
+	d[i] = sqrt(static_cast<float>(dtmp[i]) * distanceLUT.scales[0] + distanceLUT.totalOffset);
+      }
+      d += NGTQ_SIMD_BLOCK_SIZE;
+    }
+#endif
+  }
+
 
   inline double operator()(NGT::Object &object, size_t objectID, void *l) {
     return getL2DistanceFloat(object, objectID, static_cast<T*>(l));
@@ -1156,6 +1408,230 @@ public:
 };
 
 
+// Rotation keeps an orthonormal matrix which is applied to objects before quantization.
+// The matrix is trained with the eigenvalue allocation of the parametric OPQ so that
+// the variances of the subspaces are balanced.
+class Rotation {
+public:
+  Rotation(): dimension(0), paddedDimension(0) {}
+
+  bool isEmpty() { return matrix.empty(); }
+
+  void clear() {
+    matrix.clear();
+    dimension = 0;
+    paddedDimension = 0;
+  }
+
+  void train(const std::vector<std::vector<float>> &samples, size_t numOfSubspaces, RotationType type) {
+    if (samples.empty()) {
+      NGTThrowException("NGTQ::Rotation::train: No samples.");
+    }
+    size_t dim = samples[0].size();
+    if (numOfSubspaces == 0 || dim % numOfSubspaces != 0) {
+      stringstream msg;
+      msg << "NGTQ::Rotation::train: The dimension is not a multiple of the number of subspaces. " << dim << ":" << numOfSubspaces;
+      NGTThrowException(msg);
+    }
+    std::vector<double> mean(dim, 0.0);
+    for (auto &s : samples) {
+      for (size_t i = 0; i < dim; i++) {
+	mean[i] += s[i];
+      }
+    }
+    for (size_t i = 0; i < dim; i++) {
+      mean[i] /= samples.size();
+    }
+    std::vector<double> eigenvalues(dim, 0.0);
+    std::vector<double> eigenvectors(dim * dim, 0.0);
+    if (type == RotationTypePermutation) {
+      for (auto &s : samples) {
+	for (size_t i = 0; i < dim; i++) {
+	  double d = s[i] - mean[i];
+	  eigenvalues[i] += d * d;
+	}
+      }
+      for (size_t i = 0; i < dim; i++) {
+	eigenvectors[i * dim + i] = 1.0;
+      }
+    } else if (type == RotationTypeRotation) {
+      std::vector<double> covariance(dim * dim, 0.0);
+      std::vector<double> d(dim);
+      for (auto &s : samples) {
+	for (size_t i = 0; i < dim; i++) {
+	  d[i] = s[i] - mean[i];
+	}
+	for (size_t i = 0; i < dim; i++) {
+	  for (size_t j = i; j < dim; j++) {
+	    covariance[i * dim + j] += d[i] * d[j];
+	  }
+	}
+      }
+      for (size_t i = 0; i < dim; i++) {
+	for (size_t j = 0; j < i; j++) {
+	  covariance[i * dim + j] = covariance[j * dim + i];
+	}
+      }
+      eigen(covariance, dim, eigenvectors);
+      for (size_t i = 0; i < dim; i++) {
+	eigenvalues[i] = covariance[i * dim + i];
+      }
+    } else {
+      stringstream msg;
+      msg << "NGTQ::Rotation::train: Invalid rotation type. " << type;
+      NGTThrowException(msg);
+    }
+    for (auto &e : eigenvalues) {
+      e /= samples.size();
+    }
+
+    // allocate the eigenvectors to the subspaces so that the products of the eigenvalues are balanced.
+    std::vector<size_t> order(dim);
+    for (size_t i = 0; i < dim; i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&eigenvalues](size_t a, size_t b) { return eigenvalues[a] > eigenvalues[b]; });
+    double epsilon = std::max(eigenvalues[order[0]], 0.0) * 1.0e-12 + std::numeric_limits<double>::min();
+    size_t subspaceDimension = dim / numOfSubspaces;
+    std::vector<std::vector<size_t>> subspaces(numOfSubspaces);
+    std::vector<double> logProducts(numOfSubspaces, 0.0);
+    for (auto e : order) {
+      size_t target = numOfSubspaces;
+      for (size_t si = 0; si < numOfSubspaces; si++) {
+	if (subspaces[si].size() >= subspaceDimension) {
+	  continue;
+	}
+	if (subspaces[si].empty()) {
+	  target = si;
+	  break;
+	}
+	if (target == numOfSubspaces || logProducts[si] < logProducts[target]) {
+	  target = si;
+	}
+      }
+      subspaces[target].push_back(e);
+      logProducts[target] += log(std::max(eigenvalues[e], epsilon));
+    }
+
+    dimension = dim;
+    paddedDimension = ((dimension + 15) / 16) * 16;
+    matrix.assign(dimension * paddedDimension, 0.0);
+    size_t row = 0;
+    for (auto &subspace : subspaces) {
+      for (auto e : subspace) {
+	for (size_t i = 0; i < dimension; i++) {
+	  matrix[row * paddedDimension + i] = eigenvectors[i * dimension + e];
+	}
+	row++;
+      }
+    }
+  }
+
+  // src and dst must not be the same.
+  void rotate(const float *src, float *dst) {
+    std::vector<float> vector(paddedDimension, 0.0);
+    memcpy(vector.data(), src, sizeof(float) * dimension);
+    for (size_t i = 0; i < dimension; i++) {
+      dst[i] = NGT::PrimitiveComparator::compareDotProduct(&matrix[i * paddedDimension], vector.data(), paddedDimension);
+    }
+  }
+
+  void rotate(float *object) {
+    std::vector<float> vector(object, object + dimension);
+    rotate(vector.data(), object);
+  }
+
+  void save(const string &file) {
+    ofstream os(file, ios::out | ios::binary);
+    if (!os) {
+      NGTThrowException("NGTQ::Rotation::save: Cannot open the file. " + file);
+    }
+    std::vector<float> m(dimension * dimension);
+    for (size_t i = 0; i < dimension; i++) {
+      memcpy(&m[i * dimension], &matrix[i * paddedDimension], sizeof(float) * dimension);
+    }
+    NGT::Serializer::write(os, static_cast<uint64_t>(dimension));
+    NGT::Serializer::write(os, m);
+  }
+
+  void load(const string &file) {
+    ifstream is(file, ios::in | ios::binary);
+    if (!is) {
+      NGTThrowException("NGTQ::Rotation::load: Cannot open the file. " + file);
+    }
+    uint64_t dim;
+    std::vector<float> m;
+    NGT::Serializer::read(is, dim);
+    NGT::Serializer::read(is, m);
+    if (m.size() != dim * dim) {
+      stringstream msg;
+      msg << "NGTQ::Rotation::load: The matrix is broken. " << m.size() << ":" << dim;
+      NGTThrowException(msg);
+    }
+    dimension = dim;
+    paddedDimension = ((dimension + 15) / 16) * 16;
+    matrix.assign(dimension * paddedDimension, 0.0);
+    for (size_t i = 0; i < dimension; i++) {
+      memcpy(&matrix[i * paddedDimension], &m[i * dimension], sizeof(float) * dimension);
+    }
+  }
+
+  // the eigenvalues are left on the diagonal of the matrix with the cyclic Jacobi method.
+  static void eigen(std::vector<double> &a, size_t n, std::vector<double> &v) {
+    v.assign(n * n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+      v[i * n + i] = 1.0;
+    }
+    for (size_t sweep = 0; sweep < 100; sweep++) {
+      double off = 0.0;
+      double diagonal = 0.0;
+      for (size_t p = 0; p < n; p++) {
+	diagonal += a[p * n + p] * a[p * n + p];
+	for (size_t q = p + 1; q < n; q++) {
+	  off += a[p * n + q] * a[p * n + q];
+	}
+      }
+      if (off <= diagonal * 1.0e-24 || off == 0.0) {
+	break;
+      }
+      for (size_t p = 0; p < n; p++) {
+	for (size_t q = p + 1; q < n; q++) {
+	  double apq = a[p * n + q];
+	  if (apq == 0.0) {
+	    continue;
+	  }
+	  double theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+	  double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+	  double c = 1.0 / sqrt(t * t + 1.0);
+	  double s = t * c;
+	  for (size_t k = 0; k < n; k++) {
+	    double akp = a[k * n + p];
+	    double akq = a[k * n + q];
+	    a[k * n + p] = c * akp - s * akq;
+	    a[k * n + q] = s * akp + c * akq;
+	  }
+	  for (size_t k = 0; k < n; k++) {
+	    double apk = a[p * n + k];
+	    double aqk = a[q * n + k];
+	    a[p * n + k] = c * apk - s * aqk;
+	    a[q * n + k] = s * apk + c * aqk;
+	  }
+	  for (size_t k = 0; k < n; k++) {
+	    double vkp = v[k * n + p];
+	    double vkq = v[k * n + q];
+	    v[k * n + p] = c * vkp - s * vkq;
+	    v[k * n + q] = s * vkp + c * vkq;
+	  }
+	}
+      }
+    }
+  }
+
+  std::vector<float>	matrix;		// row major and each row is padded for SIMD
+  size_t		dimension;
+  size_t		paddedDimension;
+};
+
 class Quantizer {
 public:
   typedef ArrayFile<NGT::Object>	ObjectList;	
@@ -1197,6 +1673,9 @@ public:
 
   virtual void extractInvertedIndexObject(InvertedIndexEntry<uint16_t> &invertedIndexObjects) = 0;
   virtual void extractInvertedIndex(std::vector<std::vector<uint32_t>> &invertedIndex) = 0;
+  virtual void extractLocalIDs(std::vector<uint16_t> &localIDs) = 0;
+  virtual void extractLocalIDs(const std::vector<uint32_t> &ids, std::vector<uint16_t> &localIDs) = 0;
+  virtual void completeLocalCodebooks() = 0;
 
   virtual NGT::Distance getApproximateDistance(NGT::Object &query, uint32_t globalID, uint16_t *localID, QuantizedObjectDistance::DistanceLookupTable &distanceLUT) { abort(); }
 
@@ -1250,6 +1729,11 @@ public:
 
   virtual QuantizedObjectDistance &getQuantizedObjectDistance() = 0;
 
+  void trainRotation(const std::vector<std::vector<float>> &samples) {
+    rotation.train(samples, property.localDivisionNo, property.rotationType);
+    rotation.save(rootDirectory + "/rot");
+  }
+
   ObjectList	objectList;
   string	rootDirectory;
 
@@ -1257,6 +1741,8 @@ public:
 
   NGT::Index	globalCodebook;
 
+  Rotation	rotation;
+
   size_t	distanceComputationCount;
 
   size_t	localIDByteSize;
@@ -1293,13 +1779,9 @@ class QuantizedObjectProcessingStream {
   }
 
   void arrangeQuantizedObject(size_t dataNo, size_t subvectorNo, uint8_t quantizedObject) {
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-    abort();
-#else
     size_t blkNo = dataNo / NGTQ_SIMD_BLOCK_SIZE;	
     size_t oft = dataNo - blkNo * NGTQ_SIMD_BLOCK_SIZE;	
     stream[blkNo * alignedBlockSize + NGTQ_SIMD_BLOCK_SIZE * subvectorNo + oft] = quantizedObject;
-#endif
   }
 
   uint8_t* compressIntoUint4() {
@@ -1348,12 +1830,43 @@ class QuantizedObjectProcessingStream {
   size_t	alignedNumOfObjects;
   size_t	streamSize;
 };
+
+// The inverted list for the fast scan. The local IDs of the objects are arranged into the blocks in the same way as
+// the quantized graph, so that the distances of all of the objects in a block are computed at once with the lookup
+// table of 8-bit distances. The local IDs are packed into 4 bits when the number of the local centroids is 16.
+class FastScanInvertedList {
+ public:
+  FastScanInvertedList():uint4(false) {}
+
+  std::vector<uint32_t>		ids;
+  // the positions of the objects which are identical to the global centroid.
+  std::vector<uint32_t>		identicalObjects;
+  std::unique_ptr<uint8_t[]>	codes;
+  bool				uint4;
+};
  
+// The residual objects of an object are placed from the specified position of the local objects, which
+// should be allocated in advance, so that the residual objects of multiple objects are generated in parallel.
+// When the local codebook is single, the residual objects of all of the subvectors are placed in order.
 class GenerateResidualObject {
 public:
   virtual ~GenerateResidualObject() {}
-  virtual void operator()(size_t objectID, size_t centroidID, 
-			  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) = 0;
+  virtual void operator()(NGT::Object &object, size_t centroidID,
+			  vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) = 0;
+
+  void operator()(size_t objectID, size_t centroidID, 
+		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+    NGT::Object object(&globalCodebook->getObjectSpace());
+    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
+    size_t position = localObjs[0].size();
+    for (size_t li = 0; li < localCodebookNo; li++) {
+      localObjs[li].resize(position + getNumberOfResidualObjects());
+    }
+    (*this)(object, centroidID, localObjs, position);
+  }
+
+  // the number of the residual objects for each of the local codebooks.
+  size_t getNumberOfResidualObjects() { return localCodebookNo == 1 ? divisionNo : 1; }
 
   void set(NGT::Index &gc, NGT::Index lc[], size_t dn, size_t lcn,
 	   Quantizer::ObjectList *ol) {
@@ -1379,11 +1892,10 @@ public:
 
 class GenerateResidualObjectUint8 : public GenerateResidualObject {
 public:
-  void operator()(size_t objectID, size_t centroidID, 
-		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+  using GenerateResidualObject::operator();
+  void operator()(NGT::Object &object, size_t centroidID,
+		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) {
     NGT::PersistentObject &globalCentroid = *globalCodebook->getObjectSpace().getRepository().get(centroidID);
-    NGT::Object object(&globalCodebook->getObjectSpace());
-    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
     size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
     size_t lsize = sizeOfObject / divisionNo;
     for (size_t di = 0; di < divisionNo; di++) {
@@ -1399,18 +1911,17 @@ public:
       }
       size_t idx = localCodebookNo == 1 ? 0 : di;
       NGT::Object *localObj = localCodebook[idx]->allocateObject(subObject);
-      localObjs[idx].push_back(pair<NGT::Object*, size_t>(localObj, 0));
+      localObjs[idx][position + (localCodebookNo == 1 ? di : 0)] = pair<NGT::Object*, size_t>(localObj, 0);
     }
   }
 };
 
 class GenerateResidualObjectFloat : public GenerateResidualObject {
 public:
-  void operator()(size_t objectID, size_t centroidID, 
-		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+  using GenerateResidualObject::operator();
+  void operator()(NGT::Object &object, size_t centroidID,
+		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) {
     NGT::PersistentObject &globalCentroid = *globalCodebook->getObjectSpace().getRepository().get(centroidID);
-    NGT::Object object(&globalCodebook->getObjectSpace());
-    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
     size_t byteSizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
     size_t localByteSize = byteSizeOfObject / divisionNo;
     size_t localDimension = localByteSize / sizeof(float);
@@ -1429,7 +1940,7 @@ public:
       }
       size_t idx = localCodebookNo == 1 ? 0 : di;
       NGT::Object *localObj = localCodebook[idx]->allocateObject(subObject);
-      localObjs[idx].push_back(pair<NGT::Object*, size_t>(localObj, 0));
+      localObjs[idx][position + (localCodebookNo == 1 ? di : 0)] = pair<NGT::Object*, size_t>(localObj, 0);
     }
   }
 };
@@ -1450,6 +1961,7 @@ public:
     property.localDivisionNo = nCodebooks;
     quantizedObjectDistance = 0;
     generateResidualObject = 0;
+    fastScanInvertedIndexBuilt = false;
   }
 
   virtual ~QuantizerInstance() { close(); }
@@ -1539,6 +2051,13 @@ public:
     invertedIndex.deserialize(ifs);
 #endif
     objectList.open(index + "/obj");
+    rotation.clear();
+    if (property.rotationType != RotationTypeNone) {
+      ifstream rotationFile(index + "/rot");
+      if (rotationFile) {
+	rotation.load(index + "/rot");
+      }
+    }
     NGT::Property globalProperty;
     globalCodebook.getProperty(globalProperty);
     size_t sizeoftype = 0;
@@ -1613,6 +2132,7 @@ public:
 #ifndef NGTQ_SHARED_INVERTED_INDEX
     invertedIndex.deleteAll();
 #endif
+    clearFastScanInvertedIndex();
   }
 
 #ifdef NGTQ_SHARED_INVERTED_INDEX
@@ -1679,12 +2199,14 @@ public:
 		   size_t centroidLimit,
 		   const vector<pair<NGT::Object*, size_t> > &objects, 
 		   vector<NGT::Index::InsertionResult> &ids, 
-		   float &range)
+		   float &range,
+		   size_t threadSize = 0)
   {
+    threadSize = threadSize == 0 ? property.threadSize : threadSize;
     if (centroidLimit > 0) {
       if (getNumberOfObjects(codebook) >= centroidLimit) {
 	range = FLT_MAX;
-	codebook.createIndex(objects, ids, range, property.threadSize);
+	codebook.createIndex(objects, ids, range, threadSize);
       } else if (getNumberOfObjects(codebook) + objects.size() > centroidLimit) {
 	auto start = objects.begin();
 	do {
@@ -1698,7 +2220,7 @@ public:
 	  vector<NGT::Index::InsertionResult> idstmp;
 	  vector<pair<NGT::Object*, size_t> > objtmp;
 	  std::copy(start, end, std::back_inserter(objtmp));
-	  codebook.createIndex(objtmp, idstmp, range, property.threadSize);
+	  codebook.createIndex(objtmp, idstmp, range, threadSize);
 	  assert(idstmp.size() == objtmp.size());
 	  std::copy(idstmp.begin(), idstmp.end(), std::back_inserter(ids));
 	  start = end;
@@ -1707,14 +2229,14 @@ public:
 	vector<NGT::Index::InsertionResult> idstmp;
 	vector<pair<NGT::Object*, size_t> > objtmp;
 	std::copy(start, objects.end(), std::back_inserter(objtmp));
-	codebook.createIndex(objtmp, idstmp, range, property.threadSize);
+	codebook.createIndex(objtmp, idstmp, range, threadSize);
 	std::copy(idstmp.begin(), idstmp.end(), std::back_inserter(ids));
 	assert(ids.size() == objects.size());
       } else {
-	codebook.createIndex(objects, ids, range, property.threadSize);
+	codebook.createIndex(objects, ids, range, threadSize);
       }
     } else {
-      codebook.createIndex(objects, ids, range, property.threadSize);
+      codebook.createIndex(objects, ids, range, threadSize);
     }
   }
 
@@ -1800,45 +2322,68 @@ public:
     }
   }
 
+  // Since the local codebooks are independent of each other, the threads are assigned to the local codebooks
+  // first, and the rest of the threads are used to insert the residual objects into each of the codebooks.
   bool setMultipleLocalCodeToInvertedIndexEntry(vector<NGT::GraphAndTreeIndex*> &lcodebook, vector<LocalDatam> &localData, vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
     size_t localCodebookNo = property.getLocalCodebookNo();
-    bool localCodebookFull = true;  
+    size_t threadSize = property.threadSize == 0 ? 1 : property.threadSize;
+    size_t numOfThreads = std::min(threadSize, localCodebookNo);
+    size_t innerThreadSize = std::max(threadSize / numOfThreads, static_cast<size_t>(1));
+    vector<uint8_t> full(localCodebookNo, 1);
+    vector<string> errors(localCodebookNo);
+#pragma omp parallel for schedule(dynamic) num_threads(numOfThreads)
     for (size_t li = 0; li < localCodebookNo; ++li) {
-      float lr = property.localRange;
-      size_t localCentroidLimit = property.localCentroidLimit;
-      if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
-	localCentroidLimit *= property.localClusteringSampleCoefficient;
+      try {
+	full[li] = setLocalCodeToInvertedIndexEntry(*lcodebook[li], li, localData, localObjs[li], innerThreadSize);
+      } catch(NGT::Exception &err) {
+	errors[li] = err.what();
       }
-      if (property.localCodebookState) {
-	lr = FLT_MAX;	
-	localCentroidLimit = 0;
-      } else {
-	if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
-	  lr = -1.0;
-	}
+    }
+    for (auto i = errors.begin(); i != errors.end(); ++i) {
+      if (!(*i).empty()) {
+	NGTThrowException(*i);
       }
-      vector<NGT::Index::InsertionResult> lids;
-      createIndex(*lcodebook[li], localCentroidLimit, localObjs[li], lids, lr);
-      if (lr != FLT_MAX) { 
-	localCodebookFull = false;
+    }
+    return std::find(full.begin(), full.end(), 0) == full.end();
+  }
+
+  bool setLocalCodeToInvertedIndexEntry(NGT::GraphAndTreeIndex &lcodebook, size_t li, vector<LocalDatam> &localData,
+					vector<pair<NGT::Object*, size_t> > &localObjs, size_t threadSize) {
+    bool localCodebookFull = true;
+    float lr = property.localRange;
+    size_t localCentroidLimit = property.localCentroidLimit;
+    if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
+      localCentroidLimit *= property.localClusteringSampleCoefficient;
+    }
+    if (property.localCodebookState) {
+      lr = FLT_MAX;	
+      localCentroidLimit = 0;
+    } else {
+      if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
+	lr = -1.0;
       }
-      assert(localData.size() == lids.size());
-      for (size_t i = 0; i < localData.size(); i++) {
-	size_t id = lids[i].id;
-	assert(!property.localCodebookState || id <= ((1UL << (sizeof(LOCAL_ID_TYPE) * 8)) - 1)); 
+    }
+    vector<NGT::Index::InsertionResult> lids;
+    createIndex(lcodebook, localCentroidLimit, localObjs, lids, lr, threadSize);
+    if (lr != FLT_MAX) { 
+      localCodebookFull = false;
+    }
+    assert(localData.size() == lids.size());
+    for (size_t i = 0; i < localData.size(); i++) {
+      size_t id = lids[i].id;
+      assert(!property.localCodebookState || id <= ((1UL << (sizeof(LOCAL_ID_TYPE) * 8)) - 1)); 
 #ifdef NGTQ_SHARED_INVERTED_INDEX
-	(*invertedIndex.at(localData[i].iiIdx)).at(localData[i].iiLocalIdx, invertedIndex.allocator).localID[li] = id;
+      (*invertedIndex.at(localData[i].iiIdx)).at(localData[i].iiLocalIdx, invertedIndex.allocator).localID[li] = id;
 #else
-	(*invertedIndex.at(localData[i].iiIdx))[localData[i].iiLocalIdx].localID[li] = id;
+      (*invertedIndex.at(localData[i].iiIdx))[localData[i].iiLocalIdx].localID[li] = id;
 #endif
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-	localCodebook[li].deleteObject(localObjs[li][i].first);
+      localCodebook[li].deleteObject(localObjs[i].first);
 #else
-	if (lids[i].identical) {
-	  localCodebook[li].deleteObject(localObjs[li][i].first);
-	}
+      if (lids[i].identical) {
+	localCodebook[li].deleteObject(localObjs[i].first);
+      }
 #endif
-      } 
     } 
     return localCodebookFull;
   }
@@ -1850,6 +2395,19 @@ public:
     clustering.epsilonStep = 0.05;
     clustering.maximumIteration = 20;
     for (size_t li = 0; li < localCodebookNo; ++li) {
+      if (localCodebook[li].getObjectRepositorySize() <= numberOfCentroids + 1) {
+	// the samples of the subvector are already within the number of the centroids.
+	continue;
+      }
+      std::vector<std::vector<float>> samples;
+      getDistinctSamples(localCodebook[li], samples);
+      if (samples.size() <= numberOfCentroids) {
+	// since k-means cannot fill all of the clusters, the distinct samples are the centroids instead. The
+	// last sample is repeated, because all of the local codebooks should have the same number of the centroids.
+	samples.resize(numberOfCentroids, samples.back());
+	rebuildLocalCodebook(localCodebook[li], samples);
+	continue;
+      }
       double diff = clustering.kmeansWithNGT(localCodebook[li], numberOfCentroids);
       if (diff > 0.0) {
 	cerr << "Not converge. " << diff << endl;
@@ -1858,6 +2416,92 @@ public:
     }
   }
 
+  void getDistinctSamples(NGT::Index &codebook, std::vector<std::vector<float>> &samples) {
+    NGT::ObjectSpace &objectSpace = codebook.getObjectSpace();
+    size_t size = objectSpace.getRepository().size();
+    for (size_t id = 1; id < size; id++) {
+      std::vector<float> sample;
+      try {
+	objectSpace.getObject(id, sample);
+      } catch(...) {
+	continue;
+      }
+      samples.push_back(sample);
+    }
+    std::sort(samples.begin(), samples.end());
+    samples.erase(std::unique(samples.begin(), samples.end()), samples.end());
+  }
+
+  void rebuildLocalCodebook(NGT::Index &codebook, std::vector<std::vector<float>> &centroids) {
+    NGT::Property prop;
+    codebook.getProperty(prop);
+    std::string path = codebook.getPath();
+    codebook.close();
+    NGT::Index::destroy(path);
+    NGT::Index::createGraphAndTree(path, prop);
+    codebook.open(path);
+    for (auto &centroid : centroids) {
+      codebook.insert(centroid);
+    }
+    codebook.createIndex(property.threadSize == 0 ? 1 : property.threadSize);
+  }
+
+  void buildMultipleLocalCodebooksWithKmeans() {
+    size_t localCodebookNo = property.getLocalCodebookNo();
+    buildMultipleLocalCodebooks(localCodebook.data(), localCodebookNo, property.localCentroidLimit);
+    (*generateResidualObject).set(localCodebook.data(), localCodebookNo);
+    property.localCodebookState = true;	
+    replaceInvertedIndexEntry(localCodebookNo);
+  }
+
+  // The local codebooks with k-means are built after the number of the samples reaches the local centroid limit
+  // multiplied by the sample coefficient. When all of the objects have been inserted before that, the local
+  // codebooks are built with the samples so far, unless the samples are within the limit.
+  void completeLocalCodebooks() {
+    if (property.localCodebookState || property.singleLocalCodebook ||
+	property.localCentroidCreationMode != CentroidCreationModeDynamicKmeans) {
+      return;
+    }
+    bool overLimit = false;
+    for (size_t li = 0; li < localCodebook.size(); li++) {
+      overLimit = overLimit || localCodebook[li].getObjectRepositorySize() > property.localCentroidLimit + 1;
+    }
+    if (!overLimit) {
+      // the samples themselves are the centroids, to which the objects inserted later are assigned.
+      if (!localCodebook.empty() && localCodebook[0].getObjectRepositorySize() > 1) {
+	property.localCodebookState = true;
+      }
+      return;
+    }
+    buildMultipleLocalCodebooksWithKmeans();
+  }
+
+  // The residual objects of the specified objects, which correspond to the local data from the specified
+  // position, are appended to the local objects with multiple threads.
+  void generateResidualObjects(vector<LocalDatam> &localData, size_t start, vector<NGT::Object*> &objects,
+			       vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+    size_t stride = (*generateResidualObject).getNumberOfResidualObjects();
+    size_t position = localObjs[0].size();
+    for (size_t li = 0; li < localObjs.size(); li++) {
+      localObjs[li].resize(position + objects.size() * stride);
+    }
+    vector<string> errors(objects.size());
+#pragma omp parallel for num_threads(property.threadSize == 0 ? 1 : property.threadSize)
+    for (size_t i = 0; i < objects.size(); i++) {
+      try {
+	(*generateResidualObject)(*objects[i], localData[start + i].iiIdx, // centroid:ID of global codebook
+				  localObjs, position + i * stride);
+      } catch(NGT::Exception &err) {
+	errors[i] = err.what();
+      }
+    }
+    for (auto i = errors.begin(); i != errors.end(); ++i) {
+      if (!(*i).empty()) {
+	NGTThrowException(*i);
+      }
+    }
+  }
+
   void replaceInvertedIndexEntry(size_t localCodebookNo) {
     vector<LocalDatam> localData;
     for (size_t gidx = 1; gidx < invertedIndex.size(); gidx++) {
@@ -1873,17 +2517,36 @@ public:
     }
     vector<vector<pair<NGT::Object*, size_t> > > localObjs;
     localObjs.resize(localCodebookNo);	
-    for (size_t i = 0; i < localData.size(); i++) {
-      IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
+    // the objects are read from the object list by chunk so that the adjacent records are read at once.
+    const size_t chunkSize = 10000;
+    NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+    for (size_t start = 0; start < localData.size(); start += chunkSize) {
+      size_t end = std::min(start + chunkSize, localData.size());
+      vector<NGT::Object*> objects;
+      vector<size_t> ids;
+      objects.reserve(end - start);
+      ids.reserve(end - start);
+      for (size_t i = start; i < end; i++) {
+	IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
 #ifdef NGTQ_SHARED_INVERTED_INDEX
-      (*generateResidualObject)(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
+	ids.push_back(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id);
 #else
-      (*generateResidualObject)(invertedIndexEntry[localData[i].iiLocalIdx].id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
+	ids.push_back(invertedIndexEntry[localData[i].iiLocalIdx].id);
 #endif
+	objects.push_back(new NGT::Object(&objectSpace));
+      }
+      objectList.getMultiple(ids, objects, &objectSpace);
+      try {
+	generateResidualObjects(localData, start, objects, localObjs);
+      } catch(NGT::Exception &err) {
+	for (auto i = objects.begin(); i != objects.end(); ++i) {
+	  delete *i;
+	}
+	throw err;
+      }
+      for (auto i = objects.begin(); i != objects.end(); ++i) {
+	delete *i;
+      }
     }
     vector<NGT::GraphAndTreeIndex*> lcodebook;
     for (size_t i = 0; i < localCodebookNo; i++) {
@@ -1893,6 +2556,7 @@ public:
   }
 
   void insert(vector<pair<NGT::Object*, size_t> > &objects) {
+    clearFastScanInvertedIndex();
     NGT::GraphAndTreeIndex &gcodebook = (NGT::GraphAndTreeIndex &)globalCodebook.getIndex();
     vector<NGT::GraphAndTreeIndex*> lcodebook;
     size_t localCodebookNo = property.getLocalCodebookNo();
@@ -1910,23 +2574,18 @@ public:
     invertedIndex.reserve(invertedIndex.size() + objects.size());
 #endif
     vector<LocalDatam> localData;
+    vector<NGT::Object*> localDataObjects;
     for (size_t i = 0; i < ids.size(); i++) {
+      size_t size = localData.size();
       setGlobalCodeToInvertedEntry(ids[i], objects[i], localData);
+      if (localData.size() != size) {
+	// the object itself is used instead of the one in the object list to generate the residual object.
+	localDataObjects.push_back(objects[i].first);
+      }
     } 
     vector<vector<pair<NGT::Object*, size_t> > > localObjs;
     localObjs.resize(property.getLocalCodebookNo());	
-    for (size_t i = 0; i < localData.size(); i++) {
-      IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-      (*generateResidualObject)(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
-#else
-      (*generateResidualObject)(invertedIndexEntry[localData[i].iiLocalIdx].id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
-#endif
-    }
+    generateResidualObjects(localData, 0, localDataObjects, localObjs);
     if (property.singleLocalCodebook) {
       // single local codebook
       setSingleLocalCodeToInvertedIndexEntry(lcodebook, localData, localObjs);
@@ -1935,11 +2594,8 @@ public:
       bool localCodebookFull = setMultipleLocalCodeToInvertedIndexEntry(lcodebook, localData, localObjs);
       if ((!property.localCodebookState) && localCodebookFull) { 
 	if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
-	  buildMultipleLocalCodebooks(localCodebook.data(), localCodebookNo, property.localCentroidLimit);
-	  (*generateResidualObject).set(localCodebook.data(), localCodebookNo);
-	  property.localCodebookState = true;	
+	  buildMultipleLocalCodebooksWithKmeans();
 	  localCodebookFull = false;		
-	  replaceInvertedIndexEntry(localCodebookNo);
 	} else {
 	  property.localCodebookState = true;	
 	  localCodebookFull = false;
@@ -1964,7 +2620,11 @@ public:
       id = objectList.size();
       id = id == 0 ? 1 : id;
     }
+    if (property.rotationType != RotationTypeNone && rotation.isEmpty()) {
+      NGTThrowException("NGTQ::Quantizer::insert: The rotation has not been trained yet.");
+    }
     NGT::Object *object = globalCodebook.allocateObject(line, " \t");
+    rotate(*object);
     objectList.put(id, *object, &globalCodebook.getObjectSpace());
     objects.push_back(pair<NGT::Object*, size_t>(object, id));
     if (objects.size() >= property.batchSize) {
@@ -1979,7 +2639,11 @@ public:
       id = id == 0 ? 1 : id;
     }
 
+    if (property.rotationType != RotationTypeNone && rotation.isEmpty()) {
+      NGTThrowException("NGTQ::Quantizer::insert: The rotation has not been trained yet.");
+    }
     NGT::Object *object = globalCodebook.allocateObject(objvector);
+    rotate(*object);
     objectList.put(id, *object, &globalCodebook.getObjectSpace());
 
     objects.push_back(pair<NGT::Object*, size_t>(object, id));
@@ -1989,6 +2653,14 @@ public:
     }
   }
 
+  // the object is rotated in place before it is stored, because the index is built in the rotated space.
+  void rotate(NGT::Object &object) {
+    if (property.rotationType == RotationTypeNone) {
+      return;
+    }
+    rotation.rotate(static_cast<float*>(object.getPointer()));
+  }
+
   void rebuildIndex() {
     vector<pair<NGT::Object*, size_t> > objects;
     size_t objectCount = objectList.size();
@@ -2072,6 +2744,18 @@ public:
     }
     lp.dimension = property.dimension / property.localDivisionNo;
 
+    if (property.rotationType != RotationTypeNone) {
+      if (property.dataType != DataTypeFloat) {
+	NGTThrowException("NGTQ::Quantizer::create: The rotation is available only for float objects.");
+      }
+      if (property.distanceType != DistanceTypeL2 && property.distanceType != DistanceTypeAngle &&
+	  property.distanceType != DistanceTypeNormalizedCosine && property.distanceType != DistanceTypeNormalizedL2) {
+	stringstream msg;
+	msg << "NGTQ::Quantizer::create: The rotation is unavailable for the distance type. " << property.distanceType;
+	NGTThrowException(msg);
+      }
+    }
+
     switch (property.dataType) {
     case DataTypeFloat:
       gp.objectType = NGT::Index::Property::ObjectType::Float;
@@ -2264,29 +2948,44 @@ public:
   }
 
   inline void aggregateObjectsWithExactDistance(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
+    if (results.size() >= approximateSearchSize) {
+      return;
+    }
     NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
-    for (size_t j = 0; j < invertedIndex[globalCentroid.id]->size() && results.size() < approximateSearchSize; j++) {
+    // every entry adds one result, so that the number of the entries to be processed is known in advance.
+    size_t entrySize = std::min(invertedIndex[globalCentroid.id]->size(), approximateSearchSize - results.size());
+    NGT::ObjectDistances objs;
+    objs.resize(entrySize);
+    vector<size_t> ids;
+    vector<size_t> positions;
+    for (size_t j = 0; j < entrySize; j++) {
 #ifdef NGTQ_SHARED_INVERTED_INDEX
       InvertedIndexObject<LOCAL_ID_TYPE> &invertedIndexEntry = (*invertedIndex[globalCentroid.id]).at(j, invertedIndex.allocator);
 #else
       InvertedIndexObject<LOCAL_ID_TYPE> &invertedIndexEntry = (*invertedIndex[globalCentroid.id])[j];
 #endif
-      double distance;
+      objs[j].id = invertedIndexEntry.id;
+      assert(objs[j].id > 0);
       if (invertedIndexEntry.localID[0] == 0) {
-	distance = globalCentroid.distance;
+	objs[j].distance = globalCentroid.distance;
       } else { 
-	NGT::Object o(&objectSpace);
-	objectList.get(invertedIndexEntry.id, (NGT::Object&)o, &objectSpace);
-	distance = objectSpace.getComparator()(*query, (NGT::Object&)o);
+	ids.push_back(invertedIndexEntry.id);
+	positions.push_back(j);
       }  
-
-      NGT::ObjectDistance obj;
-      obj.id = invertedIndexEntry.id;
-      obj.distance = distance;
-      assert(obj.id > 0);
-      results.push(obj);
-
     } 
+    vector<NGT::Object*> objects;
+    objects.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+      objects.push_back(objectSpace.allocateObject());
+    }
+    objectList.getMultiple(ids, objects, &objectSpace);
+    for (size_t i = 0; i < ids.size(); i++) {
+      objs[positions[i]].distance = objectSpace.getComparator()(*query, *objects[i]);
+      objectSpace.deleteObject(objects[i]);
+    }
+    for (auto &obj : objs) {
+      results.push(obj);
+    }
   }
 
    inline void aggregateObjectsWithLookupTable(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
@@ -2316,6 +3015,157 @@ public:
      } 
   }
 
+  class FastScanContext {
+  public:
+    QuantizedObjectDistance::DistanceLookupTableUint8	lookupTable;
+    std::vector<float>					work;
+    std::vector<float>					distances;
+  };
+
+  static FastScanContext &getFastScanContext() {
+    static thread_local FastScanContext context;
+    return context;
+  }
+
+  // The objects in the inverted lists of the global centroids are aggregated in the same way as the other modes, while
+  // only the nearest objects are kept in the results, since the results are truncated to the size in the end.
+  inline void aggregateObjectsWithFastScan(NGT::Object *query, size_t size, NGT::ObjectDistances &objects, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
+    size_t numOfCandidates = 0;
+    for (size_t i = 0; i < objects.size(); i++) {
+      if (invertedIndex[objects[i].id] == 0) {
+	if (property.centroidCreationMode == CentroidCreationModeDynamic) {
+	  cerr << "Inverted index is empty. " << objects[i].id << endl;
+	}
+	continue;
+      }
+      size_t limit = numOfCandidates == 0 ? INT_MAX : approximateSearchSize;
+      numOfCandidates += scanFastScanInvertedList(objects[i], query, limit - numOfCandidates, size, results);
+      if (numOfCandidates >= approximateSearchSize) {
+	return;
+      }
+    }
+  }
+
+  // The distances of the objects in the inverted list are computed block by block with the fast scan instead of
+  // the objects one by one. The number of the scanned objects is returned.
+  inline size_t scanFastScanInvertedList(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t maxNumOfObjects, size_t size, NGT::ObjectSpace::ResultSet &results) {
+    FastScanInvertedList &list = fastScanInvertedIndex[globalCentroid.id];
+    size_t numOfObjects = std::min(list.ids.size(), maxNumOfObjects);
+    if (numOfObjects == 0) {
+      return 0;
+    }
+    FastScanContext &context = getFastScanContext();
+    QuantizedObjectDistance &objectDistance = *quantizedObjectDistance;
+    if (!context.lookupTable.isInitialized(objectDistance.localCodebookNo, objectDistance.localCodebookCentroidNo)) {
+      objectDistance.initialize(context.lookupTable);
+      context.work.resize(context.lookupTable.size);
+    }
+    objectDistance.createDistanceLookup(*query, globalCentroid.id, context.lookupTable, context.work.data());
+    size_t alignedNumOfObjects = (numOfObjects + NGTQ_SIMD_BLOCK_SIZE - 1) / NGTQ_SIMD_BLOCK_SIZE * NGTQ_SIMD_BLOCK_SIZE;
+    if (context.distances.size() < alignedNumOfObjects) {
+      context.distances.resize(alignedNumOfObjects);
+    }
+    float *distances = context.distances.data();
+    if (list.uint4) {
+      objectDistance(list.codes.get(), distances, alignedNumOfObjects, context.lookupTable);
+    } else {
+      objectDistance.getDistancesWithUint8LocalIDs(list.codes.get(), distances, alignedNumOfObjects, context.lookupTable);
+    }
+    for (auto i = list.identicalObjects.begin(); i != list.identicalObjects.end() && *i < numOfObjects; ++i) {
+      distances[*i] = globalCentroid.distance;
+    }
+    for (size_t j = 0; j < numOfObjects; j++) {
+      NGT::ObjectDistance obj(list.ids[j], distances[j]);
+      assert(obj.id > 0);
+      if (results.size() < size) {
+	results.push(obj);
+      } else if (size > 0 && obj < results.top()) {
+	results.pop();
+	results.push(obj);
+      }
+    }
+    return numOfObjects;
+  }
+
+  // The fast scan is available when the distance is the sum of the distances of the subvectors in L2 with the
+  // lookup table, which covers up to 256 local centroids for each subspace.
+  bool isFastScanAvailable() {
+#ifdef NGTQ_DISTANCE_ANGLE
+    return false;
+#else
+    if (quantizedObjectDistance == 0 || objectType != NGT::ObjectSpace::ObjectType::Float ||
+	property.singleLocalCodebook) {
+      return false;
+    }
+    size_t centroidNo = quantizedObjectDistance->localCodebookCentroidNo;
+    if (centroidNo <= 1 || centroidNo > 257) {
+      return false;
+    }
+    return property.distanceType == DistanceTypeL2 || property.distanceType == DistanceTypeNormalizedL2 ||
+      property.distanceType == DistanceTypeNormalizedCosine;
+#endif
+  }
+
+  // The inverted lists for the fast scan are built from the inverted index on the first search, and are discarded
+  // when objects are inserted. False is returned if the fast scan is unavailable for the index.
+  // The flag is checked before the lock, so that the concurrent searches are not serialized once the lists are built.
+  bool buildFastScanInvertedIndex() {
+    if (fastScanInvertedIndexBuilt.load(std::memory_order_acquire)) {
+      return true;
+    }
+    if (!isFastScanAvailable()) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(fastScanMutex);
+    if (fastScanInvertedIndexBuilt.load(std::memory_order_relaxed)) {
+      return true;
+    }
+    size_t centroidNo = quantizedObjectDistance->localCodebookCentroidNo;
+    size_t divisionNo = property.localDivisionNo;
+    std::vector<FastScanInvertedList> lists(invertedIndex.size());
+    for (size_t gid = 1; gid < invertedIndex.size(); gid++) {
+      if (invertedIndex.isEmpty(gid) || invertedIndex.at(gid)->size() == 0) {
+	continue;
+      }
+      IIEntry &entries = *invertedIndex.at(gid);
+      FastScanInvertedList &list = lists[gid];
+      list.uint4 = centroidNo == 17;
+      list.ids.resize(entries.size());
+      QuantizedObjectProcessingStream stream(*this, entries.size());
+      for (size_t idx = 0; idx < entries.size(); idx++) {
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+	NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries.at(idx, invertedIndex.allocator);
+#else
+	NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries[idx];
+#endif
+	list.ids[idx] = entry.id;
+	if (entry.localID[0] == 0) {
+	  list.identicalObjects.push_back(idx);
+	  continue;
+	}
+	for (size_t di = 0; di < divisionNo; di++) {
+	  if (static_cast<size_t>(entry.localID[di]) >= centroidNo) {
+	    std::stringstream msg;
+	    msg << "NGTQ::Quantizer::buildFastScanInvertedIndex: The local ID is out of the lookup table. "
+		<< entry.localID[di] << ":" << centroidNo << ". Reopen the index after the insertion.";
+	    NGTThrowException(msg);
+	  }
+	  stream.arrangeQuantizedObject(idx, di, entry.localID[di] == 0 ? 0 : entry.localID[di] - 1);
+	}
+      }
+      list.codes.reset(list.uint4 ? stream.compressIntoUint4() : stream.getStream());
+    }
+    fastScanInvertedIndex.swap(lists);
+    fastScanInvertedIndexBuilt.store(true, std::memory_order_release);
+    return true;
+  }
+
+  void clearFastScanInvertedIndex() {
+    std::lock_guard<std::mutex> lock(fastScanMutex);
+    fastScanInvertedIndexBuilt.store(false, std::memory_order_release);
+    std::vector<FastScanInvertedList>().swap(fastScanInvertedIndex);
+  }
+
    void extractInvertedIndexObject(InvertedIndexEntry<uint16_t> &invertedIndexObjects) {
 #ifdef NGTQ_SHARED_INVERTED_INDEX
      std::cerr << "not implemented" << std::endl;
@@ -2377,6 +3227,83 @@ public:
     }
   }
 
+  // Extract the local IDs of all of the objects. The local IDs of an object are placed from the object ID
+  // multiplied by the number of the subvectors. Unlike extractInvertedIndexObject, the shared inverted index
+  // is also available.
+  void extractLocalIDs(std::vector<uint16_t> &localIDs) {
+    size_t divisionNo = property.localDivisionNo;
+    localIDs.clear();
+    for (size_t gid = 1; gid < invertedIndex.size(); gid++) {
+      if (invertedIndex.isEmpty(gid)) {
+	continue;
+      }
+      IIEntry &entries = *invertedIndex.at(gid);
+      for (size_t idx = 0; idx < entries.size(); idx++) {
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+        NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries.at(idx, invertedIndex.allocator);
+#else
+        NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries[idx];
+#endif
+	if ((entry.id + 1) * divisionNo > localIDs.size()) {
+	  localIDs.resize((entry.id + 1) * divisionNo, 0);
+	}
+	for (size_t i = 0; i < divisionNo; i++) {
+	  if (static_cast<size_t>(entry.localID[i]) > 0xFFFF) {
+	    std::stringstream msg;
+	    msg << "NGTQ::Quantizer::extractLocalIDs: The local ID is too large. " << entry.localID[i];
+	    NGTThrowException(msg);
+	  }
+	  localIDs[entry.id * divisionNo + i] = entry.localID[i];
+	}
+      }
+    }
+  }
+
+  // Extract the local IDs of the specified objects in the order of the IDs. Each entry of the inverted index is
+  // looked up in the specified IDs, since the positions of the objects in the entries are not fixed, e.g. for reused IDs.
+  void extractLocalIDs(const std::vector<uint32_t> &ids, std::vector<uint16_t> &localIDs) {
+    size_t divisionNo = property.localDivisionNo;
+    std::unordered_map<uint32_t, size_t> positions;
+    for (size_t i = 0; i < ids.size(); i++) {
+      positions[ids[i]] = i;
+    }
+    std::vector<bool> found(ids.size(), false);
+    localIDs.assign(ids.size() * divisionNo, 0);
+    for (size_t gid = 1; gid < invertedIndex.size(); gid++) {
+      if (invertedIndex.isEmpty(gid)) {
+	continue;
+      }
+      IIEntry &entries = *invertedIndex.at(gid);
+      for (size_t idx = 0; idx < entries.size(); idx++) {
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+        NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries.at(idx, invertedIndex.allocator);
+#else
+        NGTQ::InvertedIndexObject<LOCAL_ID_TYPE> &entry = entries[idx];
+#endif
+	auto position = positions.find(entry.id);
+	if (position == positions.end()) {
+	  continue;
+	}
+	found[(*position).second] = true;
+	for (size_t i = 0; i < divisionNo; i++) {
+	  if (static_cast<size_t>(entry.localID[i]) > 0xFFFF) {
+	    std::stringstream msg;
+	    msg << "NGTQ::Quantizer::extractLocalIDs: The local ID is too large. " << entry.localID[i];
+	    NGTThrowException(msg);
+	  }
+	  localIDs[(*position).second * divisionNo + i] = entry.localID[i];
+	}
+      }
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+      if (!found[i]) {
+	std::stringstream msg;
+	msg << "NGTQ::Quantizer::extractLocalIDs: The object is not found in the inverted index. ID=" << ids[i];
+	NGTThrowException(msg);
+      }
+    }
+  }
+
   inline NGT::Distance getApproximateDistance(NGT::Object &query, uint32_t globalID, LOCAL_ID_TYPE *localID, QuantizedObjectDistance::DistanceLookupTable &distanceLUT) {
     double distance;
       distance = (*quantizedObjectDistance)(query, globalID, localID, distanceLUT);
@@ -2458,12 +3385,18 @@ public:
 
   void refineDistance(NGT::Object *query, NGT::ObjectDistances &results) {
      NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+     vector<size_t> ids;
+     vector<NGT::Object*> objects;
+     ids.reserve(results.size());
+     objects.reserve(results.size());
      for (auto i = results.begin(); i != results.end(); ++i) {
-       NGT::ObjectDistance &result = *i;
-       NGT::Object o(&objectSpace);
-       objectList.get(result.id, (NGT::Object&)o, &objectSpace);
-       double distance = objectSpace.getComparator()(*query, (NGT::Object&)o);
-       result.distance = distance;
+       ids.push_back((*i).id);
+       objects.push_back(objectSpace.allocateObject());
+     }
+     objectList.getMultiple(ids, objects, &objectSpace);
+     for (size_t i = 0; i < results.size(); i++) {
+       results[i].distance = objectSpace.getComparator()(*query, *objects[i]);
+       objectSpace.deleteObject(objects[i]);
      }
      std::sort(results.begin(), results.end());
   }
@@ -2501,6 +3434,29 @@ public:
 	      size_t codebookSearchSize, 
 	      AggregationMode aggregationMode,
 	      double epsilon = FLT_MAX) {
+    if (property.rotationType == RotationTypeNone) {
+      searchInRotatedSpace(query, objs, size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon);
+      return;
+    }
+    if (rotation.isEmpty()) {
+      NGTThrowException("NGTQ::Quantizer::search: The rotation has not been trained yet.");
+    }
+    NGT::Object *rotatedQuery = globalCodebook.getObjectSpace().allocateObject();
+    rotation.rotate(static_cast<float*>(query->getPointer()), static_cast<float*>(rotatedQuery->getPointer()));
+    try {
+      searchInRotatedSpace(rotatedQuery, objs, size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon);
+    } catch(NGT::Exception &err) {
+      globalCodebook.deleteObject(rotatedQuery);
+      throw err;
+    }
+    globalCodebook.deleteObject(rotatedQuery);
+  }
+
+  void searchInRotatedSpace(NGT::Object *query, NGT::ObjectDistances &objs, 
+			    size_t size, size_t approximateSearchSize,
+			    size_t codebookSearchSize, 
+			    AggregationMode aggregationMode,
+			    double epsilon) {
     if (aggregationMode == AggregationModeApproximateDistanceWithLookupTable) {
       if (property.dataType != DataTypeFloat) {
 	NGTThrowException("NGTQ: Fatal inner error. the lookup table is only for dataType float!");
@@ -2533,7 +3489,11 @@ public:
       abort();
     }
 
-    aggregateObjects(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction);
+    if (aggregationMode == AggregationModeApproximateDistanceWithLookupTable && buildFastScanInvertedIndex()) {
+      aggregateObjectsWithFastScan(query, size, objects, results, approximateSearchSize);
+    } else {
+      aggregateObjects(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction);
+    }
 
     objs.resize(results.size());
     while (!results.empty()) {
@@ -2698,6 +3658,9 @@ public:
   GenerateResidualObject	*generateResidualObject;
   std::vector<NGT::Index>	localCodebook;
 
+  std::vector<FastScanInvertedList>	fastScanInvertedIndex;
+  std::atomic<bool>		fastScanInvertedIndexBuilt;
+  std::mutex			fastScanMutex;
 };
   
 class Quantization {
@@ -2762,31 +3725,58 @@ public:
 
   static void append(const string &indexName,	// index file
 		     const string &data,	// data file
-		     size_t dataSize = 0	// data size
+		     size_t dataSize = 0,	// data size
+		     const string &dataFormat = "",	// data format
+		     size_t numOfThreads = 0	// # of threads. the one of the property if zero
 		     ) {
     NGTQ::Index index(indexName);
+    size_t threadSize = index.getQuantizer().property.threadSize;
+    if (numOfThreads != 0) {
+      // the specified number of threads is used only for this append.
+      index.getQuantizer().setThreadSize(numOfThreads);
+    }
+    NGT::VectorFile::Format format = NGT::VectorFile::getFormat(data, dataFormat);
+    if (index.getQuantizer().property.rotationType != RotationTypeNone && index.getQuantizer().rotation.isEmpty()) {
+      trainRotation(index, data, format);
+    }
     istream *is;
     if (data == "-") {
       is = &cin;
     } else {
       ifstream *ifs = new ifstream;
-      ifs->ifstream::open(data);
+      if (format == NGT::VectorFile::FormatText) {
+	ifs->ifstream::open(data);
+      } else {
+	ifs->ifstream::open(data, ios::in | ios::binary);
+      }
       if (!(*ifs)) {
 	cerr << "Cannot open the specified file. " << data << endl;
+	delete ifs;
 	return;
       }
       is = ifs;
     }
-    string line;
     vector<pair<NGT::Object*, size_t> > objects;
     size_t count = 0;
     // extract objects from the file and insert them to the object list.
-    while(getline(*is, line)) {
-      count++;
-      index.insert(line, objects, 0);
-      if (count % 10000 == 0) {
+    if (format == NGT::VectorFile::FormatText) {
+      string line;
+      while(getline(*is, line)) {
+	count++;
+	index.insert(line, objects, 0);
+	if (count % 10000 == 0) {
 	  cerr << "Processed " << count;
 	  cerr << endl;
+	}
+      }
+    } else {
+      try {
+	appendBinary(index, *is, format, count);
+      } catch (NGT::Exception &err) {
+	if (data != "-") {
+	  delete is;
+	}
+	throw err;
       }
     }
     if (objects.size() > 0) {
@@ -2797,10 +3787,104 @@ public:
       delete is;
     }
 
+    index.getQuantizer().setThreadSize(threadSize);
     index.save();
     index.close();
   }
 
+  static void extractRow(NGT::VectorFile &file, uint8_t *row, size_t dimension, vector<float> &object) {
+    switch (file.getElementType()) {
+    case NGT::VectorFile::ElementTypeUint8:
+      object.assign(row, row + dimension);
+      break;
+    case NGT::VectorFile::ElementTypeFloat:
+      object.assign(reinterpret_cast<float*>(row), reinterpret_cast<float*>(row) + dimension);
+      break;
+    case NGT::VectorFile::ElementTypeInt32:
+      object.assign(reinterpret_cast<int32_t*>(row), reinterpret_cast<int32_t*>(row) + dimension);
+      break;
+    case NGT::VectorFile::ElementTypeDouble:
+      object.assign(reinterpret_cast<double*>(row), reinterpret_cast<double*>(row) + dimension);
+      break;
+    default:
+      NGTThrowException("Quantizer::extractRow: Unsupported element type.");
+    }
+  }
+
+  static void appendBinary(NGTQ::Index &index, istream &is, NGT::VectorFile::Format format, size_t &count) {
+    size_t dimension = index.getQuantizer().property.dimension;
+    NGT::VectorFile file(is, format, dimension);
+    vector<pair<NGT::Object*, size_t> > objects;
+    vector<uint8_t> block;
+    vector<float> object;
+    size_t rowSize = file.getRowSize();
+    size_t rows;
+    while ((rows = file.read(block, 4096)) > 0) {
+      for (size_t r = 0; r < rows; r++) {
+	extractRow(file, &block[rowSize * r], dimension, object);
+	count++;
+	index.insert(object, objects, 0);
+	if (count % 10000 == 0) {
+	  cerr << "Processed " << count;
+	  cerr << endl;
+	}
+      }
+    }
+    if (objects.size() > 0) {
+      index.insert(objects);
+    }
+  }
+
+  // the rotation is trained with the leading objects of the data file before any object is inserted.
+  static void trainRotation(NGTQ::Index &index, const string &data, NGT::VectorFile::Format format,
+			    size_t sampleSize = 100000) {
+    NGTQ::Quantizer &quantizer = index.getQuantizer();
+    if (quantizer.objectList.size() > 1) {
+      NGTThrowException("NGTQ::Index::trainRotation: The rotation must be trained before objects are inserted.");
+    }
+    if (data == "-") {
+      NGTThrowException("NGTQ::Index::trainRotation: The rotation cannot be trained with the standard input.");
+    }
+    ifstream is;
+    if (format == NGT::VectorFile::FormatText) {
+      is.open(data);
+    } else {
+      is.open(data, ios::in | ios::binary);
+    }
+    if (!is) {
+      // the caller reports the file that cannot be opened.
+      return;
+    }
+    size_t dimension = quantizer.property.dimension;
+    std::vector<std::vector<float>> samples;
+    // objects are allocated through the global codebook to be normalized in the same way as the inserted ones.
+    auto addSample = [&quantizer, &samples, dimension](NGT::Object *object) {
+      float *o = static_cast<float*>(object->getPointer());
+      samples.emplace_back(o, o + dimension);
+      quantizer.globalCodebook.deleteObject(object);
+    };
+    if (format == NGT::VectorFile::FormatText) {
+      string line;
+      while (samples.size() < sampleSize && getline(is, line)) {
+	addSample(quantizer.globalCodebook.allocateObject(line, " \t"));
+      }
+    } else {
+      NGT::VectorFile file(is, format, dimension);
+      vector<uint8_t> block;
+      vector<float> object;
+      size_t rowSize = file.getRowSize();
+      size_t rows;
+      while (samples.size() < sampleSize && (rows = file.read(block, 4096)) > 0) {
+	for (size_t r = 0; r < rows && samples.size() < sampleSize; r++) {
+	  extractRow(file, &block[rowSize * r], dimension, object);
+	  addSample(quantizer.globalCodebook.allocateObject(object));
+	}
+      }
+    }
+    cerr << "NGTQ: train the rotation with " << samples.size() << " objects." << endl;
+    quantizer.trainRotation(samples);
+  }
+
   static void rebuild(const string &indexName,		
 		      const string &rebuiltIndexName	
 		     ) {
@@ -2813,6 +3897,10 @@ public:
       msg << "Quantizer::rebuild: Cannot rename an object file. " << srcObjectList << "=>" << dstObjectList ;
       NGTThrowException(msg);
     }
+    // the stored objects are in the rotated space, so that the rotation is moved together.
+    const string srcRotation = indexName + "/rot";
+    const string dstRotation = rebuiltIndexName + "/rot";
+    bool rotation = std::rename(srcRotation.c_str(), dstRotation.c_str()) == 0;
 
     try {
       NGTQ::Index index(rebuiltIndexName);
@@ -2823,6 +3911,9 @@ public:
       index.close();
     } catch(NGT::Exception &err) {
       std::rename(dstObjectList.c_str(), srcObjectList.c_str());
+      if (rotation) {
+	std::rename(dstRotation.c_str(), srcRotation.c_str());
+      }
       throw err;
     }
 
@@ -2850,6 +3941,10 @@ public:
      getQuantizer().insert(line, objects, id);
    }
 
+   void insert(vector<float> &object, vector<pair<NGT::Object*, size_t> > &objects, size_t id) {
+     getQuantizer().insert(object, objects, id);
+   }
+
    void insert(vector<pair<NGT::Object*, size_t> > &objects) {
      getQuantizer().insert(objects);
    }
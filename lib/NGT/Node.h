@@ -52,8 +52,8 @@ namespace NGT {
       void setType(Type t) { id = (t << 31) | getID(); }
       void setRaw(NodeID i) { id = i; }
       void setNull() { id = 0; }
-      void serialize(std::ofstream &os) { NGT::Serializer::write(os, id); }
-      void deserialize(std::ifstream &is) { NGT::Serializer::read(is, id); }
+      void serialize(std::ostream &os) { NGT::Serializer::write(os, id); }
+      void deserialize(std::istream &is) { NGT::Serializer::read(is, id); }
       void serializeAsText(std::ofstream &os) { NGT::Serializer::writeAsText(os, id); }
       void deserializeAsText(std::ifstream &is) { NGT::Serializer::readAsText(is, id); }
     protected:
@@ -87,12 +87,12 @@ namespace NGT {
       return *this;
     }
 
-    void serialize(std::ofstream &os) {
+    void serialize(std::ostream &os) {
       id.serialize(os);
       parent.serialize(os);
     }
 
-    void deserialize(std::ifstream &is) {
+    void deserialize(std::istream &is) {
       id.deserialize(is);
       parent.deserialize(is);
     }
@@ -219,9 +219,9 @@ namespace NGT {
 #endif // NGT_SHARED_MEMORY_ALLOCATOR
 
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR) 
-    void serialize(std::ofstream &os, SharedMemoryAllocator &allocator, ObjectSpace *objectspace = 0) {
+    void serialize(std::ostream &os, SharedMemoryAllocator &allocator, ObjectSpace *objectspace = 0) {
 #else
-    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0) {
+    void serialize(std::ostream &os, ObjectSpace *objectspace = 0) {
 #endif
       Node::serialize(os);
       if (pivot == 0) {
@@ -249,7 +249,7 @@ namespace NGT {
 #endif
       }
     }
-    void deserialize(std::ifstream &is, ObjectSpace *objectspace = 0) {
+    void deserialize(std::istream &is, ObjectSpace *objectspace = 0) {
       Node::deserialize(is);
       if (pivot == 0) {
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
@@ -448,7 +448,7 @@ namespace NGT {
     NGT::ObjectDistance *getObjectIDs() { return objectIDs; }
 #endif // NGT_SHARED_MEMORY_ALLOCATOR
 
-    void serialize(std::ofstream &os, ObjectSpace *objectspace = 0) {
+    void serialize(std::ostream &os, ObjectSpace *objectspace = 0) {
       Node::serialize(os);
 #ifdef NGT_NODE_USE_VECTOR
       NGT::Serializer::write(os, objectIDs);
@@ -478,7 +478,7 @@ namespace NGT {
 #endif
       }
     }
-    void deserialize(std::ifstream &is, ObjectSpace *objectspace = 0) {
+    void deserialize(std::istream &is, ObjectSpace *objectspace = 0) {
       Node::deserialize(is);
 
 #ifdef NGT_NODE_USE_VECTOR
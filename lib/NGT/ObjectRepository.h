@@ -22,10 +22,10 @@ namespace NGT {
   public PersistentRepository<PersistentObject> {
   public:
     typedef PersistentRepository<PersistentObject>	Parent;
-    void open(const std::string &smfile, size_t sharedMemorySize) { 
+    void open(const std::string &smfile, size_t sharedMemorySize, const MemoryManager::open_option_st *openOption = 0) { 
       std::string file = smfile;
       file.append("po");
-      Parent::open(file, sharedMemorySize);
+      Parent::open(file, sharedMemorySize, openOption);
     }
 #else
   class ObjectRepository : public Repository<Object> {
@@ -39,14 +39,14 @@ namespace NGT {
       Parent::push_back((PersistentObject*)0);
     }
 
-    void serialize(const std::string &ofile, ObjectSpace *ospace) { 
+    void serialize(const std::string &ofile, ObjectSpace *ospace, bool chunked = false) { 
       std::ofstream objs(ofile);
       if (!objs.is_open()) {
 	std::stringstream msg;
 	msg << "NGT::ObjectSpace: Cannot open the specified file " << ofile << ".";
 	NGTThrowException(msg);
       }
-      Parent::serialize(objs, ospace); 
+      Parent::serialize(objs, ospace, chunked); 
     }
 
     void deserialize(const std::string &ifile, ObjectSpace *ospace) { 
@@ -118,6 +118,134 @@ namespace NGT {
       if (dataSize > 0) {
 	reserve(size() + dataSize);
       }
+      if (sparse) {
+	appendTextSequentially(is, dataSize, prevDataSize);
+	return;
+      }
+      // The text is read in blocks which end at line boundaries. The lines of each block are parsed
+      // into a float buffer in parallel, and then the objects are appended in the order of the lines.
+      const size_t blockSize = 4 * 1024 * 1024;
+      std::vector<char> block;
+      std::vector<size_t> lines;
+      std::vector<float> values;
+      std::vector<char *> status;
+      std::vector<float> object;
+      size_t lineNo = 0;
+      size_t rest = 0;
+      bool eof = false;
+      while (!eof) {
+	block.resize(rest + blockSize + 1);
+	is.read(&block[rest], blockSize);
+	size_t blockEnd = rest + is.gcount();
+	eof = blockEnd == rest;
+	lines.clear();
+	size_t lineBegin = 0;
+	for (;;) {
+	  char *nl = static_cast<char*>(memchr(&block[lineBegin], '\n', blockEnd - lineBegin));
+	  if (nl == 0) {
+	    break;
+	  }
+	  lines.push_back(lineBegin);
+	  *nl = 0;
+	  lineBegin = nl - &block[0] + 1;
+	}
+	if (eof && lineBegin < blockEnd) {
+	  // the last line without a line feed.
+	  lines.push_back(lineBegin);
+	  block[blockEnd] = 0;
+	  lineBegin = blockEnd;
+	}
+	size_t nOfLines = lines.size();
+	values.resize(nOfLines * dimension);
+	status.resize(nOfLines);
+	size_t parsedLines = 0;
+	for (size_t li = 0; li < nOfLines; li++) {
+	  if (li == parsedLines) {
+	    // parse only the lines which are likely to be appended when the data size is specified.
+	    size_t end = nOfLines;
+	    if (dataSize > 0 && li + dataSize - (size() - prevDataSize) < end) {
+	      end = li + dataSize - (size() - prevDataSize) + 1;
+	    }
+#pragma omp parallel for schedule(dynamic, 256) if (end - li > 1024)
+	    for (size_t pi = li; pi < end; pi++) {
+	      status[pi] = parseTextLine(&block[lines[pi]], &values[pi * dimension]);
+	    }
+	    parsedLines = end;
+	  }
+	  lineNo++;
+	  char *line = &block[lines[li]];
+	  if (dataSize > 0 && (dataSize <= size() - prevDataSize)) {
+	    std::cerr << "The size of data reached the specified size. The remaining data in the file are not inserted. " 
+		      << dataSize << std::endl;
+	    return;
+	  }
+	  if (status[li] == line) {
+	    std::cerr << "ObjectSpace::readText: Warning! Invalid line. [" << line << "] Skip the line " << lineNo << " and continue." << std::endl;
+	    continue;
+	  }
+	  if (status[li] != 0) {
+	    std::cerr << "ObjectSpace::readText: Warning! Not numerical value. [" << std::string(status[li], strcspn(status[li], "\t ")) << "]" << std::endl;
+	  }
+	  object.assign(&values[li * dimension], &values[li * dimension] + dimension);
+	  try {
+	    PersistentObject *obj = 0;
+	    try {
+	      obj = allocateNormalizedPersistentObject(object);
+	    } catch (Exception &err) {
+	      std::cerr << err.what() << " continue..." << std::endl;
+	      obj = allocatePersistentObject(object);
+	    }
+	    push_back(obj);
+	  } catch (Exception &err) {
+	    std::cerr << "ObjectSpace::readText: Warning! Invalid line. [" << line << "] Skip the line " << lineNo << " and continue." << std::endl;
+	  }
+	}
+	// move the incomplete last line to the top of the block.
+	rest = blockEnd - lineBegin;
+	memmove(&block[0], &block[lineBegin], rest);
+      }
+    }
+
+    // Parse the first dimension values of the line separated by a tab or a space.
+    // Returns 0 when succeeded, the line itself when the line is invalid, or the position of the first
+    // non-numerical value after which the remaining values are zero.
+    char *parseTextLine(char *line, float *object) {
+      char *p = line;
+      for (size_t idx = 0; idx < dimension; idx++) {
+	char *e = p;
+	while (*e != 0 && *e != '\t' && *e != ' ') {
+	  e++;
+	}
+	if (e == p) {
+	  return line;
+	}
+	char *end;
+	object[idx] = strtof(p, &end);
+	if (end != e) {
+	  for (size_t i = idx + 1; i < dimension; i++) {
+	    object[i] = 0.0;
+	  }
+	  // check the number of the remaining tokens so as to detect too few dimension.
+	  for (size_t i = idx + 1; i < dimension; i++) {
+	    if (*e == 0) {
+	      return line;
+	    }
+	    e++;
+	    while (*e != 0 && *e != '\t' && *e != ' ') {
+	      e++;
+	    }
+	  }
+	  return end;
+	}
+	if (*e == 0 && idx + 1 < dimension) {
+	  return line;
+	}
+	p = e + 1;
+      }
+      return 0;
+    }
+
+    void appendTextSequentially(std::istream &is, size_t dataSize, size_t prevDataSize) {
       std::string line;
       size_t lineNo = 0;
       while (getline(is, line)) {
@@ -144,6 +272,89 @@ namespace NGT {
       }
     }
 
+    void appendBinary(std::istream &is, VectorFile::Format format, size_t dataSize = 0) {
+      if (dimension == 0) {
+	NGTThrowException("ObjectSpace::appendBinary: Dimension is not specified.");
+      }
+      if (sparse) {
+	NGTThrowException("ObjectSpace::appendBinary: Sparse objects are not supported.");
+      }
+      if (size() == 0) {
+	// First entry should be always a dummy entry.
+	// If it is empty, the dummy entry should be inserted.
+	push_back((PersistentObject*)0);
+      }
+      VectorFile file(is, format, dimension);
+      size_t prevDataSize = size();
+      size_t reservedSize = file.getNumberOfRows();
+      if (dataSize > 0 && (reservedSize == 0 || dataSize < reservedSize)) {
+	reservedSize = dataSize;
+      }
+      if (reservedSize > 0) {
+	reserve(size() + reservedSize);
+      }
+      const size_t blockSize = 4096;
+      std::vector<uint8_t> block;
+      std::vector<float> floatObject;
+      std::vector<uint8_t> uint8Object;
+      size_t rowSize = file.getRowSize();
+      size_t rowNo = 0;
+      for (;;) {
+	size_t rows = blockSize;
+	if (dataSize > 0) {
+	  size_t remainder = dataSize - (size() - prevDataSize);
+	  rows = remainder < rows ? remainder : rows;
+	}
+	rows = file.read(block, rows);
+	if (rows == 0) {
+	  break;
+	}
+	for (size_t r = 0; r < rows; r++, rowNo++) {
+	  uint8_t *row = &block[rowSize * r];
+	  try {
+	    PersistentObject *obj = 0;
+	    switch (file.getElementType()) {
+	    case VectorFile::ElementTypeUint8:
+	      uint8Object.assign(row, row + dimension);
+	      obj = allocateBinaryObject(uint8Object);
+	      break;
+	    case VectorFile::ElementTypeFloat:
+	      floatObject.assign(reinterpret_cast<float*>(row), reinterpret_cast<float*>(row) + dimension);
+	      obj = allocateBinaryObject(floatObject);
+	      break;
+	    case VectorFile::ElementTypeInt32:
+	      floatObject.assign(reinterpret_cast<int32_t*>(row), reinterpret_cast<int32_t*>(row) + dimension);
+	      obj = allocateBinaryObject(floatObject);
+	      break;
+	    case VectorFile::ElementTypeDouble:
+	      floatObject.assign(reinterpret_cast<double*>(row), reinterpret_cast<double*>(row) + dimension);
+	      obj = allocateBinaryObject(floatObject);
+	      break;
+	    default:
+	      NGTThrowException("ObjectSpace::appendBinary: Unsupported element type.");
+	    }
+	    push_back(obj);
+	  } catch (Exception &err) {
+	    std::cerr << "ObjectSpace::appendBinary: Warning! Invalid data. Skip the row " << rowNo << " and continue. " << err.what() << std::endl;
+	  }
+	}
+      }
+      if (dataSize > 0 && dataSize <= size() - prevDataSize && is.peek() != EOF) {
+	std::cerr << "The size of data reached the specified size. The remaining data in the file are not inserted. " 
+		  << dataSize << std::endl;
+      }
+    }
+
+    template <typename T>
+    PersistentObject *allocateBinaryObject(const std::vector<T> &object) {
+      try {
+	return allocateNormalizedPersistentObject(object);
+      } catch (Exception &err) {
+	std::cerr << err.what() << " continue..." << std::endl;
+	return allocatePersistentObject(object);
+      }
+    }
+
     template <typename T>
     void append(T *data, size_t objectCount) {
       if (dimension == 0) {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "PrimitiveComparator.h"
+#include "VectorFile.h"
 
 class ObjectSpace;
 
@@ -26,8 +27,8 @@ namespace NGT {
   class ObjectDistances : public std::vector<ObjectDistance> {
   public:
     ObjectDistances(NGT::ObjectSpace *os = 0) {}
-    void serialize(std::ofstream &os, ObjectSpace *objspace = 0) { NGT::Serializer::write(os, (std::vector<ObjectDistance>&)*this);}
-    void deserialize(std::ifstream &is, ObjectSpace *objspace = 0) { NGT::Serializer::read(is, (std::vector<ObjectDistance>&)*this);}
+    void serialize(std::ostream &os, ObjectSpace *objspace = 0) { NGT::Serializer::write(os, (std::vector<ObjectDistance>&)*this);}
+    void deserialize(std::istream &is, ObjectSpace *objspace = 0) { NGT::Serializer::read(is, (std::vector<ObjectDistance>&)*this);}
 
     void serializeAsText(std::ofstream &os, ObjectSpace *objspace = 0) { 
       NGT::Serializer::writeAsText(os, size());
@@ -191,7 +192,7 @@ namespace NGT {
     virtual ~ObjectSpace() { if (comparator != 0) { delete comparator; } }
     
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    virtual void open(const std::string &f, size_t shareMemorySize) = 0;
+    virtual void open(const std::string &f, size_t shareMemorySize, const MemoryManager::open_option_st *openOption = 0) = 0;
     virtual Object *allocateObject(Object &o) = 0;
     virtual Object *allocateObject(PersistentObject &o) = 0;
     virtual PersistentObject *allocatePersistentObject(Object &obj) = 0;
@@ -205,12 +206,13 @@ namespace NGT {
 
     Comparator &getComparator() { return *comparator; }
 
-    virtual void serialize(const std::string &of) = 0;
+    virtual void serialize(const std::string &of, bool chunked = false) = 0;
     virtual void deserialize(const std::string &ifile) = 0;
     virtual void serializeAsText(const std::string &of) = 0;
     virtual void deserializeAsText(const std::string &of) = 0;
     virtual void readText(std::istream &is, size_t dataSize) = 0;
     virtual void appendText(std::istream &is, size_t dataSize) = 0;
+    virtual void appendBinary(std::istream &is, VectorFile::Format format, size_t dataSize) = 0;
     virtual void append(const float *data, size_t dataSize) = 0;
     virtual void append(const double *data, size_t dataSize) = 0;
 
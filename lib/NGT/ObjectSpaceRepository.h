@@ -299,7 +299,9 @@ namespace NGT {
    }
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    void open(const std::string &f, size_t sharedMemorySize) { ObjectRepository::open(f, sharedMemorySize); }
+    void open(const std::string &f, size_t sharedMemorySize, const MemoryManager::open_option_st *openOption = 0) {
+      ObjectRepository::open(f, sharedMemorySize, openOption);
+    }
     void copy(PersistentObject &objecta, PersistentObject &objectb) { objecta = objectb; }
 
     void show(std::ostream &os, PersistentObject &object) {
@@ -441,12 +443,13 @@ namespace NGT {
     }
 
 
-    void serialize(const std::string &ofile) { ObjectRepository::serialize(ofile, this); }
+    void serialize(const std::string &ofile, bool chunked = false) { ObjectRepository::serialize(ofile, this, chunked); }
     void deserialize(const std::string &ifile) { ObjectRepository::deserialize(ifile, this); }
     void serializeAsText(const std::string &ofile) { ObjectRepository::serializeAsText(ofile, this); }
     void deserializeAsText(const std::string &ifile) { ObjectRepository::deserializeAsText(ifile, this); }
     void readText(std::istream &is, size_t dataSize) { ObjectRepository::readText(is, dataSize); }
     void appendText(std::istream &is, size_t dataSize) { ObjectRepository::appendText(is, dataSize); }
+    void appendBinary(std::istream &is, VectorFile::Format format, size_t dataSize) { ObjectRepository::appendBinary(is, format, dataSize); }
 
     void append(const float *data, size_t dataSize) { ObjectRepository::append(data, dataSize); }
     void append(const double *data, size_t dataSize) { ObjectRepository::append(data, dataSize); }
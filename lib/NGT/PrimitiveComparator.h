@@ -65,6 +65,19 @@ namespace NGT {
       }
 #endif
     }
+    // Read a byte of each page of the specified memory so that the pages are mapped in.
+    // Software prefetches are dropped for pages which are not resident, so they cannot be used to fault pages in.
+    inline static void touch(const void *ptr, const size_t byteSize, const size_t pageSize = 4096) {
+      if (byteSize == 0) {
+	return;
+      }
+      const volatile uint8_t *p = static_cast<const volatile uint8_t*>(ptr);
+      const volatile uint8_t *last = p + byteSize - 1;
+      for (; p < last; p += pageSize) {
+	(void)*p;
+      }
+      (void)*last;
+    }
     inline static void *alignedAlloc(const size_t allocSize) {
 #ifdef NGT_NO_AVX
       return new uint8_t[allocSize];
@@ -0,0 +1,627 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include	"NGT/defines.h"
+#include	"NGT/Common.h"
+#include	"NGT/Index.h"
+#include	"NGT/SectorIndex.h"
+#include	"NGT/HashBasedBooleanSet.h"
+
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<cerrno>
+#include	<memory>
+#ifdef NGT_IO_URING
+#include	<sys/mman.h>
+#include	<sys/syscall.h>
+#include	<linux/io_uring.h>
+#endif
+
+using namespace std;
+using namespace NGT;
+
+static const char	sectorIndexMagic[8]	= {'N', 'G', 'T', 'S', 'E', 'C', 'T', 'R'};
+static const uint64_t	sectorIndexVersion	= 1;
+static const size_t	sectorReaderDepth	= 64;
+
+static inline uint64_t
+alignOffset(uint64_t offset, uint64_t alignment)
+{
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+void
+SectorReader::open(int f, size_t d)
+{
+  close();
+  fd = f;
+#ifdef NGT_IO_URING
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int r = syscall(__NR_io_uring_setup, d, &params);
+  if (r < 0) {
+    // the reads fall back to pread, e.g. when the kernel or the sandbox does not allow io_uring.
+    return;
+  }
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqRing = mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r, IORING_OFF_SQ_RING);
+  cqRing = mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r, IORING_OFF_CQ_RING);
+  sqes = mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r, IORING_OFF_SQES);
+  if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+    if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    if (cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+    if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+    ::close(r);
+    return;
+  }
+  ring = r;
+  depth = params.sq_entries;
+  inFlight = 0;
+  uint8_t *sq = static_cast<uint8_t*>(sqRing);
+  uint8_t *cq = static_cast<uint8_t*>(cqRing);
+  sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+#endif
+}
+
+void
+SectorReader::close()
+{
+#ifdef NGT_IO_URING
+  if (ring >= 0) {
+    munmap(sqRing, sqRingSize);
+    munmap(cqRing, cqRingSize);
+    munmap(sqes, sqesSize);
+    ::close(ring);
+  }
+#endif
+  ring = -1;
+  fd = -1;
+}
+
+void
+SectorReader::readSynchronously(Request &request, size_t done)
+{
+  while (done < request.size) {
+    ssize_t s = pread(fd, request.buffer + done, request.size - done, request.offset + done);
+    if (s < 0 && errno == EINTR) {
+      continue;
+    }
+    if (s <= 0) {
+      stringstream msg;
+      msg << "NGT::SectorReader::readSynchronously: Cannot read. offset=" << request.offset << " size=" << request.size;
+      NGTThrowException(msg);
+    }
+    done += s;
+  }
+}
+
+#ifdef NGT_IO_URING
+size_t
+SectorReader::submit(vector<Request> &requests, size_t begin)
+{
+  unsigned tail = *sqTail;
+  unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  size_t count = 0;
+  while (begin + count < requests.size() && inFlight < depth && tail - head <= *sqMask) {
+    size_t ridx = begin + count;
+    unsigned idx = tail & *sqMask;
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe*>(sqes) + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    iovecs[ridx].iov_base = requests[ridx].buffer;
+    iovecs[ridx].iov_len = requests[ridx].size;
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&iovecs[ridx]);
+    sqe->len = 1;
+    sqe->off = requests[ridx].offset;
+    sqe->user_data = ridx;
+    sqArray[idx] = idx;
+    tail++;
+    count++;
+    inFlight++;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+  size_t submitted = 0;
+  while (submitted < count) {
+    int s = syscall(__NR_io_uring_enter, ring, count - submitted, 0, 0, NULL, 0);
+    if (s < 0 && errno == EINTR) {
+      continue;
+    }
+    if (s <= 0) {
+      stringstream msg;
+      msg << "NGT::SectorReader::submit: Cannot submit the reads. errno=" << errno;
+      NGTThrowException(msg);
+    }
+    submitted += s;
+  }
+  return count;
+}
+
+size_t
+SectorReader::complete(vector<Request> &requests)
+{
+  for (;;) {
+    unsigned head = *cqHead;
+    if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = static_cast<struct io_uring_cqe*>(cqes) + (head & *cqMask);
+      size_t idx = cqe->user_data;
+      int result = cqe->res;
+      __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+      inFlight--;
+      // a failed or short read is completed synchronously.
+      readSynchronously(requests[idx], result < 0 ? 0 : result);
+      return idx;
+    }
+    int s = syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (s < 0 && errno != EINTR) {
+      stringstream msg;
+      msg << "NGT::SectorReader::complete: Cannot wait for the reads. errno=" << errno;
+      NGTThrowException(msg);
+    }
+  }
+}
+
+void
+SectorReader::drain(vector<Request> &requests)
+{
+  while (inFlight > 0) {
+    try {
+      complete(requests);
+    } catch (Exception &err) {
+      // the completion is consumed even if the synchronous read fails.
+    }
+  }
+}
+#endif
+
+void
+SectorIndex::build(NGT::Index &index, const string &file, size_t maxEdgeSize)
+{
+  GraphIndex &graph = static_cast<GraphIndex&>(index.getIndex());
+  ObjectSpace &objectSpace = graph.getObjectSpace();
+  ObjectRepository &objectRepository = objectSpace.getRepository();
+  NGT::Property prop;
+  index.getProperty(prop);
+
+  if (prop.distanceType == ObjectSpace::DistanceTypeSparseJaccard) {
+    NGTThrowException("NGT::SectorIndex::build: Sparse objects are not supported.");
+  }
+  MappedIndex::getComparator(prop.distanceType, prop.objectType);
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, sectorIndexMagic, sizeof(header.magic));
+  header.version		= sectorIndexVersion;
+  header.objectType		= prop.objectType;
+  header.distanceType		= prop.distanceType;
+  header.dimension		= objectSpace.getDimension();
+  header.paddedDimension	= objectSpace.getPaddedDimension();
+  header.objectSize		= objectSpace.getByteSizeOfObject();
+  header.numberOfObjects	= objectRepository.size();
+  header.edgeSizeForSearch	= prop.edgeSizeForSearch;
+
+  const size_t nOfObjects = header.numberOfObjects;
+  const size_t dimension = header.dimension;
+  const size_t paddedDimension = header.paddedDimension;
+
+  if (maxEdgeSize == 0 && prop.edgeSizeForSearch > 0) {
+    maxEdgeSize = prop.edgeSizeForSearch;
+  }
+  if (maxEdgeSize == 0) {
+    for (size_t id = 1; id < nOfObjects && id < graph.repository.size(); id++) {
+      if (!graph.repository.isEmpty(id)) {
+	maxEdgeSize = max(maxEdgeSize, graph.getNode(id)->size());
+      }
+    }
+  }
+  header.maxEdgeSize		= maxEdgeSize;
+  // the nodes are aligned for the comparators.
+  header.nodeSize		= alignOffset(header.objectSize + sizeof(uint32_t) * (maxEdgeSize + 1), 64);
+  header.nodesPerSector		= header.nodeSize <= sectorSize ? sectorSize / header.nodeSize : 1;
+  header.sectorsPerNode		= (header.nodeSize + sectorSize - 1) / sectorSize;
+  header.nodeOffset		= alignOffset(sizeof(Header), sectorSize);
+  size_t numberOfSectors = header.nodesPerSector > 1 ?
+    (nOfObjects + header.nodesPerSector - 1) / header.nodesPerSector : nOfObjects * header.sectorsPerNode;
+  header.codeOffset		= header.nodeOffset + numberOfSectors * sectorSize;
+
+  // the entries are the nearest objects to the mean of the objects.
+  vector<float> minimums(paddedDimension, 0.0);
+  vector<float> scales(paddedDimension, 0.0);
+  {
+    vector<double> sum(dimension, 0.0);
+    vector<float> maximums(dimension, -FLT_MAX);
+    for (size_t d = 0; d < dimension; d++) {
+      minimums[d] = FLT_MAX;
+    }
+    size_t count = 0;
+    for (size_t id = 1; id < nOfObjects; id++) {
+      if (objectRepository.isEmpty(id)) {
+	continue;
+      }
+      vector<float> object;
+      objectSpace.getObject(id, object);
+      for (size_t d = 0; d < dimension; d++) {
+	sum[d] += object[d];
+	minimums[d] = min(minimums[d], object[d]);
+	maximums[d] = max(maximums[d], object[d]);
+      }
+      count++;
+    }
+    if (count == 0) {
+      NGTThrowException("NGT::SectorIndex::build: The index has no objects.");
+    }
+    for (size_t d = 0; d < dimension; d++) {
+      if (header.objectType == ObjectSpace::Uint8) {
+	// the objects themselves are the codes.
+	minimums[d] = 0.0;
+	scales[d] = 1.0;
+      } else {
+	scales[d] = maximums[d] > minimums[d] ? (maximums[d] - minimums[d]) / 255.0 : 1.0;
+      }
+    }
+    vector<float> mean(dimension);
+    for (size_t d = 0; d < dimension; d++) {
+      mean[d] = sum[d] / count;
+    }
+    NGT::SearchQuery sq(mean);
+    NGT::ObjectDistances entries;
+    sq.setResults(&entries);
+    sq.setSize(sizeof(header.entries) / sizeof(header.entries[0]));
+    sq.setEpsilon(0.1);
+    index.search(sq);
+    for (size_t i = 0; i < entries.size(); i++) {
+      header.entries[header.numberOfEntries++] = entries[i].id;
+    }
+  }
+
+  // the file is written into a temporary file and renamed not to affect the processes searching the previous one.
+  stringstream tmp;
+  tmp << file << "." << getpid();
+  ofstream os(tmp.str(), ios::out | ios::binary | ios::trunc);
+  if (!os) {
+    stringstream msg;
+    msg << "NGT::SectorIndex::build: Cannot open the file. " << tmp.str();
+    NGTThrowException(msg);
+  }
+  vector<uint8_t> sector(header.sectorsPerNode * sectorSize, 0);
+  memcpy(sector.data(), &header, sizeof(header));
+  os.write(reinterpret_cast<const char*>(sector.data()), header.nodeOffset);
+  memset(sector.data(), 0, sector.size());
+  for (size_t id = 0; id < nOfObjects; id++) {
+    uint8_t *node = sector.data() + (header.nodesPerSector > 1 ? (id % header.nodesPerSector) * header.nodeSize : 0);
+    uint32_t *edges = reinterpret_cast<uint32_t*>(node + header.objectSize);
+    if (id != 0 && !objectRepository.isEmpty(id)) {
+      memcpy(node, objectSpace.getObject(id), header.objectSize);
+      if (id < graph.repository.size() && !graph.repository.isEmpty(id)) {
+	GraphNode &gnode = *graph.getNode(id);
+	for (size_t i = 0; i < gnode.size() && edges[0] < maxEdgeSize; i++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  ObjectID nid = gnode.at(i, graph.repository.allocator).id;
+#else
+	  ObjectID nid = gnode[i].id;
+#endif
+	  if (nid >= nOfObjects || objectRepository.isEmpty(nid)) {
+	    continue;
+	  }
+	  edges[++edges[0]] = nid;
+	}
+      }
+    }
+    if (header.nodesPerSector == 1 || id % header.nodesPerSector == header.nodesPerSector - 1 || id == nOfObjects - 1) {
+      size_t size = header.nodesPerSector > 1 ? sectorSize : header.sectorsPerNode * sectorSize;
+      os.write(reinterpret_cast<const char*>(sector.data()), size);
+      memset(sector.data(), 0, sector.size());
+    }
+  }
+
+  os.write(reinterpret_cast<const char*>(minimums.data()), minimums.size() * sizeof(float));
+  os.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(float));
+  vector<uint8_t> code(paddedDimension);
+  for (size_t id = 0; id < nOfObjects; id++) {
+    memset(code.data(), 0, code.size());
+    if (id != 0 && !objectRepository.isEmpty(id)) {
+      vector<float> object;
+      objectSpace.getObject(id, object);
+      for (size_t d = 0; d < dimension; d++) {
+	float c = round((object[d] - minimums[d]) / scales[d]);
+	code[d] = c < 0.0 ? 0 : (c > 255.0 ? 255 : static_cast<uint8_t>(c));
+      }
+    }
+    os.write(reinterpret_cast<const char*>(code.data()), code.size());
+  }
+
+  os.close();
+  if (!os || rename(tmp.str().c_str(), file.c_str()) != 0) {
+    unlink(tmp.str().c_str());
+    stringstream msg;
+    msg << "NGT::SectorIndex::build: Cannot write the file. " << file;
+    NGTThrowException(msg);
+  }
+}
+
+void
+SectorIndex::build(const string &database, size_t maxEdgeSize)
+{
+  NGT::Index index(database, false);
+  build(index, getFileName(database), maxEdgeSize);
+}
+
+void
+SectorIndex::open(const string &database)
+{
+  close();
+  string file = getFileName(database);
+  ifstream is(file, ios::in | ios::binary);
+  if (!is) {
+    stringstream msg;
+    msg << "NGT::SectorIndex::open: Cannot open the file. " << file;
+    NGTThrowException(msg);
+  }
+  is.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!is || memcmp(header.magic, sectorIndexMagic, sizeof(header.magic)) != 0 || header.version != sectorIndexVersion) {
+    memset(&header, 0, sizeof(header));
+    stringstream msg;
+    msg << "NGT::SectorIndex::open: Not a sector index or an incompatible version. " << file;
+    NGTThrowException(msg);
+  }
+  comparator = MappedIndex::getComparator(static_cast<ObjectSpace::DistanceType>(header.distanceType),
+					  static_cast<ObjectSpace::ObjectType>(header.objectType));
+  // only the codes are loaded into the memory.
+  minimums.resize(header.paddedDimension);
+  scales.resize(header.paddedDimension);
+  codes.resize(header.numberOfObjects * header.paddedDimension);
+  is.seekg(header.codeOffset);
+  is.read(reinterpret_cast<char*>(minimums.data()), minimums.size() * sizeof(float));
+  is.read(reinterpret_cast<char*>(scales.data()), scales.size() * sizeof(float));
+  is.read(reinterpret_cast<char*>(codes.data()), codes.size());
+  if (!is) {
+    close();
+    stringstream msg;
+    msg << "NGT::SectorIndex::open: Cannot read the codes. " << file;
+    NGTThrowException(msg);
+  }
+  // the sectors are read bypassing the page cache if possible, since they are rarely reused.
+#ifdef O_DIRECT
+  fd = ::open(file.c_str(), O_RDONLY | O_DIRECT);
+#endif
+  if (fd < 0) {
+    fd = ::open(file.c_str(), O_RDONLY);
+  }
+  if (fd < 0) {
+    close();
+    stringstream msg;
+    msg << "NGT::SectorIndex::open: Cannot open the file. " << file;
+    NGTThrowException(msg);
+  }
+  reader.open(fd, sectorReaderDepth);
+}
+
+void
+SectorIndex::close()
+{
+  reader.close();
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  fd = -1;
+  vector<float>().swap(minimums);
+  vector<float>().swap(scales);
+  vector<uint8_t>().swap(codes);
+}
+
+Object *
+SectorIndex::allocateObject(const vector<float> &object)
+{
+  return MappedIndex::allocateObject(object, header.dimension, header.objectSize,
+				     static_cast<ObjectSpace::ObjectType>(header.objectType),
+				     static_cast<ObjectSpace::DistanceType>(header.distanceType));
+}
+
+Object *
+SectorIndex::allocateObject(const string &line, const string &sep)
+{
+  vector<string> tokens;
+  NGT::Common::tokenize(line, tokens, sep);
+  if (header.dimension > tokens.size()) {
+    stringstream msg;
+    msg << "NGT::SectorIndex::allocateObject: too few dimension. " << tokens.size() << ":" << header.dimension << ". " << line;
+    NGTThrowException(msg);
+  }
+  vector<float> object(header.dimension);
+  for (size_t idx = 0; idx < header.dimension; idx++) {
+    object[idx] = NGT::Common::strtod(tokens[idx]);
+  }
+  return allocateObject(object);
+}
+
+size_t
+SectorIndex::getEdgeSize(NGT::SearchContainer &sc)
+{
+  int64_t esize = sc.edgeSize == -1 ? header.edgeSizeForSearch : sc.edgeSize;
+  // the dynamic edge size is not available, since all of the stored edges are read at once.
+  if (esize <= 0 || static_cast<uint64_t>(esize) > header.maxEdgeSize) {
+    return header.maxEdgeSize;
+  }
+  return esize;
+}
+
+Distance
+SectorIndex::getApproximateDistance(const void *query, ObjectID id, float *buffer)
+{
+  const size_t dimension = header.paddedDimension;
+  const uint8_t *code = &codes[id * dimension];
+  if (header.objectType == ObjectSpace::Uint8) {
+    return (*comparator)(query, code, dimension);
+  }
+  for (size_t d = 0; d < dimension; d++) {
+    buffer[d] = minimums[d] + code[d] * scales[d];
+  }
+  return (*comparator)(query, buffer, dimension);
+}
+
+void
+SectorIndex::search(NGT::SearchContainer &sc)
+{
+  sc.distanceComputationCount = 0;
+  sc.visitCount = 0;
+  if (sc.size == 0) {
+    while (!sc.workingResult.empty()) sc.workingResult.pop();
+    return;
+  }
+  if (sc.expectedAccuracy > 0.0) {
+    NGTThrowException("NGT::SectorIndex::search: The expected accuracy is not supported for sector indexes. Specify epsilon instead.");
+  }
+  NGT::SearchContainer so(sc);
+  if (header.numberOfObjects < 5000000) {
+    searchGraph<NeighborhoodGraph::BooleanVector>(so);
+  } else {
+    searchGraph<HashBasedBooleanSet>(so);
+  }
+  sc.workingResult = std::move(so.workingResult);
+  sc.distanceComputationCount = so.distanceComputationCount;
+  sc.visitCount = so.visitCount;
+}
+
+// The graph is traversed with the approximate distances from the codes in the same way as
+// NeighborhoodGraph::search, except that a beam of the unchecked nodes is expanded at once. The exact
+// distances of the expanded nodes are computed from the objects in their sectors, and the results are
+// the nearest ones of them.
+template <typename CHECK_LIST>
+void
+SectorIndex::searchGraph(NGT::SearchContainer &sc)
+{
+  if (sc.explorationCoefficient == 0.0) {
+    sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
+  }
+  const size_t edgeSize = getEdgeSize(sc);
+  const size_t dimension = header.paddedDimension;
+  const size_t bufferSize = header.sectorsPerNode * sectorSize;
+  const void *query = &sc.object[0];
+  const Distance radius = sc.radius;
+
+  std::priority_queue<ObjectDistance, std::vector<ObjectDistance>, std::greater<ObjectDistance> > unchecked;
+  CHECK_LIST distanceChecked(header.numberOfObjects);
+  ResultPriorityQueue results;
+  ObjectDistances expanded;
+  vector<float> decoded(dimension);
+
+  ObjectDistances seeds;
+  for (size_t i = 0; i < header.numberOfEntries; i++) {
+    seeds.push_back(ObjectDistance(header.entries[i], getApproximateDistance(query, header.entries[i], decoded.data())));
+  }
+  std::sort(seeds.begin(), seeds.end());
+  for (ObjectDistances::iterator ri = seeds.begin(); ri != seeds.end(); ri++) {
+    if ((results.size() < (unsigned int)sc.size) && ((*ri).distance <= sc.radius)) {
+      results.push((*ri));
+    } else {
+      break;
+    }
+  }
+  if (results.size() >= sc.size) {
+    sc.radius = results.top().distance;
+  }
+  for (ObjectDistances::iterator ri = seeds.begin(); ri != seeds.end(); ri++) {
+    distanceChecked.insert((*ri).id);
+    unchecked.push(*ri);
+  }
+
+  // the buffers are aligned for the direct I/O.
+  void *bufferArea = 0;
+  if (posix_memalign(&bufferArea, sectorSize, bufferSize * beamWidth) != 0) {
+    NGTThrowException("NGT::SectorIndex::searchGraph: Cannot allocate the buffers.");
+  }
+  std::unique_ptr<uint8_t, void(*)(void*)> buffers(static_cast<uint8_t*>(bufferArea), free);
+  vector<SectorReader::Request> requests;
+  vector<ObjectID> beam;
+  Distance explorationRadius = sc.explorationCoefficient * sc.radius;
+  ObjectDistance result;
+  while (!unchecked.empty()) {
+    beam.clear();
+    requests.clear();
+    while (!unchecked.empty() && beam.size() < beamWidth && unchecked.top().distance <= explorationRadius) {
+      ObjectID id = unchecked.top().id;
+      unchecked.pop();
+      requests.push_back(SectorReader::Request(buffers.get() + beam.size() * bufferSize, bufferSize, getNodeOffset(id)));
+      beam.push_back(id);
+    }
+    if (beam.empty()) {
+      break;
+    }
+    reader.read(requests, [&](size_t idx) {
+	uint8_t *node = requests[idx].buffer + getNodePosition(beam[idx]);
+	expanded.push_back(ObjectDistance(beam[idx], (*comparator)(query, node, dimension)));
+#ifdef NGT_DISTANCE_COMPUTATION_COUNT
+	sc.distanceComputationCount++;
+#endif
+	uint32_t *edges = reinterpret_cast<uint32_t*>(node + header.objectSize);
+	size_t neighborSize = edges[0] < edgeSize ? edges[0] : edgeSize;
+	for (size_t i = 1; i <= neighborSize; i++) {
+	  ObjectID nid = edges[i];
+	  if (distanceChecked[nid]) {
+	    continue;
+	  }
+	  distanceChecked.insert(nid);
+#ifdef NGT_VISIT_COUNT
+	  sc.visitCount++;
+#endif
+	  Distance distance = getApproximateDistance(query, nid, decoded.data());
+	  if (distance <= explorationRadius) {
+	    result.set(nid, distance);
+	    unchecked.push(result);
+	    if (distance <= sc.radius) {
+	      results.push(result);
+	      if (results.size() >= sc.size) {
+		if (results.size() > sc.size) {
+		  results.pop();
+		}
+		sc.radius = results.top().distance;
+		explorationRadius = sc.explorationCoefficient * sc.radius;
+	      }
+	    }
+	  }
+	}
+      });
+  }
+
+  std::sort(expanded.begin(), expanded.end());
+  size_t size = 0;
+  while (size < expanded.size() && size < sc.size && expanded[size].distance <= radius) {
+    size++;
+  }
+  expanded.resize(size);
+  sc.radius = radius;
+  if (sc.resultIsAvailable()) {
+    ObjectDistances &qresults = sc.getResult();
+    qresults = std::move(expanded);
+  } else {
+    while (!sc.workingResult.empty()) sc.workingResult.pop();
+    for (auto i = expanded.begin(); i != expanded.end(); ++i) {
+      sc.workingResult.push(*i);
+    }
+  }
+}
@@ -0,0 +1,203 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<mutex>
+#ifdef NGT_IO_URING
+#include	<sys/uio.h>
+#endif
+
+#include	"NGT/Index.h"
+#include	"NGT/MappedIndex.h"
+
+namespace NGT {
+
+  // Reads the sectors of a file in a batch. The reads are submitted at once with io_uring if it is available,
+  // and each of the reads is processed as soon as it completes, so that the processing of the read sectors
+  // overlaps the remaining reads. Otherwise, the reads are issued synchronously with pread.
+  class SectorReader {
+  public:
+    class Request {
+    public:
+      Request():buffer(0), size(0), offset(0) {}
+      Request(uint8_t *b, size_t s, off_t o):buffer(b), size(s), offset(o) {}
+      uint8_t	*buffer;
+      size_t	size;
+      off_t	offset;
+    };
+
+    SectorReader():fd(-1), ring(-1) {}
+    ~SectorReader() { close(); }
+
+    void open(int fd, size_t depth);
+    void close();
+    bool isAsynchronous() { return ring >= 0; }
+
+    // process(idx) is called for the idx-th request after it has been read.
+    template <typename PROCESS> void read(std::vector<Request> &requests, PROCESS process) {
+#ifdef NGT_IO_URING
+      if (ring >= 0 && requests.size() > 1) {
+	std::unique_lock<std::mutex> lock(ringMutex, std::try_to_lock);
+	// the searches of the other threads read synchronously while the ring is used.
+	if (lock.owns_lock()) {
+	  if (iovecs.size() < requests.size()) {
+	    iovecs.resize(requests.size());
+	  }
+	  size_t submitted = 0;
+	  size_t completed = 0;
+	  try {
+	    while (completed < requests.size()) {
+	      submitted += submit(requests, submitted);
+	      size_t idx = complete(requests);
+	      completed++;
+	      process(idx);
+	    }
+	  } catch (Exception &err) {
+	    // the buffers must not be released until the submitted reads complete.
+	    drain(requests);
+	    throw err;
+	  }
+	  return;
+	}
+      }
+#endif
+      for (size_t idx = 0; idx < requests.size(); idx++) {
+	readSynchronously(requests[idx], 0);
+	process(idx);
+      }
+    }
+
+  protected:
+    void readSynchronously(Request &request, size_t done);
+#ifdef NGT_IO_URING
+    size_t submit(std::vector<Request> &requests, size_t begin);
+    size_t complete(std::vector<Request> &requests);
+    void drain(std::vector<Request> &requests);
+
+    std::mutex	ringMutex;
+    size_t	depth;
+    size_t	inFlight;
+    void	*sqRing;
+    size_t	sqRingSize;
+    void	*cqRing;
+    size_t	cqRingSize;
+    void	*sqes;
+    size_t	sqesSize;
+    unsigned	*sqHead;
+    unsigned	*sqTail;
+    unsigned	*sqMask;
+    unsigned	*sqArray;
+    unsigned	*cqHead;
+    unsigned	*cqTail;
+    unsigned	*cqMask;
+    void	*cqes;
+    std::vector<struct iovec>	iovecs;
+#endif
+    int		fd;
+    int		ring;
+  };
+
+  // A read-only image of a graph index for the search with the graph on the disk such as an SSD.
+  // The neighbors and the object of each node are stored together in 4KB aligned sectors, so that a node is
+  // read by one I/O. Only the 8-bit scalar quantized codes of the objects reside in the memory to guide the
+  // traversal, and the exact distances are computed from the objects in the read sectors.
+  // The file consists of a header followed by the following sections.
+  //   nodes : each node consists of the object, # of the neighbors (uint32) and the neighbor IDs (uint32 x
+  //           max edge size). multiple nodes are packed in a sector, or a node occupies consecutive sectors.
+  //   codes : the minimums and the scales of the dimensions (float x padded dimension x 2) and
+  //           the codes of the objects (uint8 x padded dimension).
+  // The search expands a beam of the nearest unexpanded nodes per round, and all of the sectors of the beam
+  // are read at once.
+  class SectorIndex {
+  public:
+    class Header {
+    public:
+      char	magic[8];
+      uint64_t	version;
+      uint64_t	objectType;
+      uint64_t	distanceType;
+      uint64_t	dimension;
+      uint64_t	paddedDimension;
+      uint64_t	objectSize;
+      uint64_t	numberOfObjects;
+      uint64_t	maxEdgeSize;
+      uint64_t	nodeSize;
+      uint64_t	nodesPerSector;
+      uint64_t	sectorsPerNode;
+      uint64_t	nodeOffset;
+      uint64_t	codeOffset;
+      int64_t	edgeSizeForSearch;
+      uint64_t	numberOfEntries;
+      uint32_t	entries[16];
+    };
+
+    static const size_t	sectorSize = 4096;
+    static const size_t	defaultBeamWidth = 4;
+
+    SectorIndex():fd(-1), beamWidth(defaultBeamWidth) {}
+    SectorIndex(const std::string &database):fd(-1), beamWidth(defaultBeamWidth) { open(database); }
+    ~SectorIndex() { close(); }
+
+    // When maxEdgeSize is zero, the edge size for search of the index is used.
+    static void build(NGT::Index &index, const std::string &file, size_t maxEdgeSize = 0);
+    static void build(const std::string &database, size_t maxEdgeSize = 0);
+    static std::string getFileName(const std::string &database) { return database + "/sector"; }
+
+    void open(const std::string &database);
+    void close();
+    bool isOpen() { return fd >= 0; }
+    bool isAsynchronous() { return reader.isAsynchronous(); }
+
+    Object *allocateObject(const std::vector<float> &object);
+    Object *allocateObject(const std::string &line, const std::string &sep);
+    void deleteObject(Object *object) { delete object; }
+
+    // The number of the nodes which are read at once.
+    void setBeamWidth(size_t width) { beamWidth = width == 0 ? 1 : width; }
+
+    void search(NGT::SearchContainer &sc);
+    void searchUsingOnlyGraph(NGT::SearchContainer &sc) { search(sc); }
+
+    size_t getNumberOfObjects() { return header.numberOfObjects == 0 ? 0 : header.numberOfObjects - 1; }
+    size_t getDimension() { return header.dimension; }
+    Header &getHeader() { return header; }
+
+  protected:
+    template <typename CHECK_LIST> void searchGraph(NGT::SearchContainer &sc);
+    size_t getEdgeSize(NGT::SearchContainer &sc);
+    Distance getApproximateDistance(const void *query, ObjectID id, float *buffer);
+    off_t getNodeOffset(ObjectID id) {
+      if (header.nodesPerSector > 1) {
+	return header.nodeOffset + (id / header.nodesPerSector) * sectorSize;
+      }
+      return header.nodeOffset + id * header.sectorsPerNode * sectorSize;
+    }
+    size_t getNodePosition(ObjectID id) {
+      return header.nodesPerSector > 1 ? (id % header.nodesPerSector) * header.nodeSize : 0;
+    }
+
+    Header			header;
+    int				fd;
+    size_t			beamWidth;
+    MappedIndex::Comparator	comparator;
+    std::vector<float>		minimums;
+    std::vector<float>		scales;
+    std::vector<uint8_t>	codes;
+    SectorReader		reader;
+  };
+
+} // namespace NGT
@@ -98,7 +98,7 @@ class SharedMemoryAllocator {
 #endif
   }
 
-  void *construct(const std::string &filePath, size_t memorysize = 0) {
+  void *construct(const std::string &filePath, size_t memorysize = 0, const MemoryManager::open_option_st *openOption = 0) {
     file = filePath;	// debug
 #ifdef SMA_TRACE
     std::cerr << "ObjectSharedMemoryAllocator::construct: file " << filePath << std::endl;
@@ -128,7 +128,7 @@ class SharedMemoryAllocator {
       std::cerr << "SMA::construct: msize=" << msize << ":" << memorysize << std::endl;
 #endif
     }
-    if(!mmanager->openMemory(filePath)){
+    if(!mmanager->openMemory(filePath, openOption)){
       std::cerr << "SMA: open error" << std::endl;
       return 0;
     }
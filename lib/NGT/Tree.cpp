@@ -124,6 +124,7 @@ DVPTree::recombineNodes(InsertContainer &ic, Node::Objects &fs, LeafNode &leaf)
   Node::ID targetId = leaf.id;
   ln[0] = &leaf;
   ln[0]->objectSize = 0;
+  setNodeModified(targetId);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
   for (size_t i = 1; i < internalChildrenSize; i++) {
     ln[i] = new(leafNodes.allocator) LeafNode(leafNodes.allocator);
@@ -138,6 +139,7 @@ DVPTree::recombineNodes(InsertContainer &ic, Node::Objects &fs, LeafNode &leaf)
   try {
     if (targetParent.getID() != 0) {
       InternalNode &pnode = *(InternalNode*)getNode(targetParent);
+      setNodeModified(targetParent);
       for (size_t i = 0; i < internalChildrenSize; i++) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	if (pnode.getChildren(internalNodes.allocator)[i] == targetId) {
@@ -266,6 +268,7 @@ DVPTree::recombineNodes(InsertContainer &ic, Node::Objects &fs, LeafNode &leaf)
 
 void
 DVPTree::insertObject(InsertContainer &ic, LeafNode &leaf) {
+  setNodeModified(leaf.id);
   if (leaf.getObjectSize() == 0) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
     leaf.setPivot(*getObjectRepository().get(ic.id), *objectSpace, leafNodes.allocator);
@@ -384,6 +387,7 @@ DVPTree::removeEmptyNodes(InternalNode &inode) {
     insertNode(ln);
 
     InternalNode &in = *(InternalNode*)getNode(ln->parent);
+    setNodeModified(in.id);
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
     in.updateChild(*this, target->id, ln->id, internalNodes.allocator);
 #else
@@ -106,13 +106,17 @@ namespace NGT {
 	}
       }
       internalNodes.clear();
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      leafNodes.modifiedEntries.addAll();
+      internalNodes.modifiedEntries.addAll();
+#endif
     }
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-    void open(const std::string &f, size_t sharedMemorySize) {
+    void open(const std::string &f, size_t sharedMemorySize, const MemoryManager::open_option_st *openOption = 0) {
       // If no file, then create a new file.
-      leafNodes.open(f + "l", sharedMemorySize);
-      internalNodes.open(f + "i", sharedMemorySize);
+      leafNodes.open(f + "l", sharedMemorySize, openOption);
+      internalNodes.open(f + "i", sharedMemorySize, openOption);
       if (leafNodes.size() == 0) {
 	if (internalNodes.size() != 0) {
           NGTThrowException("Tree::Open: Internal error. Internal and leaf are inconsistent.");
@@ -186,6 +190,7 @@ namespace NGT {
 #else
 	ln.removeObject(id, replaceId);
 #endif
+	setNodeModified(ln.id);
       } catch(Exception &err) {
 	std::stringstream msg;
 	msg << "VpTree::remove: Inner error. Cannot remove object. leafNode=" << ln.id.getID() << ":" << err.what();
@@ -201,6 +206,43 @@ namespace NGT {
       return;
     }
 
+    // renumber the objects in the leaves. the objects whose new IDs are zero are removed.
+    void compact(const std::vector<ObjectID> &newIDs) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      leafNodes.modifiedEntries.addAll();
+#endif
+      for (size_t i = 0; i < leafNodes.size(); i++) {
+	if (leafNodes[i] == 0) {
+	  continue;
+	}
+	LeafNode &ln = *leafNodes[i];
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	for (size_t j = 0; j < ln.getObjectSize();) {
+	  ObjectID id = ln.getObjectIDs(leafNodes.allocator)[j].id;
+	  if (id >= newIDs.size() || newIDs[id] == 0) {
+	    ln.removeObject(id, 0, leafNodes.allocator);
+	    continue;
+	  }
+	  j++;
+	}
+	NGT::ObjectDistance *objects = ln.getObjectIDs(leafNodes.allocator);
+#else
+	for (size_t j = 0; j < ln.getObjectSize();) {
+	  ObjectID id = ln.getObjectIDs()[j].id;
+	  if (id >= newIDs.size() || newIDs[id] == 0) {
+	    ln.removeObject(id, 0);
+	    continue;
+	  }
+	  j++;
+	}
+	NGT::ObjectDistance *objects = ln.getObjectIDs();
+#endif
+	for (size_t j = 0; j < ln.getObjectSize(); j++) {
+	  objects[j].id = newIDs[objects[j].id];
+	}
+      }
+    }
+
     void removeNaively(ObjectID id, ObjectID replaceId = 0) {
       for (size_t i = 0; i < leafNodes.size(); i++) {
 	if (leafNodes[i] != 0) {
@@ -210,6 +252,7 @@ namespace NGT {
 #else
 	    leafNodes[i]->removeObject(id, replaceId);
 #endif
+	    setNodeModified(leafNodes[i]->id);
 	    break;
 	  } catch(...) {}
 	}
@@ -244,6 +287,17 @@ namespace NGT {
       return n;
     }
 
+    // record the node which is modified in place, so that the node is appended to the journal.
+    void setNodeModified(Node::ID id) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      if (id.getType() == Node::ID::Leaf) {
+	leafNodes.modifiedEntries.add(id.getID());
+      } else {
+	internalNodes.modifiedEntries.add(id.getID());
+      }
+#endif
+    }
+
     void
       removeNode(Node::ID id) {
       size_t idx = id.getID();
@@ -288,6 +342,7 @@ namespace NGT {
       leafNodes.set(id, n);
 #else
       leafNodes[id] = n;
+      leafNodes.modifiedEntries.add(id);
 #endif
     }
 
@@ -341,9 +396,9 @@ namespace NGT {
       }
     }
 
-    void serialize(std::ofstream &os) {
-      leafNodes.serialize(os, objectSpace);
-      internalNodes.serialize(os, objectSpace);
+    void serialize(std::ofstream &os, bool chunked = false) {
+      leafNodes.serialize(os, objectSpace, chunked);
+      internalNodes.serialize(os, objectSpace, chunked);
     }
 
     void deserialize(std::ifstream &is) {
@@ -435,6 +490,59 @@ namespace NGT {
 #endif
     }
 
+    // Touch the nodes, the leaf entries and the pivots. Returns the size of the touched memory.
+    size_t touchPages() {
+      size_t touchedSize = 0;
+      size_t pivotSize = objectSpace->getByteSizeOfObject();
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+      SharedMemoryAllocator &objectAllocator = objectSpace->getRepository().getAllocator();
+#endif
+      size_t internalSize = internalNodes.size();
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+:touchedSize)
+      for (size_t id = 0; id < internalSize; id++) {
+	if (internalNodes.isEmpty(id)) {
+	  continue;
+	}
+	InternalNode &node = *internalNodes.get(id);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	MemoryCache::touch(node.getChildren(internalNodes.allocator), node.childrenSize * sizeof(Node::ID));
+	MemoryCache::touch(node.getBorders(internalNodes.allocator), (node.childrenSize - 1) * sizeof(Distance));
+	if (!node.pivotIsEmpty()) {
+	  MemoryCache::touch(node.getPivot(*objectSpace).getPointer(0, objectAllocator), pivotSize);
+	}
+#else
+	MemoryCache::touch(node.getChildren(), node.childrenSize * sizeof(Node::ID));
+	MemoryCache::touch(node.getBorders(), (node.childrenSize - 1) * sizeof(Distance));
+	if (!node.pivotIsEmpty()) {
+	  MemoryCache::touch(node.getPivot().getPointer(), pivotSize);
+	}
+#endif
+	touchedSize += sizeof(InternalNode) + node.childrenSize * sizeof(Node::ID) + (node.childrenSize - 1) * sizeof(Distance) + pivotSize;
+      }
+      size_t leafSize = leafNodes.size();
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+:touchedSize)
+      for (size_t id = 0; id < leafSize; id++) {
+	if (leafNodes.isEmpty(id)) {
+	  continue;
+	}
+	LeafNode &node = *leafNodes.get(id);
+	size_t size = node.getObjectSize() * sizeof(ObjectDistance);
+#ifdef NGT_SHARED_MEMORY_ALLOCATOR
+	MemoryCache::touch(node.getObjectIDs(leafNodes.allocator), size);
+	if (!node.pivotIsEmpty()) {
+	  MemoryCache::touch(node.getPivot(*objectSpace).getPointer(0, objectAllocator), pivotSize);
+	}
+#else
+	MemoryCache::touch(node.getObjectIDs(), size);
+	if (!node.pivotIsEmpty()) {
+	  MemoryCache::touch(node.getPivot().getPointer(), pivotSize);
+	}
+#endif
+	touchedSize += sizeof(LeafNode) + size + pivotSize;
+      }
+      return touchedSize;
+    }
+
     void getAllObjectIDs(std::set<ObjectID> &ids) {
       for (size_t i = 0; i < leafNodes.size(); i++) {
 	if (leafNodes[i] != 0) {
@@ -0,0 +1,247 @@
+//
+// Copyright (C) 2015 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<cstring>
+
+#include	"NGT/Common.h"
+
+namespace NGT {
+
+  // A reader of binary object files. The rows are read in blocks and handed over in the element type
+  // of the file without any conversion.
+  //   fvecs, bvecs, ivecs : each row is preceded by its dimensionality (int32).
+  //   npy                 : NumPy array file of a two-dimensional C-order array (<f4, <f8, <i4, |u1).
+  //   f32, u8             : headerless float32 or uint8 matrix. the dimensionality of the index is used.
+  class VectorFile {
+  public:
+    enum Format {
+      FormatNone	= 0,
+      FormatText	= 1,
+      FormatFvecs	= 2,
+      FormatBvecs	= 3,
+      FormatIvecs	= 4,
+      FormatNpy		= 5,
+      FormatFloat	= 6,
+      FormatUint8	= 7
+    };
+
+    enum ElementType {
+      ElementTypeNone	= 0,
+      ElementTypeUint8	= 1,
+      ElementTypeInt32	= 2,
+      ElementTypeFloat	= 3,
+      ElementTypeDouble	= 4
+    };
+
+    VectorFile(std::istream &s, Format f, size_t dim):stream(s), format(f), dimension(dim), elementType(ElementTypeNone),
+						     numberOfRows(0), headerSize(0), rowCount(0) {
+      readHeader();
+    }
+
+    // Get the format from the specified format name. When the name is empty, the format is guessed from the file extension.
+    static Format getFormat(const std::string &file, const std::string &name = "") {
+      if (name.empty()) {
+	std::string::size_type pos = file.find_last_of('.');
+	std::string::size_type slash = file.find_last_of('/');
+	if (pos == std::string::npos || (slash != std::string::npos && pos < slash)) {
+	  return FormatText;
+	}
+	Format f = getFormatFromName(file.substr(pos + 1));
+	return f == FormatNone ? FormatText : f;
+      }
+      Format f = getFormatFromName(name);
+      if (f == FormatNone) {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::getFormat: Invalid data format. " << name;
+	NGTThrowException(msg);
+      }
+      return f;
+    }
+
+    static Format getFormatFromName(const std::string &name) {
+      if (name == "t" || name == "txt" || name == "tsv" || name == "text") return FormatText;
+      if (name == "fvecs") return FormatFvecs;
+      if (name == "bvecs") return FormatBvecs;
+      if (name == "ivecs") return FormatIvecs;
+      if (name == "npy") return FormatNpy;
+      if (name == "f32" || name == "float32") return FormatFloat;
+      if (name == "u8" || name == "uint8") return FormatUint8;
+      return FormatNone;
+    }
+
+    static size_t getElementSize(ElementType type) {
+      switch (type) {
+      case ElementTypeUint8: return sizeof(uint8_t);
+      case ElementTypeInt32: return sizeof(int32_t);
+      case ElementTypeFloat: return sizeof(float);
+      case ElementTypeDouble: return sizeof(double);
+      default: return 0;
+      }
+    }
+
+    ElementType getElementType() { return elementType; }
+    size_t getElementSize() { return getElementSize(elementType); }
+    size_t getDimension() { return dimension; }
+    size_t getRowSize() { return getElementSize() * dimension; }
+    // The number of rows is available only for npy.
+    size_t getNumberOfRows() { return numberOfRows; }
+
+    // Read up to the specified number of rows into the buffer as contiguous rows of the element type.
+    // Returns the number of the read rows.
+    size_t read(std::vector<uint8_t> &buffer, size_t rows) {
+      if (format == FormatNpy && rowCount + rows > numberOfRows) {
+	rows = numberOfRows - rowCount;
+      }
+      size_t rowSize = getRowSize();
+      size_t recordSize = rowSize + headerSize;
+      buffer.resize(recordSize * rows);
+      if (rows == 0) {
+	return 0;
+      }
+      stream.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+      size_t size = stream.gcount();
+      if (size % recordSize != 0) {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::read: The file is truncated. The size of the last row=" << size % recordSize
+	    << " The expected size=" << recordSize;
+	NGTThrowException(msg);
+      }
+      rows = size / recordSize;
+      if (headerSize != 0) {
+	// remove the dimensionality of each row so as to make the rows contiguous.
+	for (size_t r = 0; r < rows; r++) {
+	  int32_t dim;
+	  memcpy(&dim, &buffer[recordSize * r], sizeof(dim));
+	  if (static_cast<size_t>(dim) != dimension) {
+	    std::stringstream msg;
+	    msg << "NGT::VectorFile::read: The dimensionality of the row is inconsistent. row="
+		<< rowCount + r << " " << dim << ":" << dimension;
+	    NGTThrowException(msg);
+	  }
+	  memmove(&buffer[rowSize * r], &buffer[recordSize * r + headerSize], rowSize);
+	}
+      }
+      buffer.resize(rowSize * rows);
+      rowCount += rows;
+      return rows;
+    }
+
+  protected:
+    void readHeader() {
+      switch (format) {
+      case FormatFvecs: elementType = ElementTypeFloat; headerSize = sizeof(int32_t); break;
+      case FormatBvecs: elementType = ElementTypeUint8; headerSize = sizeof(int32_t); break;
+      case FormatIvecs: elementType = ElementTypeInt32; headerSize = sizeof(int32_t); break;
+      case FormatFloat: elementType = ElementTypeFloat; break;
+      case FormatUint8: elementType = ElementTypeUint8; break;
+      case FormatNpy: readNpyHeader(); break;
+      default:
+	{
+	  std::stringstream msg;
+	  msg << "NGT::VectorFile: Not a binary format. " << format;
+	  NGTThrowException(msg);
+	}
+      }
+      if (dimension == 0) {
+	NGTThrowException("NGT::VectorFile: Dimension is not specified.");
+      }
+    }
+
+    void readNpyHeader() {
+      char magic[8];
+      stream.read(magic, sizeof(magic));
+      if (stream.gcount() != sizeof(magic) || memcmp(magic, "\x93NUMPY", 6) != 0) {
+	NGTThrowException("NGT::VectorFile::readNpyHeader: Not a npy file.");
+      }
+      size_t length = 0;
+      if (magic[6] == 1) {
+	uint16_t len;
+	stream.read(reinterpret_cast<char*>(&len), sizeof(len));
+	length = len;
+      } else {
+	uint32_t len;
+	stream.read(reinterpret_cast<char*>(&len), sizeof(len));
+	length = len;
+      }
+      std::string header(length, '\0');
+      stream.read(&header[0], length);
+      if (!stream) {
+	NGTThrowException("NGT::VectorFile::readNpyHeader: The npy header is truncated.");
+      }
+      std::string descr = getNpyValue(header, "descr");
+      if (descr == "'<f4'") {
+	elementType = ElementTypeFloat;
+      } else if (descr == "'<f8'") {
+	elementType = ElementTypeDouble;
+      } else if (descr == "'<i4'") {
+	elementType = ElementTypeInt32;
+      } else if (descr == "'|u1'" || descr == "'<u1'") {
+	elementType = ElementTypeUint8;
+      } else {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::readNpyHeader: Unsupported element type. " << descr;
+	NGTThrowException(msg);
+      }
+      if (getNpyValue(header, "fortran_order") != "False") {
+	NGTThrowException("NGT::VectorFile::readNpyHeader: Fortran order is not supported.");
+      }
+      std::string shape = getNpyValue(header, "shape");
+      std::vector<std::string> tokens;
+      NGT::Common::tokenize(shape.substr(1, shape.size() - 2), tokens, ", ");
+      tokens.erase(std::remove(tokens.begin(), tokens.end(), std::string()), tokens.end());
+      if (tokens.size() != 2) {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::readNpyHeader: The array is not two-dimensional. " << shape;
+	NGTThrowException(msg);
+      }
+      numberOfRows = NGT::Common::strtol(tokens[0]);
+      size_t dim = NGT::Common::strtol(tokens[1]);
+      if (dimension != 0 && dim != dimension) {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::readNpyHeader: The dimensionality is inconsistent. " << dim << ":" << dimension;
+	NGTThrowException(msg);
+      }
+      dimension = dim;
+    }
+
+    static std::string getNpyValue(const std::string &header, const std::string &key) {
+      std::string::size_type pos = header.find("'" + key + "'");
+      if (pos == std::string::npos) {
+	std::stringstream msg;
+	msg << "NGT::VectorFile::getNpyValue: Not found the key in the npy header. " << key;
+	NGTThrowException(msg);
+      }
+      pos = header.find(':', pos);
+      if (pos == std::string::npos) {
+	NGTThrowException("NGT::VectorFile::getNpyValue: Invalid npy header.");
+      }
+      pos = header.find_first_not_of(' ', pos + 1);
+      std::string::size_type end = header[pos] == '(' ? header.find(')', pos) + 1 : header.find_first_of(",}", pos);
+      return header.substr(pos, end - pos);
+    }
+
+    std::istream	&stream;
+    Format		format;
+    size_t		dimension;
+    ElementType		elementType;
+    size_t		numberOfRows;
+    size_t		headerSize;
+    size_t		rowCount;
+  };
+
+} // namespace NGT
@@ -16,6 +16,7 @@
 
 #include	"NGT/Index.h"
 #include	"NGT/GraphOptimizer.h"
+#include	"NGT/MappedIndex.h"
 #include	"NGT/version_defs.h"
 #include	"NGT/NGTQ/QuantizedGraph.h"
 
@@ -280,6 +281,44 @@ public:
     NGT::Index::remove(id);
   }
 
+  void update(
+   size_t id,
+   py::array_t<double> object
+  ) {
+    id = zeroNumbering ? id + 1 : id;
+    py::buffer_info info = object.request();
+    auto ptr = static_cast<double *>(info.ptr);
+    std::vector<double> v(ptr, ptr + info.shape[0]);
+    NGT::Index::update(id, v);
+    numOfDistanceComputations = 0;
+  }
+
+  void batchUpdate(
+   py::array_t<size_t> ids,
+   py::array_t<double> objects,
+   size_t numThreads = 8
+  ) {
+    py::buffer_info idsinfo = ids.request();
+    py::buffer_info info = objects.request();
+    if (info.shape.size() != 2 || idsinfo.shape.size() != 1 || idsinfo.shape[0] != info.shape[0]) {
+      std::stringstream msg;
+      msg << "ngtpy::batchUpdate: Error! The shapes of the IDs and the objects are inconsistent.";
+      NGTThrowException(msg);
+    }
+    auto idptr = static_cast<size_t *>(idsinfo.ptr);
+    auto ptr = static_cast<double *>(info.ptr);
+    std::vector<NGT::ObjectID> vids;
+    std::vector<std::vector<double> > vobjs;
+    vids.reserve(info.shape[0]);
+    vobjs.reserve(info.shape[0]);
+    for (ssize_t i = 0; i < info.shape[0]; i++, ptr += info.shape[1]) {
+      vids.push_back(zeroNumbering ? idptr[i] + 1 : idptr[i]);
+      vobjs.push_back(std::vector<double>(ptr, ptr + info.shape[1]));
+    }
+    NGT::Index::update(vids, vobjs, numThreads);
+    numOfDistanceComputations = 0;
+  }
+
   void refineANNG(
     float epsilon,		// epsilon for search
     float accuracy,		// expected accuracy for search
@@ -346,6 +385,124 @@ public:
   float		defaultExpectedAccuracy;
 };
 
+class MappedIndex : public NGT::MappedIndex {
+public:
+  MappedIndex(
+   const std::string path, 		// ngt index path which has the exported image.
+   bool zeroBasedNumbering,		// object ID numbering.
+   bool treeDisabled
+  ):NGT::MappedIndex(path), indexPath(path) {
+    zeroNumbering = zeroBasedNumbering;
+    treeIndex = !treeDisabled;
+    numOfDistanceComputations = 0;
+    defaultNumOfSearchObjects = 20;
+    defaultEpsilon = 0.1;
+    defaultRadius = FLT_MAX;
+    defaultEdgeSize = -1;	// -1: use edge_size_for_search in the profile
+  }
+
+  static void exportIndex(const std::string path) {
+    NGT::MappedIndex::build(path);
+  }
+
+  py::object search(
+   py::object query,
+   size_t size = 0, 			// the number of resultant objects
+   float epsilon = 0.1, 		// search parameter epsilon.
+   int edgeSize = -1,			// the number of used edges for each node during the exploration of the graph.
+   bool withDistance = true
+  ) {
+    py::array_t<float> qobject(query);
+    py::buffer_info qinfo = qobject.request();
+    std::vector<float> qvector(static_cast<float*>(qinfo.ptr), static_cast<float*>(qinfo.ptr) + qinfo.size);
+    NGT::Object *ngtquery = NGT::MappedIndex::allocateObject(qvector);
+    NGT::SearchContainer sc(*ngtquery);
+    sc.setSize(size == 0 ? defaultNumOfSearchObjects : size);		// the number of resulting objects.
+    sc.setRadius(defaultRadius);					// the radius of search.
+    sc.setEpsilon(epsilon <= -1.0 ? defaultEpsilon : epsilon);		// set exploration coefficient.
+    sc.setEdgeSize(edgeSize < -2 ? defaultEdgeSize : edgeSize);		// if maxEdge is negative, the specified value in advance is used.
+
+    try {
+      if (treeIndex) {
+	NGT::MappedIndex::search(sc);
+      } else {
+	NGT::MappedIndex::searchUsingOnlyGraph(sc);
+      }
+    } catch (NGT::Exception &err) {
+      NGT::MappedIndex::deleteObject(ngtquery);
+      throw err;
+    }
+
+    numOfDistanceComputations += sc.distanceComputationCount;
+
+    NGT::MappedIndex::deleteObject(ngtquery);
+    NGT::ObjectDistances r;
+    r.moveFrom(sc.getWorkingResult());
+    int offset = zeroNumbering ? 1 : 0;
+    if (!withDistance) {
+      py::array_t<int> ids(r.size());
+      py::buffer_info idsinfo = ids.request();
+      int *ptr = reinterpret_cast<int*>(idsinfo.ptr);
+      for (auto ri = r.begin(); ri != r.end(); ++ri) {
+	*ptr++ = (*ri).id - offset;
+      }
+      return ids;
+    }
+    py::list results;
+    for (auto ri = r.begin(); ri != r.end(); ++ri) {
+      results.append(py::make_tuple((*ri).id - offset, (*ri).distance));
+    }
+    return results;
+  }
+
+  std::vector<float> getObject(size_t id) {
+    id = zeroNumbering ? id + 1 : id;
+    size_t dimension = NGT::MappedIndex::getDimension();
+    std::vector<float> object;
+    object.reserve(dimension);
+    if (NGT::MappedIndex::getHeader().objectType == NGT::ObjectSpace::ObjectType::Uint8) {
+      auto *obj = static_cast<uint8_t*>(NGT::MappedIndex::getObject(id));
+      object.assign(obj, obj + dimension);
+    } else {
+      auto *obj = static_cast<float*>(NGT::MappedIndex::getObject(id));
+      object.assign(obj, obj + dimension);
+    }
+    return object;
+  }
+
+  // reopen the image if it was exported again. returns true if it is reopened.
+  bool reopen() {
+    if (!NGT::MappedIndex::isReplaced()) {
+      return false;
+    }
+    NGT::MappedIndex::open(indexPath);
+    return true;
+  }
+
+  void set(
+   size_t numOfSearchObjects, 		// the number of resultant objects
+   NGT::Distance radius,		// search radius.
+   float epsilon,			// epsilon
+   int edgeSize				// the number of edges for each node
+  ) {
+    defaultNumOfSearchObjects = numOfSearchObjects > 0 ? numOfSearchObjects : defaultNumOfSearchObjects;
+    defaultRadius = radius >= 0.0 ? radius : defaultRadius;
+    defaultEpsilon = epsilon > -1.0 ? epsilon : defaultEpsilon;
+    defaultEdgeSize = edgeSize >= -2 ? edgeSize : defaultEdgeSize;
+  }
+
+  size_t getNumOfDistanceComputations() { return numOfDistanceComputations; }
+
+  std::string	indexPath;
+  bool		zeroNumbering;	    // for object ID numbering. zero-based or one-based numbering.
+  bool		treeIndex;
+  size_t	numOfDistanceComputations;
+  size_t	defaultNumOfSearchObjects; // k
+  float		defaultEpsilon;
+  float		defaultRadius;
+  int64_t	defaultEdgeSize;
+};
+
 class Optimizer : public NGT::GraphOptimizer {
 public:
   using NGT::GraphOptimizer::GraphOptimizer; 
@@ -387,8 +544,9 @@ public:
    size_t maxNoOfEdges,			// the maximum number of quantized graph edges.
    bool   zeroBasedNumbering,		// object ID numbering.
    bool   treeDisabled,			// not use the tree index.
-   bool   logDisabled			// stderr log is disabled.
-  ):NGTQG::Index(path, maxNoOfEdges) {
+   bool   logDisabled,			// stderr log is disabled.
+   bool   readOnly			// open the index as read-only.
+  ):NGTQG::Index(path, maxNoOfEdges, readOnly) {
     zeroNumbering = zeroBasedNumbering;
     numOfDistanceComputations = 0;
     treeIndex = !treeDisabled;
@@ -472,6 +630,28 @@ public:
     }
   }
 
+  void batchInsert(
+   py::array_t<float> objects,
+   size_t numThreads = 8
+  ) {
+    py::buffer_info info = objects.request();
+    NGT::Property prop;
+    getProperty(prop);
+    if (info.shape.size() != 2 || prop.dimension != info.shape[1]) {
+      std::stringstream msg;
+      msg << "ngtpy::QuantizedIndex::batchInsert: Error! dimensions are inconsitency. " << prop.dimension;
+      NGTThrowException(msg);
+    }
+    auto ptr = static_cast<float *>(info.ptr);
+    std::vector<std::vector<float>> vectors;
+    for (ssize_t i = 0; i < info.shape[0]; i++) {
+      vectors.push_back(std::vector<float>(ptr + i * info.shape[1], ptr + (i + 1) * info.shape[1]));
+    }
+    std::vector<NGT::ObjectID> ids;
+    NGTQG::Index::insert(vectors, ids, numThreads);
+    numOfDistanceComputations = 0;
+  }
+
   void setWithDistance(bool v) { withDistance = v; }
 
   void set(
@@ -533,6 +713,13 @@ PYBIND11_MODULE(ngtpy, m) {
       .def("close", &NGT::Index::close)
       .def("remove", &::Index::remove,
            py::arg("object_id"))
+      .def("update", &::Index::update,
+           py::arg("object_id"),
+           py::arg("object"))
+      .def("batch_update", &::Index::batchUpdate,
+           py::arg("object_ids"),
+           py::arg("objects"),
+           py::arg("num_threads") = 8)
       .def("build_index", &NGT::Index::createIndex,
            py::arg("num_threads") = 8,
            py::arg("target_size_of_graph") = 0)
@@ -562,6 +749,31 @@ PYBIND11_MODULE(ngtpy, m) {
       .def("import_index", (void (NGT::Index::*)(const std::string&)) &NGT::Index::importIndex, 
            py::arg("path"));
 
+    m.def("export_mapped", &::MappedIndex::exportIndex,
+          py::arg("path"));
+
+    py::class_<MappedIndex>(m, "MappedIndex")
+      .def(py::init<const std::string &, bool, bool>(),
+           py::arg("path"),
+           py::arg("zero_based_numbering") = true,
+	   py::arg("tree_disabled") = false)
+      .def("search", &::MappedIndex::search,
+           py::arg("query"),
+           py::arg("size") = 0,
+           py::arg("epsilon") = -FLT_MAX,
+           py::arg("edge_size") = INT_MIN,
+           py::arg("with_distance") = true)
+      .def("get_object", &::MappedIndex::getObject,
+           py::arg("object_id"))
+      .def("get_num_of_distance_computations", &::MappedIndex::getNumOfDistanceComputations)
+      .def("reopen", &::MappedIndex::reopen)
+      .def("close", &NGT::MappedIndex::close)
+      .def("set", &::MappedIndex::set,
+           py::arg("num_of_search_objects") = 0,
+	   py::arg("search_radius") = -FLT_MAX,
+	   py::arg("epsilon") = -FLT_MAX,
+	   py::arg("edge_size") = INT_MIN);
+
 
     py::class_<Optimizer>(m, "Optimizer")
       .def(py::init<int, int, int, int, float, float, float, float, double, double, bool>(),
@@ -610,19 +822,33 @@ PYBIND11_MODULE(ngtpy, m) {
 	   py::arg("num_of_sample_objects") = -1,
 	   py::arg("max_num_of_edges") = -1);
 
+    m.def("quantize", &NGTQG::Index::quantize,
+          py::arg("path"),
+          py::arg("dimension_of_subvector") = 0,
+          py::arg("max_number_of_edges") = 128,
+          py::arg("build_disk_objects") = false,
+          py::arg("num_of_threads") = 0,
+          py::arg("local_codebook_size") = 16,
+          py::arg("compact_graph") = false);
+
     py::class_<QuantizedIndex>(m, "QuantizedIndex")
-      .def(py::init<const std::string &, size_t, bool, bool, bool>(), 
+      .def(py::init<const std::string &, size_t, bool, bool, bool, bool>(), 
            py::arg("path"),
 	   py::arg("max_no_of_edges") = 128,
            py::arg("zero_based_numbering") = true,
 	   py::arg("tree_disabled") = false,
-           py::arg("log_disabled") = false)
+           py::arg("log_disabled") = false,
+           py::arg("read_only") = false)
       .def("search", &::QuantizedIndex::search,
            py::arg("query"),
            py::arg("size") = 0,
            py::arg("epsilon") = -FLT_MAX,
            py::arg("result_expansion") = -FLT_MAX,
            py::arg("edge_size") = INT_MIN)
+      .def("batch_insert", &::QuantizedIndex::batchInsert,
+           py::arg("objects"),
+           py::arg("num_threads") = 8)
+      .def("save", &NGTQG::Index::save)
       .def("set_with_distance", &::QuantizedIndex::setWithDistance,
            py::arg("boolean") = true)
       .def("set", &::QuantizedIndex::set,